@@ -0,0 +1,107 @@
+#include "include/arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/**
+ * @param size_t size
+ * @param arena_block_T* next
+ * @return arena_block_T*
+ */
+static arena_block_T* arena_block(size_t size, arena_block_T* next)
+{
+    arena_block_T* block = malloc(sizeof(arena_block_T) + size);
+    block->next = next;
+    block->size = size;
+    block->used = 0;
+
+    return block;
+}
+
+/**
+ * Create an arena.
+ *
+ * @param size_t size, of the first block, 0 for ARENA_BLOCK_SIZE.
+ * @return arena_T*
+ */
+arena_T* init_arena(size_t size)
+{
+    arena_T* arena = calloc(1, sizeof(struct ARENA_STRUCT));
+    arena->blocks = arena_block(size ? size : ARENA_BLOCK_SIZE, NULL);
+    arena->total = arena->blocks->size;
+
+    return arena;
+}
+
+/**
+ * Allocate from the arena, never fails short of running out of memory.
+ *
+ * @param arena_T* arena
+ * @param size_t size
+ * @param size_t alignment, a power of two.
+ * @return void*
+ */
+void* arena_alloc(arena_T* arena, size_t size, size_t alignment)
+{
+    arena_block_T* block = arena->blocks;
+    uintptr_t base = (uintptr_t) block->data;
+    uintptr_t start = (base + block->used + alignment - 1) & ~(uintptr_t) (alignment - 1);
+
+    if (start + size > base + block->size)
+    {
+        size_t grow = block->size * 2;
+        if (grow < size + alignment)
+            grow = size + alignment;
+
+        block = arena_block(grow, block);
+        arena->blocks = block;
+        arena->total += grow;
+
+        base = (uintptr_t) block->data;
+        start = (base + alignment - 1) & ~(uintptr_t) (alignment - 1);
+    }
+
+    block->used = start + size - base;
+    return (void*) start;
+}
+
+/**
+ * Give back everything allocated so far.
+ *
+ * @param arena_T* arena
+ */
+void arena_reset(arena_T* arena)
+{
+    if (arena->blocks->next)
+    {
+        arena_block_T* block = arena->blocks;
+        while (block)
+        {
+            arena_block_T* next = block->next;
+            free(block);
+            block = next;
+        }
+
+        arena->blocks = arena_block(arena->total, NULL);
+    }
+
+    arena->blocks->used = 0;
+}
+
+/**
+ * Free an arena and all of its blocks.
+ *
+ * @param arena_T* arena
+ */
+void arena_free(arena_T* arena)
+{
+    arena_block_T* block = arena->blocks;
+    while (block)
+    {
+        arena_block_T* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(arena);
+}
@@ -0,0 +1,307 @@
+#include "include/atlas.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Create an empty atlas.
+ * Sprites are placed on multiples of 2^(mip_levels - 1) texels and
+ * surrounded by `padding` texels of repeated edge pixels, so the
+ * first `mip_levels` levels never blend neighbouring sprites.
+ *
+ * @param unsigned int size, width & height of every layer.
+ * @param size_t layer_count
+ * @param unsigned int padding
+ * @param unsigned int mip_levels, at least 1.
+ * @return atlas_T*
+ */
+atlas_T* init_atlas(unsigned int size, size_t layer_count, unsigned int padding, unsigned int mip_levels)
+{
+    atlas_T* atlas = calloc(1, sizeof(struct ATLAS_STRUCT));
+    atlas->size = size;
+    atlas->padding = padding;
+    atlas->mip_levels = mip_levels > 0 ? mip_levels : 1;
+    atlas->alignment = 1u << (atlas->mip_levels - 1);
+    atlas->layer_count = layer_count;
+    atlas->layers = calloc(layer_count, sizeof(struct ATLAS_LAYER_STRUCT));
+
+    for (size_t i = 0; i < layer_count; i++)
+    {
+        atlas_layer_T* layer = &atlas->layers[i];
+        layer->nodes = malloc(sizeof(atlas_skyline_node_T));
+        layer->nodes[0] = (atlas_skyline_node_T){ 0, 0, size };
+        layer->node_count = 1;
+    }
+
+    glGenTextures(1, &atlas->texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, atlas->mip_levels - 1);
+
+    for (unsigned int level = 0; level < atlas->mip_levels; level++)
+    {
+        unsigned int s = size >> level ? size >> level : 1;
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, s, s, layer_count,
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    return atlas;
+}
+
+/**
+ * Round up to a multiple of `alignment`, a power of two.
+ *
+ * @param unsigned int v
+ * @param unsigned int alignment
+ * @return unsigned int
+ */
+static unsigned int align_up(unsigned int v, unsigned int alignment)
+{
+    return (v + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * Find the lowest spot on the skyline where a rectangle fits
+ * when its left edge starts at node `index`.
+ *
+ * @param atlas_T* atlas
+ * @param atlas_layer_T* layer
+ * @param size_t index
+ * @param unsigned int width
+ * @param unsigned int height
+ * @param unsigned int* y
+ * @return int 0 if it does not fit.
+ */
+static int skyline_fit(atlas_T* atlas, atlas_layer_T* layer, size_t index,
+                       unsigned int width, unsigned int height, unsigned int* y)
+{
+    unsigned int x = layer->nodes[index].x;
+    if (x + width > atlas->size)
+        return 0;
+
+    unsigned int top = 0;
+    unsigned int remaining = width;
+
+    for (size_t i = index; remaining > 0; i++)
+    {
+        if (layer->nodes[i].y > top)
+            top = layer->nodes[i].y;
+
+        if (top + height > atlas->size)
+            return 0;
+
+        remaining = layer->nodes[i].width >= remaining ? 0 : remaining - layer->nodes[i].width;
+    }
+
+    *y = top;
+    return 1;
+}
+
+/**
+ * Raise the skyline after placing a rectangle at node `index`.
+ *
+ * @param atlas_layer_T* layer
+ * @param size_t index
+ * @param unsigned int x
+ * @param unsigned int y
+ * @param unsigned int width
+ */
+static void skyline_insert(atlas_layer_T* layer, size_t index,
+                           unsigned int x, unsigned int y, unsigned int width)
+{
+    layer->nodes = realloc(layer->nodes, (layer->node_count + 1) * sizeof(atlas_skyline_node_T));
+    memmove(&layer->nodes[index + 1], &layer->nodes[index],
+            (layer->node_count - index) * sizeof(atlas_skyline_node_T));
+    layer->nodes[index] = (atlas_skyline_node_T){ x, y, width };
+    layer->node_count++;
+
+    /**
+     * Cut away the parts of the following nodes that are now covered.
+     */
+    unsigned int right = x + width;
+    size_t i = index + 1;
+
+    while (i < layer->node_count && layer->nodes[i].x < right)
+    {
+        atlas_skyline_node_T* node = &layer->nodes[i];
+        unsigned int end = node->x + node->width;
+
+        if (end <= right)
+        {
+            memmove(node, node + 1, (layer->node_count - i - 1) * sizeof(atlas_skyline_node_T));
+            layer->node_count--;
+            continue;
+        }
+
+        node->width = end - right;
+        node->x = right;
+        break;
+    }
+
+    /**
+     * Merge neighbours at the same height.
+     */
+    for (i = 0; i + 1 < layer->node_count;)
+    {
+        if (layer->nodes[i].y == layer->nodes[i + 1].y)
+        {
+            layer->nodes[i].width += layer->nodes[i + 1].width;
+            memmove(&layer->nodes[i + 1], &layer->nodes[i + 2],
+                    (layer->node_count - i - 2) * sizeof(atlas_skyline_node_T));
+            layer->node_count--;
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+/**
+ * Upload an image with its gutter.
+ *
+ * @param atlas_T* atlas
+ * @param const image_T* image
+ * @param unsigned int x, top left of the gutter.
+ * @param unsigned int y
+ * @param unsigned int layer
+ */
+static void atlas_upload(atlas_T* atlas, const image_T* image,
+                         unsigned int x, unsigned int y, unsigned int layer)
+{
+    unsigned int p = atlas->padding;
+    unsigned int w = image->width + p * 2;
+    unsigned int h = image->height + p * 2;
+    uint32_t* pixels = malloc(sizeof(uint32_t) * w * h);
+
+    for (unsigned int dy = 0; dy < h; dy++)
+    {
+        int sy = (int) dy - (int) p;
+        sy = sy < 0 ? 0 : (sy >= (int) image->height ? (int) image->height - 1 : sy);
+
+        for (unsigned int dx = 0; dx < w; dx++)
+        {
+            int sx = (int) dx - (int) p;
+            sx = sx < 0 ? 0 : (sx >= (int) image->width ? (int) image->width - 1 : sx);
+            pixels[dy * w + dx] = image->pixels[sy * image->width + sx];
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->texture);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, layer, w, h, 1,
+                    GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    free(pixels);
+}
+
+/**
+ * Pack an image into the atlas.
+ *
+ * @param atlas_T* atlas
+ * @param const image_T* image
+ * @param atlas_sprite_T* sprite, filled in on success.
+ * @return int 0 when there is no room left.
+ */
+int atlas_add(atlas_T* atlas, const image_T* image, atlas_sprite_T* sprite)
+{
+    unsigned int width = align_up(image->width + atlas->padding * 2, atlas->alignment);
+    unsigned int height = align_up(image->height + atlas->padding * 2, atlas->alignment);
+
+    for (size_t l = 0; l < atlas->layer_count; l++)
+    {
+        atlas_layer_T* layer = &atlas->layers[l];
+        size_t best = layer->node_count;
+        unsigned int best_y = atlas->size;
+
+        /**
+         * Bottom-left rule, the lowest fit wins.
+         */
+        for (size_t i = 0; i < layer->node_count; i++)
+        {
+            unsigned int y;
+            if (skyline_fit(atlas, layer, i, width, height, &y) && y < best_y)
+            {
+                best = i;
+                best_y = y;
+            }
+        }
+
+        if (best == layer->node_count)
+            continue;
+
+        unsigned int x = layer->nodes[best].x;
+        skyline_insert(layer, best, x, best_y + height, width);
+        atlas_upload(atlas, image, x, best_y, l);
+
+        float size = (float) atlas->size;
+        sprite->uv_rect[0] = (x + atlas->padding) / size;
+        sprite->uv_rect[1] = (best_y + atlas->padding) / size;
+        sprite->uv_rect[2] = image->width / size;
+        sprite->uv_rect[3] = image->height / size;
+        sprite->layer = l;
+
+        atlas->dirty = 1;
+        return 1;
+    }
+
+    fprintf(stderr, "Atlas is full, could not fit a %ux%u image\n", image->width, image->height);
+    return 0;
+}
+
+/**
+ * Decode a .png and pack it into the atlas.
+ *
+ * @param atlas_T* atlas
+ * @param const char* path
+ * @param atlas_sprite_T* sprite
+ * @return int 0 on failure.
+ */
+int atlas_add_png(atlas_T* atlas, const char* path, atlas_sprite_T* sprite)
+{
+    image_T image = {};
+    if (!image_load(&image, path))
+        return 0;
+
+    int ok = atlas_add(atlas, &image, sprite);
+    image_release(&image);
+
+    return ok;
+}
+
+/**
+ * Rebuild the mip levels after adding sprites.
+ *
+ * @param atlas_T* atlas
+ */
+void atlas_commit(atlas_T* atlas)
+{
+    if (!atlas->dirty)
+        return;
+
+    if (atlas->mip_levels > 1)
+    {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->texture);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+
+    atlas->dirty = 0;
+}
+
+/**
+ * Free the atlas and its texture.
+ *
+ * @param atlas_T* atlas
+ */
+void atlas_free(atlas_T* atlas)
+{
+    for (size_t i = 0; i < atlas->layer_count; i++)
+        free(atlas->layers[i].nodes);
+
+    glDeleteTextures(1, &atlas->texture);
+    free(atlas->layers);
+    free(atlas);
+}
@@ -0,0 +1,331 @@
+#include "include/baked_texture.h"
+#include "include/image.h"
+#include "include/mipmap.h"
+#include "include/texture_compress.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/**
+ * Get the path of the baked version of an image,
+ * `rainbow.png` becomes `rainbow.tgb`.
+ *
+ * @param const char* path
+ * @return char* to be freed by the caller.
+ */
+char* baked_texture_path(const char* path)
+{
+    const char* dot = strrchr(path, '.');
+    const char* slash = strrchr(path, '/');
+    size_t stem = (dot && (!slash || dot > slash)) ? (size_t) (dot - path) : strlen(path);
+
+    char* baked = malloc(stem + sizeof(BAKED_TEXTURE_EXTENSION));
+    memcpy(baked, path, stem);
+    memcpy(baked + stem, BAKED_TEXTURE_EXTENSION, sizeof(BAKED_TEXTURE_EXTENSION));
+
+    return baked;
+}
+
+/**
+ * Check that the header describes something we can upload and that
+ * every level holds exactly the bytes GL reads for it, a full mip
+ * chain of the base size with each level inside the mapping.
+ *
+ * @param const baked_texture_header_T* header
+ * @param const baked_texture_level_T* levels
+ * @param size_t size, of the whole mapping.
+ * @return int
+ */
+static int baked_texture_validate(const baked_texture_header_T* header,
+                                  const baked_texture_level_T* levels, size_t size)
+{
+    if (memcmp(header->magic, BAKED_TEXTURE_MAGIC, sizeof(BAKED_TEXTURE_MAGIC)) != 0 ||
+        header->version != BAKED_TEXTURE_VERSION ||
+        header->level_count == 0 ||
+        header->level_count > BAKED_TEXTURE_MAX_LEVELS ||
+        sizeof(*header) + header->level_count * sizeof(*levels) > size ||
+        header->width == 0 || header->height == 0)
+        return 0;
+
+    int compressed = (header->flags & BAKED_TEXTURE_FLAG_COMPRESSED) != 0;
+
+    if (compressed && header->internal_format != TEXTURE_COMPRESS_BC1 &&
+        header->internal_format != TEXTURE_COMPRESS_BC3)
+        return 0;
+
+    if (!compressed && (header->internal_format != GL_RGBA8 || header->format != GL_RGBA ||
+                        header->type != GL_UNSIGNED_BYTE))
+        return 0;
+
+    for (uint32_t i = 0; i < header->level_count; i++)
+    {
+        const baked_texture_level_T* level = &levels[i];
+        uint32_t width = header->width >> i;
+        uint32_t height = header->height >> i;
+
+        if (level->width != (width ? width : 1) || level->height != (height ? height : 1))
+            return 0;
+
+        uint64_t expected = compressed
+            ? texture_compress_size(header->internal_format, level->width, level->height)
+            : (uint64_t) level->width * level->height * sizeof(uint32_t);
+
+        if (level->size != expected || level->offset > size || level->size > size - level->offset)
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * A baked texture is out of date once the image it was baked from
+ * has been saved again.
+ *
+ * @param const char* baked_path
+ * @param const char* src
+ * @return int 1 if `src` is newer than `baked_path`, 0 when either is missing.
+ */
+int baked_texture_stale(const char* baked_path, const char* src)
+{
+    struct stat baked_st, src_st;
+
+    if (stat(baked_path, &baked_st) != 0 || stat(src, &src_st) != 0)
+        return 0;
+
+    if (src_st.st_mtim.tv_sec != baked_st.st_mtim.tv_sec)
+        return src_st.st_mtim.tv_sec > baked_st.st_mtim.tv_sec;
+
+    return src_st.st_mtim.tv_nsec > baked_st.st_mtim.tv_nsec;
+}
+
+/**
+ * Map a baked texture file into memory and validate it.
+ *
+ * @param const char* path
+ * @return baked_texture_T* or NULL when there is no usable file.
+ */
+baked_texture_T* baked_texture_open(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(baked_texture_header_T))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+        return NULL;
+
+    size_t size = st.st_size;
+    const baked_texture_header_T* header = mapping;
+    const baked_texture_level_T* levels = (const baked_texture_level_T*) (header + 1);
+
+    if (!baked_texture_validate(header, levels, size))
+    {
+        fprintf(stderr, "Invalid baked texture `%s`\n", path);
+        munmap(mapping, size);
+        return NULL;
+    }
+
+    baked_texture_T* baked = calloc(1, sizeof(struct BAKED_TEXTURE_STRUCT));
+    baked->mapping = mapping;
+    baked->mapping_size = size;
+    baked->header = header;
+    baked->levels = levels;
+
+    return baked;
+}
+
+/**
+ * Pointer to the data of a mip level, inside the mapping.
+ *
+ * @param baked_texture_T* baked
+ * @param size_t level
+ * @return const void*
+ */
+const void* baked_texture_level_data(baked_texture_T* baked, size_t level)
+{
+    return (const char*) baked->mapping + baked->levels[level].offset;
+}
+
+/**
+ * Upload the mip levels straight from the mapping, no decode
+ * and no intermediate copy.
+ *
+ * @param baked_texture_T* baked
+ * @param unsigned int texture
+ * @param size_t lod, levels to leave off the top, at most level_count - 1.
+ */
+void baked_texture_upload(baked_texture_T* baked, unsigned int texture, size_t lod)
+{
+    const baked_texture_header_T* header = baked->header;
+
+    if (lod >= header->level_count)
+        lod = header->level_count - 1;
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header->level_count - 1 - lod);
+
+    for (uint32_t i = lod; i < header->level_count; i++)
+    {
+        const baked_texture_level_T* level = &baked->levels[i];
+        const void* data = baked_texture_level_data(baked, i);
+
+        if (header->flags & BAKED_TEXTURE_FLAG_COMPRESSED)
+            glCompressedTexImage2D(GL_TEXTURE_2D, i - lod, header->internal_format,
+                                   level->width, level->height, 0, level->size, data);
+        else
+            glTexImage2D(GL_TEXTURE_2D, i - lod, header->internal_format,
+                         level->width, level->height, 0, header->format, header->type, data);
+    }
+}
+
+/**
+ * Unmap a baked texture.
+ *
+ * @param baked_texture_T* baked
+ */
+void baked_texture_close(baked_texture_T* baked)
+{
+    munmap(baked->mapping, baked->mapping_size);
+    free(baked);
+}
+
+/**
+ * Write a baked texture file.
+ * The offsets in `levels` are filled in here.
+ *
+ * @param const char* path
+ * @param const baked_texture_header_T* header
+ * @param baked_texture_level_T* levels
+ * @param const void* const* data, one pointer per level.
+ * @return int 0 on failure.
+ */
+int baked_texture_write(const char* path, const baked_texture_header_T* header,
+                        baked_texture_level_T* levels, const void* const* data)
+{
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Could not open `%s` for writing\n", path);
+        return 0;
+    }
+
+    uint64_t offset = sizeof(*header) + header->level_count * sizeof(*levels);
+
+    for (uint32_t i = 0; i < header->level_count; i++)
+    {
+        offset = (offset + BAKED_TEXTURE_ALIGNMENT - 1) & ~(uint64_t) (BAKED_TEXTURE_ALIGNMENT - 1);
+        levels[i].offset = offset;
+        offset += levels[i].size;
+    }
+
+    int ok = fwrite(header, sizeof(*header), 1, fp) == 1 &&
+             fwrite(levels, sizeof(*levels), header->level_count, fp) == header->level_count;
+
+    static const char padding[BAKED_TEXTURE_ALIGNMENT];
+
+    for (uint32_t i = 0; ok && i < header->level_count; i++)
+    {
+        long pad = (long) levels[i].offset - ftell(fp);
+        ok = fwrite(padding, 1, pad, fp) == (size_t) pad &&
+             fwrite(data[i], 1, levels[i].size, fp) == levels[i].size;
+    }
+
+    if (fclose(fp) != 0)
+        ok = 0;
+
+    if (!ok)
+        fprintf(stderr, "Could not write `%s`\n", path);
+
+    return ok;
+}
+
+/**
+ * Convert a .png into a baked texture, with a mip chain.
+ *
+ * @param const char* src
+ * @param const char* dst
+ * @param GLenum format, GL_RGBA8, TEXTURE_COMPRESS_BC1, TEXTURE_COMPRESS_BC3
+ *        or BAKED_TEXTURE_FORMAT_AUTO.
+ * @param mipmap_filter_T filter, MIPMAP_FILTER_NONE bakes only the base level.
+ * @return int 0 on failure.
+ */
+int baked_texture_bake(const char* src, const char* dst, GLenum format, mipmap_filter_T filter)
+{
+    image_T chain[BAKED_TEXTURE_MAX_LEVELS] = {};
+
+    if (!image_load(&chain[0], src))
+        return 0;
+
+    if (format == BAKED_TEXTURE_FORMAT_AUTO)
+        format = texture_compress_choose_format(&chain[0]);
+
+    uint32_t count = mipmap_generate(chain, BAKED_TEXTURE_MAX_LEVELS, filter);
+
+    int compressed = format != GL_RGBA8;
+
+    baked_texture_header_T header = {};
+    memcpy(header.magic, BAKED_TEXTURE_MAGIC, sizeof(BAKED_TEXTURE_MAGIC));
+    header.version = BAKED_TEXTURE_VERSION;
+    header.flags = compressed ? BAKED_TEXTURE_FLAG_COMPRESSED : 0;
+    header.internal_format = format;
+    header.format = compressed ? 0 : GL_RGBA;
+    header.type = compressed ? 0 : GL_UNSIGNED_BYTE;
+    header.width = chain[0].width;
+    header.height = chain[0].height;
+    header.level_count = count;
+
+    baked_texture_level_T levels[BAKED_TEXTURE_MAX_LEVELS] = {};
+    const void* data[BAKED_TEXTURE_MAX_LEVELS];
+    void* encoded[BAKED_TEXTURE_MAX_LEVELS] = {};
+    int ok = 1;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        levels[i].width = chain[i].width;
+        levels[i].height = chain[i].height;
+
+        if (compressed)
+        {
+            size_t size = 0;
+            encoded[i] = texture_compress_image(&chain[i], format, &size);
+            levels[i].size = size;
+            data[i] = encoded[i];
+            ok = ok && encoded[i] != NULL;
+        }
+        else
+        {
+            levels[i].size = (uint64_t) chain[i].width * chain[i].height * sizeof(uint32_t);
+            data[i] = chain[i].pixels;
+        }
+    }
+
+    ok = ok && baked_texture_write(dst, &header, levels, data);
+
+    mipmap_release(chain, count);
+    image_release(&chain[0]);
+
+    for (uint32_t i = 0; i < count; i++)
+        free(encoded[i]);
+
+    if (ok)
+        printf("Baked `%s` into `%s` (%ux%u, %u levels%s)\n",
+               src, dst, header.width, header.height, count,
+               format == TEXTURE_COMPRESS_BC1 ? ", BC1" : format == TEXTURE_COMPRESS_BC3 ? ", BC3" : "");
+
+    return ok;
+}
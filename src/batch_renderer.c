@@ -0,0 +1,259 @@
+#include "include/batch_renderer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Bind a VAO, through the state tracker when there is one.
+ *
+ * @param batch_renderer_T* batch
+ * @param GLuint vao
+ */
+static void batch_renderer_bind_vertex_array(batch_renderer_T* batch, GLuint vao)
+{
+    if (batch->state)
+        render_state_bind_vertex_array(batch->state, vao);
+    else
+        glBindVertexArray(vao);
+}
+
+/**
+ * Create a batch renderer drawing the geometry of `vao`.
+ * The instance attributes are added to the VAO here.
+ *
+ * @param GLuint vao
+ * @param GLint model_location, location of a mat4 attribute.
+ * @param GLint uv_rect_location, location of a vec4 attribute.
+ * @param GLint layer_location, location of a float attribute, -1 if unused.
+ * @param size_t capacity, maximum amount of instances per flush.
+ * @param render_state_T* state, shadows the VAO binding, NULL to bind directly.
+ * @return batch_renderer_T*
+ */
+batch_renderer_T* init_batch_renderer(GLuint vao, GLint model_location, GLint uv_rect_location,
+                                      GLint layer_location, size_t capacity, render_state_T* state)
+{
+    batch_renderer_T* batch = calloc(1, sizeof(struct BATCH_RENDERER_STRUCT));
+    batch->vao = vao;
+    batch->capacity = capacity;
+    batch->model_location = model_location;
+    batch->uv_rect_location = uv_rect_location;
+    batch->layer_location = layer_location;
+    batch->state = state;
+
+    /**
+     * Whole regions keep every frame's instances aligned
+     */
+    size_t region_size = capacity * sizeof(batch_instance_T);
+    region_size = (region_size + BATCH_RENDERER_ALIGNMENT - 1) & ~(size_t) (BATCH_RENDERER_ALIGNMENT - 1);
+    batch->stream = init_stream_buffer(GL_ARRAY_BUFFER, region_size);
+
+    batch_renderer_attach(batch, vao);
+
+    return batch;
+}
+
+/**
+ * Add the instance attributes to another VAO, so batch_renderer_draw
+ * can draw its geometry as well.
+ *
+ * @param batch_renderer_T* batch
+ * @param GLuint vao
+ */
+void batch_renderer_attach(batch_renderer_T* batch, GLuint vao)
+{
+    batch_renderer_bind_vertex_array(batch, vao);
+
+    for (int i = 0; i < 4; i++)
+    {
+        glEnableVertexAttribArray(batch->model_location + i);
+        glVertexAttribDivisor(batch->model_location + i, 1);
+    }
+
+    glEnableVertexAttribArray(batch->uv_rect_location);
+    glVertexAttribDivisor(batch->uv_rect_location, 1);
+
+    if (batch->layer_location >= 0)
+    {
+        glEnableVertexAttribArray(batch->layer_location);
+        glVertexAttribDivisor(batch->layer_location, 1);
+    }
+}
+
+/**
+ * Point the instance attributes of the bound VAO at instances in
+ * `buffer`, starting at byte `base`.
+ * Without base instance support (GL 4.2) this is how a draw starts
+ * part way into the buffer.
+ *
+ * @param batch_renderer_T* batch
+ * @param GLuint buffer
+ * @param size_t base
+ */
+static void batch_renderer_bind_instances(batch_renderer_T* batch, GLuint buffer, size_t base)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    /**
+     * A mat4 attribute takes up four consecutive locations, one per column.
+     */
+    for (int i = 0; i < 4; i++)
+    {
+        glVertexAttribPointer(batch->model_location + i, 4, GL_FLOAT, GL_FALSE, sizeof(batch_instance_T),
+                              (void*) (base + offsetof(batch_instance_T, model) + sizeof(vec4) * i));
+    }
+
+    glVertexAttribPointer(batch->uv_rect_location, 4, GL_FLOAT, GL_FALSE, sizeof(batch_instance_T),
+                          (void*) (base + offsetof(batch_instance_T, uv_rect)));
+
+    if (batch->layer_location >= 0)
+    {
+        glVertexAttribPointer(batch->layer_location, 1, GL_FLOAT, GL_FALSE, sizeof(batch_instance_T),
+                              (void*) (base + offsetof(batch_instance_T, layer)));
+    }
+}
+
+/**
+ * Start collecting a new frame, instances are written straight
+ * into mapped GPU memory until the flush.
+ *
+ * @param batch_renderer_T* batch
+ */
+void batch_renderer_begin(batch_renderer_T* batch)
+{
+    batch->instance_count = 0;
+    batch->draw_calls = 0;
+
+    stream_buffer_begin_frame(batch->stream);
+    batch->instances = stream_buffer_alloc(batch->stream, batch->capacity * sizeof(batch_instance_T),
+                                           BATCH_RENDERER_ALIGNMENT, &batch->instance_offset);
+}
+
+/**
+ * Add an instance.
+ *
+ * @param batch_renderer_T* batch
+ * @param mat4 model
+ * @param vec4 uv_rect
+ * @return batch_instance_T* or NULL when the batch is full.
+ */
+batch_instance_T* batch_renderer_push(batch_renderer_T* batch, mat4 model, vec4 uv_rect)
+{
+    if (batch->instances == NULL)
+        return NULL;
+
+    if (batch->instance_count == batch->capacity)
+    {
+        fprintf(stderr, "Batch renderer is full, pushed instances are dropped\n");
+        return NULL;
+    }
+
+    batch_instance_T* instance = &batch->instances[batch->instance_count++];
+    memcpy(instance->model, model, sizeof(mat4));
+    memcpy(instance->uv_rect, uv_rect, sizeof(vec4));
+    instance->layer = 0;
+
+    return instance;
+}
+
+/**
+ * Draw `count` instances starting at `first` with the geometry of `vao`.
+ * Every instance has to be pushed before the first draw of a frame,
+ * since the fallback stream buffer path unmaps here.
+ * The program and textures are expected to be bound already.
+ *
+ * @param batch_renderer_T* batch
+ * @param GLuint vao, the batch's own or one passed to batch_renderer_attach.
+ * @param size_t first
+ * @param size_t count
+ * @param GLsizei vertex_count, vertices per instance.
+ */
+void batch_renderer_draw(batch_renderer_T* batch, GLuint vao, size_t first, size_t count, GLsizei vertex_count)
+{
+    batch_renderer_commit(batch);
+
+    if (count == 0 || first + count > batch->instance_count)
+        return;
+
+    batch_renderer_bind_vertex_array(batch, vao);
+    batch_renderer_bind_instances(batch, batch->stream->buffer,
+                                  batch->instance_offset + first * sizeof(batch_instance_T));
+    glDrawArraysInstanced(GL_TRIANGLES, 0, vertex_count, count);
+    batch->draw_calls++;
+}
+
+/**
+ * Hand the pushed instances over to the GPU, nothing can be pushed
+ * after this until the next begin. Done by the first draw otherwise,
+ * call it first when something else reads the instances before that.
+ *
+ * @param batch_renderer_T* batch
+ */
+void batch_renderer_commit(batch_renderer_T* batch)
+{
+    stream_buffer_commit(batch->stream);
+    batch->instances = NULL;
+}
+
+/**
+ * Draw `command_count` indirect commands from the bound
+ * GL_DRAW_INDIRECT_BUFFER with a single call, their base instance
+ * indexes into the instances of `buffer` instead of the batch's own.
+ * The program and textures are expected to be bound already.
+ *
+ * @param batch_renderer_T* batch
+ * @param GLuint vao, the batch's own or one passed to batch_renderer_attach.
+ * @param GLuint buffer, instances laid out as batch_instance_T.
+ * @param size_t first, index of the first command.
+ * @param size_t command_count
+ */
+void batch_renderer_draw_indirect(batch_renderer_T* batch, GLuint vao, GLuint buffer,
+                                  size_t first, size_t command_count)
+{
+    batch_renderer_commit(batch);
+
+    if (command_count == 0)
+        return;
+
+    batch_renderer_bind_vertex_array(batch, vao);
+    batch_renderer_bind_instances(batch, buffer, 0);
+    glMultiDrawArraysIndirect(GL_TRIANGLES, (void*) (first * 4 * sizeof(GLuint)), command_count, 0);
+    batch->draw_calls++;
+}
+
+/**
+ * Done drawing this frame.
+ *
+ * @param batch_renderer_T* batch
+ */
+void batch_renderer_end(batch_renderer_T* batch)
+{
+    stream_buffer_end_frame(batch->stream);
+
+    batch->instances = NULL;
+    batch->instance_count = 0;
+}
+
+/**
+ * Draw the collected instances in one call, once per begin.
+ * The program and textures are expected to be bound already.
+ *
+ * @param batch_renderer_T* batch
+ * @param GLsizei vertex_count, vertices per instance.
+ */
+void batch_renderer_flush(batch_renderer_T* batch, GLsizei vertex_count)
+{
+    batch_renderer_draw(batch, batch->vao, 0, batch->instance_count, vertex_count);
+    batch_renderer_end(batch);
+}
+
+/**
+ * Free a batch renderer and its instance buffer.
+ *
+ * @param batch_renderer_T* batch
+ */
+void batch_renderer_free(batch_renderer_T* batch)
+{
+    stream_buffer_free(batch->stream);
+    free(batch);
+}
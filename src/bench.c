@@ -0,0 +1,194 @@
+#include "include/bench.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Append one result to a results file, creating it if needed.
+ * Names must not contain commas.
+ *
+ * @param const char* path
+ * @param const char* name
+ * @param const char* unit
+ * @param double value
+ * @return int 0 on failure, the error has been printed.
+ */
+int bench_record(const char* path, const char* name, const char* unit, double value)
+{
+    FILE* fp = fopen(path, "a");
+    if (!fp)
+    {
+        fprintf(stderr, "Could not open `%s`\n", path);
+        return 0;
+    }
+
+    fprintf(fp, "%s,%.6g,%s\n", name, value, unit);
+
+    if (fclose(fp) != 0)
+    {
+        fprintf(stderr, "Could not write `%s`\n", path);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @param const char* path
+ * @return bench_results_T*, NULL if the file could not be read.
+ */
+bench_results_T* bench_results_read(const char* path)
+{
+    FILE* fp = fopen(path, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "Could not read `%s`\n", path);
+        return NULL;
+    }
+
+    bench_results_T* results = calloc(1, sizeof(struct BENCH_RESULTS_STRUCT));
+    char line[BENCH_MAX_NAME + BENCH_MAX_UNIT + 64];
+    size_t number = 0;
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        number++;
+        line[strcspn(line, "\r\n")] = 0;
+
+        if (line[0] == 0 || line[0] == '#')
+            continue;
+
+        char* value = strchr(line, ',');
+        char* unit = value ? strchr(value + 1, ',') : NULL;
+        char* end = NULL;
+
+        if (unit)
+        {
+            *value++ = 0;
+            *unit++ = 0;
+            strtod(value, &end);
+        }
+
+        if (!unit || end == value || *end != 0 ||
+            strlen(line) >= BENCH_MAX_NAME || strlen(unit) >= BENCH_MAX_UNIT)
+        {
+            fprintf(stderr, "%s:%zu: expected `name,value,unit`\n", path, number);
+            continue;
+        }
+
+        bench_result_T* result = bench_results_find(results, line);
+
+        if (!result)
+        {
+            if (results->count == results->capacity)
+            {
+                results->capacity = results->capacity ? results->capacity * 2 : 16;
+                results->results = realloc(results->results, results->capacity * sizeof(bench_result_T));
+            }
+
+            result = &results->results[results->count++];
+            strcpy(result->name, line);
+        }
+
+        strcpy(result->unit, unit);
+        result->value = strtod(value, NULL);
+    }
+
+    fclose(fp);
+    return results;
+}
+
+/**
+ * @param bench_results_T* results
+ * @param const char* name
+ * @return bench_result_T*, NULL if the scenario was not recorded.
+ */
+bench_result_T* bench_results_find(bench_results_T* results, const char* name)
+{
+    for (size_t i = 0; i < results->count; i++)
+    {
+        if (strcmp(results->results[i].name, name) == 0)
+            return &results->results[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * @param const char* unit
+ * @return int 1 for rates like MB/s & frames/s.
+ */
+int bench_higher_is_better(const char* unit)
+{
+    size_t length = strlen(unit);
+    return length >= 2 && strcmp(unit + length - 2, "/s") == 0;
+}
+
+/**
+ * Print every result next to its baseline. A result more than
+ * `threshold` percent worse, or a baseline scenario that was not run
+ * at all, is a regression. New scenarios are only listed.
+ *
+ * @param bench_results_T* baseline
+ * @param bench_results_T* results
+ * @param double threshold, percent.
+ * @param FILE* out
+ * @return int amount of regressions.
+ */
+int bench_compare(bench_results_T* baseline, bench_results_T* results, double threshold, FILE* out)
+{
+    int regressions = 0;
+
+    fprintf(out, "%-40s %12s %13s %8s\n", "scenario", "baseline", "result", "change");
+
+    for (size_t i = 0; i < results->count; i++)
+    {
+        bench_result_T* result = &results->results[i];
+        bench_result_T* base = bench_results_find(baseline, result->name);
+
+        if (!base)
+        {
+            fprintf(out, "%-40s %12s %8.2f %-4s %8s\n", result->name, "-", result->value, result->unit, "new");
+            continue;
+        }
+
+        if (strcmp(base->unit, result->unit) != 0)
+        {
+            fprintf(out, "%-40s is in %s, the baseline in %s\n", result->name, result->unit, base->unit);
+            regressions++;
+            continue;
+        }
+
+        double change = base->value != 0 ? (result->value - base->value) * 100.0 / fabs(base->value) : 0;
+        double worse = bench_higher_is_better(result->unit) ? -change : change;
+        int regressed = worse > threshold;
+
+        fprintf(out, "%-40s %12.2f %8.2f %-4s %+7.1f%%%s\n", result->name, base->value, result->value,
+                result->unit, change, regressed ? "  REGRESSED" : "");
+
+        regressions += regressed;
+    }
+
+    for (size_t i = 0; i < baseline->count; i++)
+    {
+        if (bench_results_find(results, baseline->results[i].name))
+            continue;
+
+        fprintf(out, "%-40s %12.2f %13s %8s\n", baseline->results[i].name, baseline->results[i].value,
+                "-", "missing");
+        regressions++;
+    }
+
+    fprintf(out, "%d regressions over %.1f%%\n", regressions, threshold);
+    return regressions;
+}
+
+/**
+ * @param bench_results_T* results
+ */
+void bench_results_free(bench_results_T* results)
+{
+    free(results->results);
+    free(results);
+}
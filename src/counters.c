@@ -0,0 +1,439 @@
+#include "include/counters.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Everything in the page after the sequence number, copied in one go.
+ */
+#define COUNTERS_PAGE_BODY offsetof(counters_page_T, names)
+
+
+/**
+ * @return counters_T*
+ */
+counters_T* init_counters(void)
+{
+    counters_T* counters = calloc(1, sizeof(struct COUNTERS_STRUCT));
+    memcpy(counters->page.magic, COUNTERS_PAGE_MAGIC, sizeof(COUNTERS_PAGE_MAGIC));
+    counters->page.version = COUNTERS_PAGE_VERSION;
+    counters->socket = -1;
+
+    return counters;
+}
+
+/**
+ * Add a counter, names longer than COUNTERS_MAX_NAME - 1 are cut off.
+ * A total only grows, like bytes uploaded so far, a gauge is whatever
+ * it currently is, like draw calls of the last frame.
+ *
+ * @param counters_T* counters
+ * @param const char* name
+ * @param counter_kind_T kind
+ * @return size_t index to update it with, COUNTERS_MAX when full.
+ */
+size_t counters_register(counters_T* counters, const char* name, counter_kind_T kind)
+{
+    counters_page_T* page = &counters->page;
+
+    if (page->count == COUNTERS_MAX)
+    {
+        fprintf(stderr, "Too many counters, dropping `%s`\n", name);
+        return COUNTERS_MAX;
+    }
+
+    snprintf(page->names[page->count], COUNTERS_MAX_NAME, "%s", name);
+    page->kinds[page->count] = kind;
+    page->values[page->count] = 0;
+
+    return page->count++;
+}
+
+/**
+ * @param counters_T* counters
+ * @param size_t counter
+ * @param uint64_t value
+ */
+void counters_set(counters_T* counters, size_t counter, uint64_t value)
+{
+    if (counter < COUNTERS_MAX)
+        counters->page.values[counter] = value;
+}
+
+/**
+ * @param counters_T* counters
+ * @param size_t counter
+ * @param uint64_t value
+ */
+void counters_add(counters_T* counters, size_t counter, uint64_t value)
+{
+    if (counter < COUNTERS_MAX)
+        counters->page.values[counter] += value;
+}
+
+/**
+ * Count a frame into the frame time histogram.
+ *
+ * @param counters_T* counters
+ * @param uint64_t nanoseconds
+ */
+void counters_frame_time(counters_T* counters, uint64_t nanoseconds)
+{
+    uint64_t bucket = nanoseconds / COUNTERS_HISTOGRAM_STEP;
+    if (bucket >= COUNTERS_HISTOGRAM_BUCKETS)
+        bucket = COUNTERS_HISTOGRAM_BUCKETS - 1;
+
+    counters->page.histogram[bucket]++;
+}
+
+/**
+ * Frame time that `fraction` of the frames were at most, rounded up
+ * to the end of its bucket.
+ *
+ * @param const counters_page_T* page
+ * @param double fraction, 0.5 for the median.
+ * @return double milliseconds, 0 before the first frame.
+ */
+double counters_percentile(const counters_page_T* page, double fraction)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < COUNTERS_HISTOGRAM_BUCKETS; i++)
+        total += page->histogram[i];
+
+    if (total == 0)
+        return 0;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < COUNTERS_HISTOGRAM_BUCKETS; i++)
+    {
+        seen += page->histogram[i];
+        if (seen >= fraction * total)
+            return (i + 1) * (COUNTERS_HISTOGRAM_STEP / 1e6);
+    }
+
+    return COUNTERS_HISTOGRAM_BUCKETS * (COUNTERS_HISTOGRAM_STEP / 1e6);
+}
+
+/**
+ * Format every counter as a `name value` line, followed by the frame
+ * time percentiles and optionally the non empty histogram buckets.
+ *
+ * @param const counters_page_T* page
+ * @param int histogram
+ * @param char* out
+ * @param size_t size
+ * @return size_t length of the text, cut off at size - 1.
+ */
+size_t counters_format(const counters_page_T* page, int histogram, char* out, size_t size)
+{
+    size_t length = 0;
+
+#define COUNTERS_PRINT(...) \
+    if (length < size) \
+        length += snprintf(out + length, size - length, __VA_ARGS__)
+
+    for (uint32_t i = 0; i < page->count && i < COUNTERS_MAX; i++)
+    {
+        COUNTERS_PRINT("%.*s %llu\n", COUNTERS_MAX_NAME, page->names[i], (unsigned long long) page->values[i]);
+    }
+
+    COUNTERS_PRINT("frame_ms p50 %.0f p99 %.0f\n", counters_percentile(page, 0.5), counters_percentile(page, 0.99));
+
+    if (histogram)
+    {
+        COUNTERS_PRINT("frame_ms_histogram");
+
+        for (size_t i = 0; i < COUNTERS_HISTOGRAM_BUCKETS; i++)
+        {
+            if (page->histogram[i] == 0)
+                continue;
+
+            COUNTERS_PRINT(" %zu%s:%llu", i, i == COUNTERS_HISTOGRAM_BUCKETS - 1 ? "+" : "",
+                           (unsigned long long) page->histogram[i]);
+        }
+
+        COUNTERS_PRINT("\n");
+    }
+
+#undef COUNTERS_PRINT
+
+    if (size > 0 && length >= size)
+        length = size - 1;
+
+    return length;
+}
+
+/**
+ * A shared memory object is ours to replace when it holds counters of
+ * a process that no longer runs, left behind by a crash.
+ *
+ * @param const char* name
+ * @return int 0 if it belongs to a live exporter or to something else.
+ */
+static int counters_shared_abandoned(const char* name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    const counters_page_T* page = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= offsetof(counters_page_T, names))
+        page = mmap(NULL, offsetof(counters_page_T, names), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (page == MAP_FAILED)
+        return 0;
+
+    int abandoned = memcmp(page->magic, COUNTERS_PAGE_MAGIC, sizeof(COUNTERS_PAGE_MAGIC)) == 0 &&
+                    (page->version != COUNTERS_PAGE_VERSION ||
+                     (kill((pid_t) page->owner, 0) != 0 && errno == ESRCH));
+
+    munmap((void*) page, offsetof(counters_page_T, names));
+
+    return abandoned;
+}
+
+/**
+ * Mirror the counters into a POSIX shared memory object, see
+ * counters_read_shared. An object of that name is only replaced when
+ * the process that exported it is gone.
+ *
+ * @param counters_T* counters
+ * @param const char* name, like `/texturegl`.
+ * @return int 0 on failure, the error has been printed.
+ */
+int counters_export_shared(counters_T* counters, const char* name)
+{
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+
+    if (fd < 0 && errno == EEXIST && counters_shared_abandoned(name))
+    {
+        shm_unlink(name);
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+
+    if (fd < 0)
+    {
+        if (errno == EEXIST)
+            fprintf(stderr, "Shared memory `%s` is already in use\n", name);
+        else
+            fprintf(stderr, "Could not create shared memory `%s`\n", name);
+        return 0;
+    }
+
+    void* mapping = MAP_FAILED;
+    if (ftruncate(fd, sizeof(counters_page_T)) == 0)
+        mapping = mmap(NULL, sizeof(counters_page_T), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "Could not map shared memory `%s`\n", name);
+        shm_unlink(name);
+        return 0;
+    }
+
+    counters->shared = mapping;
+    counters->shared_name = strdup(name);
+
+    memset(counters->shared, 0, sizeof(counters_page_T));
+    memcpy(counters->shared->magic, COUNTERS_PAGE_MAGIC, sizeof(COUNTERS_PAGE_MAGIC));
+    counters->shared->version = COUNTERS_PAGE_VERSION;
+    counters->shared->owner = getpid();
+
+    return 1;
+}
+
+/**
+ * Answer connections on a unix socket with a text snapshot,
+ * try `nc -U path`.
+ *
+ * @param counters_T* counters
+ * @param const char* path, replaced if it is a socket nobody listens on.
+ * @return int 0 on failure, the error has been printed.
+ */
+int counters_listen(counters_T* counters, const char* path)
+{
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Socket path `%s` is too long\n", path);
+        return 0;
+    }
+
+    strcpy(address.sun_path, path);
+
+    /**
+     * Only a socket left behind by an earlier run is removed,
+     * never a file that happens to have the name
+     */
+    struct stat st;
+    if (lstat(path, &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            fprintf(stderr, "`%s` exists and is not a socket\n", path);
+            return 0;
+        }
+
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int live = probe >= 0 && connect(probe, (struct sockaddr*) &address, sizeof(address)) == 0;
+        if (probe >= 0)
+            close(probe);
+
+        if (live)
+        {
+            fprintf(stderr, "Socket `%s` is already in use\n", path);
+            return 0;
+        }
+
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0 || bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(fd, 8) != 0)
+    {
+        fprintf(stderr, "Could not listen on `%s`\n", path);
+        if (fd >= 0)
+            close(fd);
+        return 0;
+    }
+
+    counters->socket = fd;
+    counters->socket_path = strdup(path);
+
+    return 1;
+}
+
+/**
+ * Hand this frame's counters to whoever watches, never blocks.
+ * Call once per frame.
+ *
+ * @param counters_T* counters
+ */
+void counters_publish(counters_T* counters)
+{
+    if (counters->shared)
+    {
+        counters_page_T* shared = counters->shared;
+        uint64_t sequence = atomic_load_explicit(&shared->sequence, memory_order_relaxed);
+
+        atomic_store_explicit(&shared->sequence, sequence + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        shared->count = counters->page.count;
+        memcpy((char*) shared + COUNTERS_PAGE_BODY, (const char*) &counters->page + COUNTERS_PAGE_BODY,
+               sizeof(counters_page_T) - COUNTERS_PAGE_BODY);
+
+        atomic_store_explicit(&shared->sequence, sequence + 2, memory_order_release);
+    }
+
+    if (counters->socket < 0)
+        return;
+
+    int client;
+    while ((client = accept(counters->socket, NULL, NULL)) >= 0)
+    {
+        char text[4096];
+        size_t length = counters_format(&counters->page, 1, text, sizeof(text));
+
+        /**
+         * A snapshot fits the socket buffer, a reader that went away
+         * must not kill us with SIGPIPE
+         */
+        send(client, text, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+        close(client);
+    }
+}
+
+/**
+ * Take a consistent copy of the counters another process exports.
+ *
+ * @param const char* name
+ * @param counters_page_T* page
+ * @return int 0 if there is no such page, the error has been printed.
+ */
+int counters_read_shared(const char* name, counters_page_T* page)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        fprintf(stderr, "No counters are exported as `%s`\n", name);
+        return 0;
+    }
+
+    /**
+     * Reading past the end of a shorter object would raise SIGBUS
+     */
+    struct stat st;
+    const counters_page_T* shared = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(counters_page_T))
+        shared = mmap(NULL, sizeof(counters_page_T), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (shared == MAP_FAILED || memcmp(shared->magic, COUNTERS_PAGE_MAGIC, sizeof(COUNTERS_PAGE_MAGIC)) != 0 ||
+        shared->version != COUNTERS_PAGE_VERSION)
+    {
+        fprintf(stderr, "Invalid counters `%s`\n", name);
+        if (shared != MAP_FAILED)
+            munmap((void*) shared, sizeof(counters_page_T));
+        return 0;
+    }
+
+    uint64_t before, after;
+
+    do
+    {
+        before = atomic_load_explicit(&((counters_page_T*) shared)->sequence, memory_order_acquire);
+
+        memcpy(page->magic, shared->magic, sizeof(page->magic));
+        page->version = shared->version;
+        page->count = shared->count;
+        memcpy((char*) page + COUNTERS_PAGE_BODY, (const char*) shared + COUNTERS_PAGE_BODY,
+               sizeof(counters_page_T) - COUNTERS_PAGE_BODY);
+
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&((counters_page_T*) shared)->sequence, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    munmap((void*) shared, sizeof(counters_page_T));
+    return 1;
+}
+
+/**
+ * Stop exporting & free the counters.
+ *
+ * @param counters_T* counters
+ */
+void counters_free(counters_T* counters)
+{
+    if (counters->shared)
+    {
+        munmap(counters->shared, sizeof(counters_page_T));
+        shm_unlink(counters->shared_name);
+        free(counters->shared_name);
+    }
+
+    if (counters->socket >= 0)
+    {
+        close(counters->socket);
+        unlink(counters->socket_path);
+        free(counters->socket_path);
+    }
+
+    free(counters);
+}
@@ -0,0 +1,212 @@
+#include "include/file_watch.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#define FILE_WATCH_INOTIFY 1
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#include <sys/event.h>
+#define FILE_WATCH_KQUEUE 1
+#endif
+
+
+/**
+ * Create a file watcher.
+ *
+ * @return file_watch_T*, watching nothing when the platform has no
+ *         change notifications.
+ */
+file_watch_T* init_file_watch(void)
+{
+    file_watch_T* watch = calloc(1, sizeof(struct FILE_WATCH_STRUCT));
+
+#if defined(FILE_WATCH_INOTIFY)
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#elif defined(FILE_WATCH_KQUEUE)
+    watch->fd = kqueue();
+#else
+    watch->fd = -1;
+#endif
+
+    if (watch->fd < 0)
+        fprintf(stderr, "File watching is not available, changes will not be reloaded\n");
+
+    return watch;
+}
+
+#if defined(FILE_WATCH_KQUEUE)
+/**
+ * (Re)open a file & register it with the kqueue.
+ *
+ * @param file_watch_T* watch
+ * @param size_t index
+ * @return int 0 if the file could not be opened.
+ */
+static int file_watch_open(file_watch_T* watch, size_t index)
+{
+    file_watch_entry_T* entry = &watch->entries[index];
+
+    if (entry->handle >= 0)
+        close(entry->handle);
+
+    entry->handle = open(entry->path, O_RDONLY | O_CLOEXEC);
+    if (entry->handle < 0)
+        return 0;
+
+    struct kevent change;
+    EV_SET(&change, entry->handle, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+           NOTE_WRITE | NOTE_EXTEND | NOTE_DELETE | NOTE_RENAME, 0, (void*) (intptr_t) index);
+
+    return kevent(watch->fd, &change, 1, NULL, 0, NULL) == 0;
+}
+#endif
+
+/**
+ * Call `fn` whenever `path` has been written to.
+ *
+ * @param file_watch_T* watch
+ * @param const char* path
+ * @param file_watch_fn_T* fn
+ * @param void* data, passed on to fn.
+ * @return int 0 if the file cannot be watched.
+ */
+int file_watch_add(file_watch_T* watch, const char* path, file_watch_fn_T* fn, void* data)
+{
+    if (watch->fd < 0)
+        return 0;
+
+    watch->entries = realloc(watch->entries, (watch->entry_count + 1) * sizeof(file_watch_entry_T));
+
+    file_watch_entry_T* entry = &watch->entries[watch->entry_count];
+    entry->path = strdup(path);
+    entry->fn = fn;
+    entry->data = data;
+    entry->changed = 0;
+    entry->handle = -1;
+
+    const char* slash = strrchr(path, '/');
+    entry->name = strdup(slash ? slash + 1 : path);
+
+    int ok = 0;
+
+#if defined(FILE_WATCH_INOTIFY)
+    char* directory = slash ? strndup(path, slash - path + 1) : strdup(".");
+    entry->handle = inotify_add_watch(watch->fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+    ok = entry->handle >= 0;
+    free(directory);
+#elif defined(FILE_WATCH_KQUEUE)
+    ok = file_watch_open(watch, watch->entry_count);
+#endif
+
+    if (!ok)
+    {
+        fprintf(stderr, "Could not watch `%s`\n", path);
+        free(entry->path);
+        free(entry->name);
+        return 0;
+    }
+
+    watch->entry_count++;
+    return 1;
+}
+
+/**
+ * Call the callbacks of files that changed since the last poll, never
+ * blocks. Several writes in between only call back once.
+ *
+ * @param file_watch_T* watch
+ * @return size_t amount of files that changed.
+ */
+size_t file_watch_poll(file_watch_T* watch)
+{
+    if (watch->fd < 0)
+        return 0;
+
+#if defined(FILE_WATCH_INOTIFY)
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+
+    while ((length = read(watch->fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char* p = buffer; p < buffer + length;)
+        {
+            const struct inotify_event* event = (const struct inotify_event*) p;
+
+            for (size_t i = 0; event->len > 0 && i < watch->entry_count; i++)
+            {
+                file_watch_entry_T* entry = &watch->entries[i];
+                if (entry->handle == event->wd && strcmp(entry->name, event->name) == 0)
+                    entry->changed = 1;
+            }
+
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+#elif defined(FILE_WATCH_KQUEUE)
+    struct kevent events[16];
+    struct timespec zero = { 0, 0 };
+    int count;
+
+    while ((count = kevent(watch->fd, NULL, 0, events, 16, &zero)) > 0)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            size_t index = (size_t) (intptr_t) events[i].udata;
+            if (index >= watch->entry_count)
+                continue;
+
+            watch->entries[index].changed = 1;
+
+            /**
+             * Saved by replacing the file, follow the new one
+             */
+            if (events[i].fflags & (NOTE_DELETE | NOTE_RENAME))
+                file_watch_open(watch, index);
+        }
+    }
+#endif
+
+    size_t changed = 0;
+
+    for (size_t i = 0; i < watch->entry_count; i++)
+    {
+        file_watch_entry_T* entry = &watch->entries[i];
+        if (!entry->changed)
+            continue;
+
+        entry->changed = 0;
+        entry->fn(entry->path, entry->data);
+        changed++;
+    }
+
+    return changed;
+}
+
+/**
+ * Stop watching and free the watcher.
+ *
+ * @param file_watch_T* watch
+ */
+void file_watch_free(file_watch_T* watch)
+{
+    for (size_t i = 0; i < watch->entry_count; i++)
+    {
+#if defined(FILE_WATCH_KQUEUE)
+        if (watch->entries[i].handle >= 0)
+            close(watch->entries[i].handle);
+#endif
+        free(watch->entries[i].path);
+        free(watch->entries[i].name);
+    }
+
+    if (watch->fd >= 0)
+        close(watch->fd);
+
+    free(watch->entries);
+    free(watch);
+}
@@ -0,0 +1,188 @@
+#include "include/frame_pacer.h"
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/**
+ * @return uint64_t monotonic nanoseconds.
+ */
+static uint64_t frame_pacer_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * Create a frame pacer.
+ *
+ * @param frame_pacer_mode_T mode
+ * @param double fps, frame rate of FRAME_PACER_CAPPED.
+ * @param size_t max_queued, frames the CPU may run ahead, 0 to not throttle.
+ * @param int finish, wait for the GPU with glFinish after every frame.
+ * @return frame_pacer_T*
+ */
+frame_pacer_T* init_frame_pacer(frame_pacer_mode_T mode, double fps, size_t max_queued, int finish)
+{
+    frame_pacer_T* pacer = calloc(1, sizeof(struct FRAME_PACER_STRUCT));
+    pacer->mode = mode;
+    pacer->period = fps > 0 ? (uint64_t) (1e9 / fps) : 0;
+    pacer->max_queued = max_queued > FRAME_PACER_MAX_QUEUED ? FRAME_PACER_MAX_QUEUED : max_queued;
+    pacer->finish = finish;
+
+    if (mode == FRAME_PACER_CAPPED && pacer->period == 0)
+    {
+        fprintf(stderr, "A frame cap needs a frame rate, running uncapped\n");
+        pacer->mode = FRAME_PACER_UNCAPPED;
+    }
+
+    return pacer;
+}
+
+/**
+ * Parse a present mode name.
+ *
+ * @param const char* name, vsync, adaptive, uncapped or cap.
+ * @param frame_pacer_mode_T* mode
+ * @return int 0 if the name is unknown.
+ */
+int frame_pacer_parse_mode(const char* name, frame_pacer_mode_T* mode)
+{
+    if (strcmp(name, "vsync") == 0)
+        *mode = FRAME_PACER_VSYNC;
+    else if (strcmp(name, "adaptive") == 0)
+        *mode = FRAME_PACER_ADAPTIVE;
+    else if (strcmp(name, "uncapped") == 0)
+        *mode = FRAME_PACER_UNCAPPED;
+    else if (strcmp(name, "cap") == 0)
+        *mode = FRAME_PACER_CAPPED;
+    else
+        return 0;
+
+    return 1;
+}
+
+/**
+ * Set the swap interval of the current context.
+ * Adaptive vsync (a negative interval) tears instead of waiting a whole
+ * extra refresh when a frame is late, it needs swap_control_tear.
+ *
+ * @param frame_pacer_T* pacer
+ */
+void frame_pacer_apply(frame_pacer_T* pacer)
+{
+    switch (pacer->mode)
+    {
+        case FRAME_PACER_VSYNC:
+            glfwSwapInterval(1);
+            break;
+        case FRAME_PACER_ADAPTIVE:
+            if (glfwExtensionSupported("GLX_EXT_swap_control_tear") ||
+                glfwExtensionSupported("WGL_EXT_swap_control_tear"))
+            {
+                glfwSwapInterval(-1);
+            }
+            else
+            {
+                fprintf(stderr, "Adaptive vsync is not supported, using vsync\n");
+                pacer->mode = FRAME_PACER_VSYNC;
+                glfwSwapInterval(1);
+            }
+            break;
+        case FRAME_PACER_UNCAPPED:
+        case FRAME_PACER_CAPPED:
+            glfwSwapInterval(0);
+            break;
+    }
+
+    pacer->deadline = 0;
+}
+
+/**
+ * Call at the very start of a frame.
+ * Waits for the frame cap and for the GPU to catch up to `max_queued`
+ * frames behind, so input sampled afterwards is as fresh as possible.
+ *
+ * @param frame_pacer_T* pacer
+ */
+void frame_pacer_wait(frame_pacer_T* pacer)
+{
+    if (pacer->max_queued > 0)
+    {
+        GLsync fence = pacer->fences[pacer->fence_index];
+        if (fence)
+        {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            glDeleteSync(fence);
+            pacer->fences[pacer->fence_index] = NULL;
+        }
+    }
+
+    if (pacer->mode != FRAME_PACER_CAPPED)
+        return;
+
+    uint64_t now = frame_pacer_now();
+
+    /**
+     * After a hitch, start over instead of rushing frames out
+     * to catch up.
+     */
+    if (pacer->deadline == 0 || now > pacer->deadline + pacer->period)
+    {
+        if (pacer->deadline)
+            pacer->missed++;
+
+        pacer->deadline = now + pacer->period;
+        return;
+    }
+
+    if (pacer->deadline > now + FRAME_PACER_SPIN_NS)
+    {
+        uint64_t wake = pacer->deadline - FRAME_PACER_SPIN_NS;
+        struct timespec ts = { (time_t) (wake / 1000000000ull), (long) (wake % 1000000000ull) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+
+    while (frame_pacer_now() < pacer->deadline)
+        ;
+
+    pacer->deadline += pacer->period;
+}
+
+/**
+ * Call right after presenting.
+ *
+ * @param frame_pacer_T* pacer
+ */
+void frame_pacer_end_frame(frame_pacer_T* pacer)
+{
+    if (pacer->finish)
+    {
+        glFinish();
+        return;
+    }
+
+    if (pacer->max_queued == 0)
+        return;
+
+    pacer->fences[pacer->fence_index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pacer->fence_index = (pacer->fence_index + 1) % pacer->max_queued;
+}
+
+/**
+ * @param frame_pacer_T* pacer
+ */
+void frame_pacer_free(frame_pacer_T* pacer)
+{
+    for (size_t i = 0; i < FRAME_PACER_MAX_QUEUED; i++)
+    {
+        if (pacer->fences[i])
+            glDeleteSync(pacer->fences[i]);
+    }
+
+    free(pacer);
+}
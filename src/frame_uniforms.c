@@ -0,0 +1,87 @@
+#include "include/frame_uniforms.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Create the per frame uniform buffer.
+ *
+ * @return frame_uniforms_T*
+ */
+frame_uniforms_T* init_frame_uniforms(void)
+{
+    frame_uniforms_T* uniforms = calloc(1, sizeof(struct FRAME_UNIFORMS_STRUCT));
+
+    /**
+     * Ranges bound with glBindBufferRange must start on this alignment,
+     * rounding the regions up to it keeps every frame's block aligned.
+     */
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniforms->alignment = alignment > 0 ? alignment : 256;
+
+    size_t size = (sizeof(frame_uniforms_block_T) + uniforms->alignment - 1) & ~(uniforms->alignment - 1);
+    uniforms->stream = init_stream_buffer(GL_UNIFORM_BUFFER, size);
+
+    return uniforms;
+}
+
+/**
+ * Point a program's `Frame` block at our binding.
+ * Needed once per program, including ones loaded from a binary.
+ *
+ * @param GLuint program
+ * @return int 0 if the program has no such block.
+ */
+int frame_uniforms_bind_program(GLuint program)
+{
+    GLuint index = glGetUniformBlockIndex(program, FRAME_UNIFORMS_BLOCK_NAME);
+    if (index == GL_INVALID_INDEX)
+        return 0;
+
+    glUniformBlockBinding(program, index, FRAME_UNIFORMS_BINDING);
+    return 1;
+}
+
+/**
+ * Upload this frame's block and bind it for every draw that follows.
+ *
+ * @param frame_uniforms_T* uniforms
+ * @param const frame_uniforms_block_T* block
+ */
+void frame_uniforms_begin(frame_uniforms_T* uniforms, const frame_uniforms_block_T* block)
+{
+    size_t offset;
+
+    stream_buffer_begin_frame(uniforms->stream);
+    void* data = stream_buffer_alloc(uniforms->stream, sizeof(*block), uniforms->alignment, &offset);
+    if (data == NULL)
+        return;
+
+    memcpy(data, block, sizeof(*block));
+    stream_buffer_commit(uniforms->stream);
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, uniforms->stream->buffer,
+                      offset, sizeof(*block));
+}
+
+/**
+ * Fence the block, call after the frame's draws were submitted.
+ *
+ * @param frame_uniforms_T* uniforms
+ */
+void frame_uniforms_end(frame_uniforms_T* uniforms)
+{
+    stream_buffer_end_frame(uniforms->stream);
+}
+
+/**
+ * Free the uniform buffer.
+ *
+ * @param frame_uniforms_T* uniforms
+ */
+void frame_uniforms_free(frame_uniforms_T* uniforms)
+{
+    stream_buffer_free(uniforms->stream);
+    free(uniforms);
+}
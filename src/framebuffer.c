@@ -0,0 +1,50 @@
+#include "include/framebuffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/**
+ * Create an RGBA8 framebuffer.
+ *
+ * @param int width
+ * @param int height
+ * @return framebuffer_T* or NULL if the driver refuses it.
+ */
+framebuffer_T* init_framebuffer(int width, int height)
+{
+    framebuffer_T* framebuffer = calloc(1, sizeof(struct FRAMEBUFFER_STRUCT));
+    framebuffer->width = width;
+    framebuffer->height = height;
+
+    glGenRenderbuffers(1, &framebuffer->color);
+    glBindRenderbuffer(GL_RENDERBUFFER, framebuffer->color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenFramebuffers(1, &framebuffer->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, framebuffer->color);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        fprintf(stderr, "Framebuffer %dx%d is incomplete (0x%x)\n", width, height, status);
+        framebuffer_free(framebuffer);
+        return NULL;
+    }
+
+    return framebuffer;
+}
+
+/**
+ * Free a framebuffer.
+ *
+ * @param framebuffer_T* framebuffer
+ */
+void framebuffer_free(framebuffer_T* framebuffer)
+{
+    glDeleteFramebuffers(1, &framebuffer->fbo);
+    glDeleteRenderbuffers(1, &framebuffer->color);
+    free(framebuffer);
+}
@@ -0,0 +1,228 @@
+#include "include/gpu_cull.h"
+#include "include/frame_uniforms.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Instances are read as plain floats with a stride, so the shader
+ * does not depend on how the compiler pads batch_instance_T.
+ */
+_Static_assert(offsetof(batch_instance_T, model) == 0, "model first");
+_Static_assert(sizeof(batch_instance_T) % sizeof(float) == 0, "float stride");
+
+static const char* cull_shader_text =
+    "#version 430 core\n"
+    "layout(local_size_x = 64) in;\n"
+    "layout(std140) uniform Frame { mat4 VP; vec2 Viewport; vec2 Cursor; float Time; };\n"
+    "struct Command { uint count; uint instanceCount; uint first; uint baseInstance; };\n"
+    "layout(std430, binding = 0) readonly buffer Instances { float instances[]; };\n"
+    "layout(std430, binding = 1) writeonly buffer Visible { float visible[]; };\n"
+    "layout(std430, binding = 2) buffer Commands { Command commands[]; };\n"
+    "uniform uint InstanceCount;\n"
+    "uniform uint CommandCount;\n"
+    "uniform uint Stride;\n"
+    "uniform float Radius;\n"
+    "void main()\n"
+    "{\n"
+    "    uint i = gl_GlobalInvocationID.x;\n"
+    "    if (i >= InstanceCount)\n"
+    "        return;\n"
+    "    uint base = i * Stride;\n"
+    "    mat4 model;\n"
+    "    for (uint c = 0u; c < 4u; c++)\n"
+    "        model[c] = vec4(instances[base + c * 4u], instances[base + c * 4u + 1u],\n"
+    "                        instances[base + c * 4u + 2u], instances[base + c * 4u + 3u]);\n"
+    "    vec4 center = vec4(model[3].xyz, 1.0);\n"
+    "    float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));\n"
+    "    float radius = Radius * scale;\n"
+    "    mat4 rows = transpose(VP);\n"
+    "    for (int p = 0; p < 6; p++)\n"
+    "    {\n"
+    "        vec4 plane = rows[3] + ((p & 1) == 0 ? rows[p / 2] : -rows[p / 2]);\n"
+    "        if (dot(plane, center) < -radius * length(plane.xyz))\n"
+    "            return;\n"
+    "    }\n"
+    "    uint lo = 0u, hi = CommandCount - 1u;\n"
+    "    while (lo < hi)\n"
+    "    {\n"
+    "        uint mid = (lo + hi + 1u) / 2u;\n"
+    "        if (commands[mid].baseInstance <= i) lo = mid; else hi = mid - 1u;\n"
+    "    }\n"
+    "    uint slot = commands[lo].baseInstance + atomicAdd(commands[lo].instanceCount, 1u);\n"
+    "    for (uint f = 0u; f < Stride; f++)\n"
+    "        visible[slot * Stride + f] = instances[base + f];\n"
+    "}\n";
+
+
+/**
+ * Compile & link the culling shader.
+ *
+ * @return GLuint program, 0 on failure, the error has been printed.
+ */
+static GLuint gpu_cull_build(void)
+{
+    char info_log[512];
+    GLint success = 0;
+
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &cull_shader_text, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+
+    if (!success)
+    {
+        glGetShaderInfoLog(shader, sizeof(info_log), NULL, info_log);
+        fprintf(stderr, "cull compute shader error: %s\n", info_log);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+    if (!success)
+    {
+        glGetProgramInfoLog(program, sizeof(info_log), NULL, info_log);
+        fprintf(stderr, "cull link error: %s\n", info_log);
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    frame_uniforms_bind_program(program);
+    return program;
+}
+
+/**
+ * Create the culling pass. Needs compute shaders, storage buffers &
+ * multi draw indirect, all core in OpenGL 4.3.
+ *
+ * @param size_t capacity, maximum amount of instances per frame.
+ * @param float radius, of a sphere around the untransformed geometry.
+ * @return gpu_cull_T* or NULL when not supported, draw instanced instead.
+ */
+gpu_cull_T* init_gpu_cull(size_t capacity, float radius)
+{
+    if (!GLEW_VERSION_4_3)
+    {
+        fprintf(stderr, "GPU culling needs OpenGL 4.3, drawing instanced instead\n");
+        return NULL;
+    }
+
+    GLuint program = gpu_cull_build();
+    if (program == 0)
+        return NULL;
+
+    gpu_cull_T* cull = calloc(1, sizeof(struct GPU_CULL_STRUCT));
+    cull->program = program;
+    cull->capacity = capacity;
+    cull->radius = radius;
+    cull->instance_count_location = glGetUniformLocation(program, "InstanceCount");
+    cull->command_count_location = glGetUniformLocation(program, "CommandCount");
+    cull->stride_location = glGetUniformLocation(program, "Stride");
+    cull->radius_location = glGetUniformLocation(program, "Radius");
+
+    /**
+     * Only ever written by the GPU
+     */
+    glGenBuffers(1, &cull->visible);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, cull->visible);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(batch_instance_T), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenBuffers(1, &cull->indirect);
+
+    return cull;
+}
+
+/**
+ * Start recording the runs of a new frame.
+ *
+ * @param gpu_cull_T* cull
+ */
+void gpu_cull_begin(gpu_cull_T* cull)
+{
+    cull->command_count = 0;
+}
+
+/**
+ * Add a run of instances sharing one draw, it becomes one indirect
+ * command. Runs must be added in instance order.
+ *
+ * @param gpu_cull_T* cull
+ * @param size_t first, instance the run starts at.
+ * @param GLsizei vertex_count
+ */
+void gpu_cull_add(gpu_cull_T* cull, size_t first, GLsizei vertex_count)
+{
+    if (cull->command_count == cull->command_capacity)
+    {
+        cull->command_capacity = cull->command_capacity ? cull->command_capacity * 2 : 16;
+        cull->commands = realloc(cull->commands, cull->command_capacity * sizeof(gpu_cull_command_T));
+    }
+
+    gpu_cull_command_T* command = &cull->commands[cull->command_count++];
+    command->count = vertex_count;
+    command->instance_count = 0;
+    command->first = 0;
+    command->base_instance = first;
+}
+
+/**
+ * Cull `count` instances read from `instances` at `offset`, which must
+ * meet GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT. Leaves the indirect
+ * commands bound to GL_DRAW_INDIRECT_BUFFER, in the order they were
+ * added, ready for glMultiDrawArraysIndirect with `visible` as the
+ * instance buffer. The Frame block must be bound.
+ *
+ * @param gpu_cull_T* cull
+ * @param render_state_T* state
+ * @param GLuint instances
+ * @param size_t offset
+ * @param size_t count
+ */
+void gpu_cull_dispatch(gpu_cull_T* cull, render_state_T* state, GLuint instances, size_t offset, size_t count)
+{
+    if (count > cull->capacity)
+        count = cull->capacity;
+
+    /**
+     * Orphan the commands every frame rather than waiting for the
+     * previous frame's draws to finish reading them
+     */
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cull->indirect);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, cull->command_count * sizeof(gpu_cull_command_T),
+                 cull->commands, GL_STREAM_DRAW);
+
+    if (count == 0 || cull->command_count == 0)
+        return;
+
+    render_state_use_program(state, cull->program);
+    glUniform1ui(cull->instance_count_location, count);
+    glUniform1ui(cull->command_count_location, cull->command_count);
+    glUniform1ui(cull->stride_location, sizeof(batch_instance_T) / sizeof(float));
+    glUniform1f(cull->radius_location, cull->radius);
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, instances, offset, count * sizeof(batch_instance_T));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, cull->visible);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cull->indirect);
+
+    glDispatchCompute((count + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    cull->dispatches++;
+}
+
+/**
+ * @param gpu_cull_T* cull
+ */
+void gpu_cull_free(gpu_cull_T* cull)
+{
+    glDeleteBuffers(1, &cull->visible);
+    glDeleteBuffers(1, &cull->indirect);
+    glDeleteProgram(cull->program);
+    free(cull->commands);
+    free(cull);
+}
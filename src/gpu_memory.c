@@ -0,0 +1,247 @@
+#include "include/gpu_memory.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Levels walked when measuring a texture, enough for 32768x32768.
+ */
+#define GPU_MEMORY_MAX_LEVELS 16
+
+
+/**
+ * Create a memory tracker.
+ *
+ * @param size_t budget, bytes, 0 only keeps to what the driver has left.
+ * @return gpu_memory_T*
+ */
+gpu_memory_T* init_gpu_memory(size_t budget)
+{
+    gpu_memory_T* memory = calloc(1, sizeof(struct GPU_MEMORY_STRUCT));
+    memory->budget = budget;
+
+    gpu_memory_update(memory);
+
+    return memory;
+}
+
+/**
+ * Count `bytes` as allocated.
+ *
+ * @param gpu_memory_T* memory
+ * @param gpu_memory_kind_T kind
+ * @param size_t bytes
+ */
+void gpu_memory_add(gpu_memory_T* memory, gpu_memory_kind_T kind, size_t bytes)
+{
+    memory->used[kind] += bytes;
+
+    size_t used = gpu_memory_used(memory);
+    if (used > memory->peak)
+        memory->peak = used;
+}
+
+/**
+ * Count `bytes` as freed.
+ *
+ * @param gpu_memory_T* memory
+ * @param gpu_memory_kind_T kind
+ * @param size_t bytes
+ */
+void gpu_memory_remove(gpu_memory_T* memory, gpu_memory_kind_T kind, size_t bytes)
+{
+    memory->used[kind] -= bytes < memory->used[kind] ? bytes : memory->used[kind];
+}
+
+/**
+ * @param gpu_memory_T* memory
+ * @return size_t bytes tracked over all kinds.
+ */
+size_t gpu_memory_used(gpu_memory_T* memory)
+{
+    size_t used = 0;
+    for (int i = 0; i < GPU_MEMORY_KIND_COUNT; i++)
+        used += memory->used[i];
+
+    return used;
+}
+
+/**
+ * How much has to be freed to get back within the budget, or to leave
+ * the driver GPU_MEMORY_RESERVE when it tells us what it has left.
+ *
+ * @param gpu_memory_T* memory
+ * @return size_t bytes, 0 when within budget.
+ */
+size_t gpu_memory_over_budget(gpu_memory_T* memory)
+{
+    size_t used = gpu_memory_used(memory);
+    size_t over = memory->budget && used > memory->budget ? used - memory->budget : 0;
+
+    if (memory->available && memory->available < GPU_MEMORY_RESERVE &&
+        GPU_MEMORY_RESERVE - memory->available > over)
+        over = GPU_MEMORY_RESERVE - memory->available;
+
+    return over;
+}
+
+/**
+ * How much more can be allocated before going over budget.
+ *
+ * @param gpu_memory_T* memory
+ * @return size_t bytes, SIZE_MAX without a budget or driver numbers.
+ */
+size_t gpu_memory_headroom(gpu_memory_T* memory)
+{
+    size_t used = gpu_memory_used(memory);
+    size_t headroom = SIZE_MAX;
+
+    if (memory->budget)
+        headroom = used < memory->budget ? memory->budget - used : 0;
+
+    if (memory->available)
+    {
+        size_t left = memory->available > GPU_MEMORY_RESERVE ? memory->available - GPU_MEMORY_RESERVE : 0;
+        if (left < headroom)
+            headroom = left;
+    }
+
+    return headroom;
+}
+
+/**
+ * Ask the driver for free memory every GPU_MEMORY_QUERY_INTERVAL
+ * frames, call once per frame.
+ *
+ * @param gpu_memory_T* memory
+ */
+void gpu_memory_update(gpu_memory_T* memory)
+{
+    if (memory->frame++ % GPU_MEMORY_QUERY_INTERVAL != 0)
+        return;
+
+    GLint kb[4] = { 0, 0, 0, 0 };
+
+    if (GLEW_NVX_gpu_memory_info)
+        glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, kb);
+    else if (GLEW_ATI_meminfo)
+        glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, kb);
+
+    memory->available = (size_t) kb[0] * 1024;
+}
+
+/**
+ * Bytes a texture takes with every level it has, measured from what
+ * the driver reports. Binds the texture on the active unit.
+ *
+ * @param GLenum target
+ * @param GLuint texture
+ * @return size_t
+ */
+size_t gpu_memory_texture_size(GLenum target, GLuint texture)
+{
+    static const GLenum sizes[] = {
+        GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE,
+        GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE
+    };
+
+    size_t total = 0;
+    glBindTexture(target, texture);
+
+    for (GLint level = 0; level < GPU_MEMORY_MAX_LEVELS; level++)
+    {
+        GLint width = 0, height = 0, depth = 0, compressed = 0;
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_DEPTH, &depth);
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED, &compressed);
+
+        if (width == 0 || height == 0)
+            break;
+
+        if (compressed)
+        {
+            GLint size = 0;
+            glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            total += size;
+            continue;
+        }
+
+        size_t bits = 0;
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        {
+            GLint size = 0;
+            glGetTexLevelParameteriv(target, level, sizes[i], &size);
+            bits += size;
+        }
+
+        total += (size_t) width * height * (depth > 0 ? depth : 1) * ((bits + 7) / 8);
+    }
+
+    return total;
+}
+
+/**
+ * Bytes of a buffer object's storage. Binds it to GL_COPY_READ_BUFFER,
+ * which nothing else relies on.
+ *
+ * @param GLuint buffer
+ * @return size_t
+ */
+size_t gpu_memory_buffer_size(GLuint buffer)
+{
+    GLint size = 0;
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    return size;
+}
+
+/**
+ * Rough size of a linked program, the length of its binary when the
+ * driver can give one out, 0 otherwise.
+ *
+ * @param GLuint program
+ * @return size_t
+ */
+size_t gpu_memory_program_size(GLuint program)
+{
+    if (!GLEW_ARB_get_program_binary)
+        return 0;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+    return length;
+}
+
+/**
+ * Print usage per kind, the peak & the budget.
+ *
+ * @param gpu_memory_T* memory
+ * @param FILE* out
+ */
+void gpu_memory_print_stats(gpu_memory_T* memory, FILE* out)
+{
+    static const double mb = 1024.0 * 1024.0;
+
+    fprintf(out, "GPU memory: %.1f MB textures, %.1f MB buffers, %.1f MB programs, %.1f MB peak",
+            memory->used[GPU_MEMORY_TEXTURE] / mb, memory->used[GPU_MEMORY_BUFFER] / mb,
+            memory->used[GPU_MEMORY_PROGRAM] / mb, memory->peak / mb);
+
+    if (memory->budget)
+        fprintf(out, ", %.1f MB budget", memory->budget / mb);
+
+    if (memory->available)
+        fprintf(out, ", %.1f MB free on the device", memory->available / mb);
+
+    fprintf(out, "\n");
+}
+
+/**
+ * @param gpu_memory_T* memory
+ */
+void gpu_memory_free(gpu_memory_T* memory)
+{
+    free(memory);
+}
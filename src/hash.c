@@ -0,0 +1,72 @@
+#include "include/hash.h"
+#include <stdio.h>
+#include <string.h>
+
+
+/**
+ * FNV-1a, 64 bit.
+ * Fast enough for keys & file contents, not meant to be cryptographic.
+ *
+ * @param const void* data
+ * @param size_t size
+ * @param uint64_t seed, HASH_FNV1A64_SEED or the result of a previous call.
+ * @return uint64_t
+ */
+uint64_t hash_fnv1a64(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+    uint64_t hash = seed;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * Hash a null terminated string.
+ *
+ * @param const char* str
+ * @return uint64_t
+ */
+uint64_t hash_string(const char* str)
+{
+    return hash_fnv1a64(str, strlen(str), HASH_FNV1A64_SEED);
+}
+
+/**
+ * Hash the contents of a file.
+ *
+ * @param const char* path
+ * @param uint64_t* out
+ * @param size_t* size, set to the length of the file, may be NULL.
+ * @return int 0 if the file could not be read.
+ */
+int hash_file(const char* path, uint64_t* out, size_t* size)
+{
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+        return 0;
+
+    unsigned char buffer[16384];
+    uint64_t hash = HASH_FNV1A64_SEED;
+    size_t total = 0;
+    size_t n;
+
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    {
+        hash = hash_fnv1a64(buffer, n, hash);
+        total += n;
+    }
+
+    int ok = !ferror(fp);
+    fclose(fp);
+
+    *out = hash;
+    if (size)
+        *size = total;
+    return ok;
+}
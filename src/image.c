@@ -0,0 +1,336 @@
+#include "include/image.h"
+#include "include/qoi.h"
+#include <png.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef IMAGE_JPEG
+#include <jpeglib.h>
+#include <setjmp.h>
+#endif
+
+
+/**
+ * Heap allocator for image_load, the pixels are freed with free.
+ *
+ * @param size_t size
+ * @param void* data, unused.
+ * @return void*
+ */
+void* image_alloc_heap(size_t size, void* data)
+{
+    return malloc(size);
+}
+
+/**
+ * @param const unsigned char* bytes
+ * @param size_t size
+ * @return int 1 if the bytes start with the PNG signature.
+ */
+static int image_probe_png(const unsigned char* bytes, size_t size)
+{
+    return size >= 8 && png_sig_cmp(bytes, 0, 8) == 0;
+}
+
+/**
+ * Decode a PNG using libpng, which unfilters rows with SSE2 / NEON
+ * when it was built with them.
+ *
+ * @param image_T* image
+ * @param const unsigned char* bytes
+ * @param size_t size
+ * @param image_alloc_fn_T* alloc
+ * @param void* data, passed on to alloc.
+ * @return int 0 on failure, the error has been printed.
+ */
+static int image_decode_png(image_T* image, const unsigned char* bytes, size_t size, image_alloc_fn_T* alloc, void* data)
+{
+    png_image png = {};
+    png.version = PNG_IMAGE_VERSION;
+    image->pixels = NULL;
+
+    if (!png_image_begin_read_from_memory(&png, bytes, size))
+    {
+        fprintf(stderr, "libpng error: %s\n", png.message);
+        return 0;
+    }
+
+    png.format = PNG_FORMAT_RGBA;
+
+    /**
+     * In components, RGBA8 rows always meet the unpack alignment
+     * but the stride is spelled out so libpng never picks another
+     */
+    size_t alignment = IMAGE_ROW_ALIGNMENT / PNG_IMAGE_PIXEL_COMPONENT_SIZE(png.format);
+    size_t stride = PNG_IMAGE_ROW_STRIDE(png);
+    stride = (stride + alignment - 1) / alignment * alignment;
+
+    image->pixels = alloc(PNG_IMAGE_BUFFER_SIZE(png, stride), data);
+    if (image->pixels == NULL)
+    {
+        png_image_free(&png);
+        return 0;
+    }
+
+    if (!png_image_finish_read(&png, NULL, image->pixels, stride, NULL))
+    {
+        fprintf(stderr, "libpng error: %s\n", png.message);
+        return 0;
+    }
+
+    image->width = png.width;
+    image->height = png.height;
+
+    return 1;
+}
+
+#ifdef IMAGE_JPEG
+/**
+ * libjpeg reports errors by calling error_exit, jump back out of it.
+ */
+typedef struct IMAGE_JPEG_ERROR_STRUCT
+{
+    struct jpeg_error_mgr base;
+    jmp_buf jump;
+} image_jpeg_error_T;
+
+/**
+ * @param j_common_ptr info
+ */
+static void image_jpeg_error_exit(j_common_ptr info)
+{
+    image_jpeg_error_T* error = (image_jpeg_error_T*) info->err;
+    char message[JMSG_LENGTH_MAX];
+
+    info->err->format_message(info, message);
+    fprintf(stderr, "libjpeg error: %s\n", message);
+
+    longjmp(error->jump, 1);
+}
+
+/**
+ * @param const unsigned char* bytes
+ * @param size_t size
+ * @return int 1 if the bytes start with a JPEG start of image marker.
+ */
+static int image_probe_jpeg(const unsigned char* bytes, size_t size)
+{
+    return size >= 3 && bytes[0] == 0xff && bytes[1] == 0xd8 && bytes[2] == 0xff;
+}
+
+/**
+ * Decode a JPEG using libjpeg-turbo, straight to RGBA with its SIMD
+ * IDCT & color conversion.
+ *
+ * @param image_T* image
+ * @param const unsigned char* bytes
+ * @param size_t size
+ * @param image_alloc_fn_T* alloc
+ * @param void* data, passed on to alloc.
+ * @return int 0 on failure, the error has been printed.
+ */
+static int image_decode_jpeg(image_T* image, const unsigned char* bytes, size_t size, image_alloc_fn_T* alloc, void* data)
+{
+    struct jpeg_decompress_struct info;
+    image_jpeg_error_T error;
+
+    image->pixels = NULL;
+    info.err = jpeg_std_error(&error.base);
+    error.base.error_exit = image_jpeg_error_exit;
+
+    if (setjmp(error.jump))
+    {
+        jpeg_destroy_decompress(&info);
+        return 0;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_mem_src(&info, bytes, size);
+    jpeg_read_header(&info, TRUE);
+
+    info.out_color_space = JCS_EXT_RGBA;
+    jpeg_start_decompress(&info);
+
+    /**
+     * Four components per pixel, rows meet the unpack alignment
+     */
+    size_t stride = (size_t) info.output_width * 4;
+    unsigned char* pixels = alloc(stride * info.output_height, data);
+    if (pixels == NULL)
+    {
+        jpeg_destroy_decompress(&info);
+        return 0;
+    }
+
+    image->pixels = (uint32_t*) pixels;
+
+    while (info.output_scanline < info.output_height)
+    {
+        JSAMPROW row = pixels + info.output_scanline * stride;
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+
+    image->width = info.output_width;
+    image->height = info.output_height;
+
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+
+    return 1;
+}
+#endif
+
+/**
+ * Every backend, probed in this order.
+ */
+static const image_decoder_T decoders[] =
+{
+    { "qoi", qoi_probe, qoi_decode },
+#ifdef IMAGE_JPEG
+    { "jpeg", image_probe_jpeg, image_decode_jpeg },
+#endif
+    { "png", image_probe_png, image_decode_png },
+};
+
+/**
+ * @param size_t* count
+ * @return const image_decoder_T* every backend that was built in.
+ */
+const image_decoder_T* image_decoders(size_t* count)
+{
+    *count = sizeof(decoders) / sizeof(decoders[0]);
+    return decoders;
+}
+
+/**
+ * Pick the backend for a file by its first bytes.
+ *
+ * @param const unsigned char* bytes
+ * @param size_t size
+ * @return const image_decoder_T* or NULL for an unknown format.
+ */
+const image_decoder_T* image_find_decoder(const unsigned char* bytes, size_t size)
+{
+    for (size_t i = 0; i < sizeof(decoders) / sizeof(decoders[0]); i++)
+    {
+        if (decoders[i].probe(bytes, size))
+            return &decoders[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * Map a whole file into memory, read only.
+ *
+ * @param const char* path
+ * @param size_t* size
+ * @return unsigned char* or NULL, the error has been printed.
+ */
+unsigned char* image_map(const char* path, size_t* size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Could not read file `%s`\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        fprintf(stderr, "Could not read file `%s`\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void* bytes = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (bytes == MAP_FAILED)
+    {
+        fprintf(stderr, "Could not map file `%s`\n", path);
+        return NULL;
+    }
+
+    *size = st.st_size;
+    return bytes;
+}
+
+/**
+ * @param unsigned char* bytes, from image_map.
+ * @param size_t size
+ */
+void image_unmap(unsigned char* bytes, size_t size)
+{
+    munmap(bytes, size);
+}
+
+/**
+ * Decode a .png, .qoi or, when built with jpeg=1, .jpg file into
+ * RGBA pixels. Safe to call from any thread.
+ *
+ * @param image_T* image
+ * @param const char* path
+ * @return int 0 on failure, the error has been printed.
+ */
+int image_load(image_T* image, const char* path)
+{
+    if (image_load_into(image, path, image_alloc_heap, NULL))
+        return 1;
+
+    image_release(image);
+    return 0;
+}
+
+/**
+ * Decode an image file straight into memory from `alloc`, which may be
+ * a mapped upload buffer, so the pixels never have to be copied.
+ * The format is told apart by its first bytes, not the file name.
+ * The memory is not freed on failure & belongs to whoever handed it
+ * out, `image->pixels` is left pointing at it.
+ * Safe to call from any thread.
+ *
+ * @param image_T* image
+ * @param const char* path
+ * @param image_alloc_fn_T* alloc
+ * @param void* data, passed on to alloc.
+ * @return int 0 on failure, the error has been printed.
+ */
+int image_load_into(image_T* image, const char* path, image_alloc_fn_T* alloc, void* data)
+{
+    image->pixels = NULL;
+
+    size_t size = 0;
+    unsigned char* bytes = image_map(path, &size);
+    if (bytes == NULL)
+        return 0;
+
+    const image_decoder_T* decoder = image_find_decoder(bytes, size);
+    int ok = decoder && decoder->decode(image, bytes, size, alloc, data);
+
+    if (decoder == NULL)
+        fprintf(stderr, "Unknown image format `%s`\n", path);
+    else if (!ok)
+        fprintf(stderr, "Could not decode `%s` as %s\n", path, decoder->name);
+
+    image_unmap(bytes, size);
+    return ok;
+}
+
+/**
+ * Free the pixels of an image.
+ *
+ * @param image_T* image
+ */
+void image_release(image_T* image)
+{
+    free(image->pixels);
+    image->pixels = NULL;
+    image->width = 0;
+    image->height = 0;
+}
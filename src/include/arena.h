@@ -0,0 +1,36 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <stddef.h>
+
+/**
+ * Default size of an arena's first block.
+ */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct ARENA_BLOCK_STRUCT
+{
+    struct ARENA_BLOCK_STRUCT* next;
+    size_t size;
+    size_t used;
+    char data[];
+} arena_block_T;
+
+/**
+ * Linear allocator, memory is only ever given back all at once.
+ * When a frame needs more than one block, the next reset replaces
+ * them with a single block big enough for all of it.
+ */
+typedef struct ARENA_STRUCT
+{
+    arena_block_T* blocks;
+    size_t total;
+} arena_T;
+
+arena_T* init_arena(size_t size);
+
+void* arena_alloc(arena_T* arena, size_t size, size_t alignment);
+
+void arena_reset(arena_T* arena);
+
+void arena_free(arena_T* arena);
+#endif
@@ -0,0 +1,63 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+#include "image.h"
+#include <GL/glew.h>
+#include <cglm/cglm.h>
+#include <stddef.h>
+
+/**
+ * One horizontal segment of the skyline, the packed area below
+ * `y` is taken.
+ */
+typedef struct ATLAS_SKYLINE_NODE_STRUCT
+{
+    unsigned int x;
+    unsigned int y;
+    unsigned int width;
+} atlas_skyline_node_T;
+
+/**
+ * Skyline of a single array layer.
+ */
+typedef struct ATLAS_LAYER_STRUCT
+{
+    atlas_skyline_node_T* nodes;
+    size_t node_count;
+} atlas_layer_T;
+
+/**
+ * Where a sprite ended up, `uv_rect` is offset (xy) and scale (zw)
+ * for texture coordinates in [0, 1].
+ */
+typedef struct ATLAS_SPRITE_STRUCT
+{
+    vec4 uv_rect;
+    unsigned int layer;
+} atlas_sprite_T;
+
+/**
+ * Packs many images into the layers of one GL_TEXTURE_2D_ARRAY,
+ * so sprites using different images can share a draw call.
+ */
+typedef struct ATLAS_STRUCT
+{
+    GLuint texture;
+    unsigned int size;
+    unsigned int padding;
+    unsigned int alignment;
+    unsigned int mip_levels;
+    atlas_layer_T* layers;
+    size_t layer_count;
+    int dirty;
+} atlas_T;
+
+atlas_T* init_atlas(unsigned int size, size_t layer_count, unsigned int padding, unsigned int mip_levels);
+
+int atlas_add(atlas_T* atlas, const image_T* image, atlas_sprite_T* sprite);
+
+int atlas_add_png(atlas_T* atlas, const char* path, atlas_sprite_T* sprite);
+
+void atlas_commit(atlas_T* atlas);
+
+void atlas_free(atlas_T* atlas);
+#endif
@@ -0,0 +1,77 @@
+#ifndef BAKED_TEXTURE_H
+#define BAKED_TEXTURE_H
+#include "mipmap.h"
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BAKED_TEXTURE_MAGIC "TGLBAKE"
+#define BAKED_TEXTURE_VERSION 1
+#define BAKED_TEXTURE_EXTENSION ".tgb"
+#define BAKED_TEXTURE_MAX_LEVELS MIPMAP_MAX_LEVELS
+
+/**
+ * Level data is aligned to this many bytes inside the file.
+ */
+#define BAKED_TEXTURE_ALIGNMENT 16
+
+#define BAKED_TEXTURE_FLAG_COMPRESSED 1
+
+/**
+ * Pick BC1 or BC3 per image when baking.
+ */
+#define BAKED_TEXTURE_FORMAT_AUTO GL_COMPRESSED_RGBA
+
+/**
+ * On-disk header, followed by `level_count` level entries.
+ * Everything is little endian and read straight from the mapping.
+ */
+typedef struct BAKED_TEXTURE_HEADER_STRUCT
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t internal_format;
+    uint32_t format;
+    uint32_t type;
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+} baked_texture_header_T;
+
+typedef struct BAKED_TEXTURE_LEVEL_STRUCT
+{
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+} baked_texture_level_T;
+
+/**
+ * A baked texture file mapped into memory.
+ */
+typedef struct BAKED_TEXTURE_STRUCT
+{
+    void* mapping;
+    size_t mapping_size;
+    const baked_texture_header_T* header;
+    const baked_texture_level_T* levels;
+} baked_texture_T;
+
+char* baked_texture_path(const char* path);
+
+int baked_texture_stale(const char* baked_path, const char* src);
+
+baked_texture_T* baked_texture_open(const char* path);
+
+const void* baked_texture_level_data(baked_texture_T* baked, size_t level);
+
+void baked_texture_upload(baked_texture_T* baked, unsigned int texture, size_t lod);
+
+void baked_texture_close(baked_texture_T* baked);
+
+int baked_texture_write(const char* path, const baked_texture_header_T* header,
+                        baked_texture_level_T* levels, const void* const* data);
+
+int baked_texture_bake(const char* src, const char* dst, GLenum format, mipmap_filter_T filter);
+#endif
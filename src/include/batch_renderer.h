@@ -0,0 +1,67 @@
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+#include "render_state.h"
+#include "stream_buffer.h"
+#include <GL/glew.h>
+#include <cglm/cglm.h>
+#include <stddef.h>
+
+/**
+ * Instances of a frame start at a multiple of this many bytes into
+ * the stream buffer, enough to bind them as a storage buffer too.
+ */
+#define BATCH_RENDERER_ALIGNMENT 256
+
+/**
+ * Per instance data, read by the vertex shader with a divisor of 1.
+ * `uv_rect` is the offset (xy) and scale (zw) applied to the
+ * texture coordinates, `layer` the texture array layer to sample.
+ */
+typedef struct BATCH_INSTANCE_STRUCT
+{
+    mat4 model;
+    vec4 uv_rect;
+    float layer;
+} batch_instance_T;
+
+/**
+ * Collects instances and draws them with as few instanced calls
+ * as possible, usually one.
+ */
+typedef struct BATCH_RENDERER_STRUCT
+{
+    GLuint vao;
+    render_state_T* state;
+    GLint model_location;
+    GLint uv_rect_location;
+    GLint layer_location;
+    stream_buffer_T* stream;
+    size_t instance_offset;
+    batch_instance_T* instances;
+    size_t instance_count;
+    size_t capacity;
+    size_t draw_calls;
+} batch_renderer_T;
+
+batch_renderer_T* init_batch_renderer(GLuint vao, GLint model_location, GLint uv_rect_location,
+                                      GLint layer_location, size_t capacity, render_state_T* state);
+
+void batch_renderer_attach(batch_renderer_T* batch, GLuint vao);
+
+void batch_renderer_begin(batch_renderer_T* batch);
+
+batch_instance_T* batch_renderer_push(batch_renderer_T* batch, mat4 model, vec4 uv_rect);
+
+void batch_renderer_draw(batch_renderer_T* batch, GLuint vao, size_t first, size_t count, GLsizei vertex_count);
+
+void batch_renderer_commit(batch_renderer_T* batch);
+
+void batch_renderer_draw_indirect(batch_renderer_T* batch, GLuint vao, GLuint buffer,
+                                  size_t first, size_t command_count);
+
+void batch_renderer_end(batch_renderer_T* batch);
+
+void batch_renderer_flush(batch_renderer_T* batch, GLsizei vertex_count);
+
+void batch_renderer_free(batch_renderer_T* batch);
+#endif
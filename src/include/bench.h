@@ -0,0 +1,48 @@
+#ifndef BENCH_H
+#define BENCH_H
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Percent a result may get worse than its baseline before it
+ * counts as a regression.
+ */
+#define BENCH_THRESHOLD 10.0
+
+#define BENCH_MAX_NAME 128
+#define BENCH_MAX_UNIT 16
+
+/**
+ * One measurement of a scenario. Results in a rate, like MB/s, are
+ * better when higher, everything else, like ms, when lower.
+ */
+typedef struct BENCH_RESULT_STRUCT
+{
+    char name[BENCH_MAX_NAME];
+    char unit[BENCH_MAX_UNIT];
+    double value;
+} bench_result_T;
+
+/**
+ * The rows of a results file, `name,value,unit` per line.
+ * A scenario recorded again replaces its earlier value.
+ */
+typedef struct BENCH_RESULTS_STRUCT
+{
+    bench_result_T* results;
+    size_t count;
+    size_t capacity;
+} bench_results_T;
+
+int bench_record(const char* path, const char* name, const char* unit, double value);
+
+bench_results_T* bench_results_read(const char* path);
+
+bench_result_T* bench_results_find(bench_results_T* results, const char* name);
+
+int bench_higher_is_better(const char* unit);
+
+int bench_compare(bench_results_T* baseline, bench_results_T* results, double threshold, FILE* out);
+
+void bench_results_free(bench_results_T* results);
+#endif
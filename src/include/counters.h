@@ -0,0 +1,86 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define COUNTERS_MAX 32
+#define COUNTERS_MAX_NAME 32
+
+/**
+ * Frame times are counted in buckets of COUNTERS_HISTOGRAM_STEP
+ * nanoseconds, the last bucket holds every slower frame.
+ */
+#define COUNTERS_HISTOGRAM_BUCKETS 34
+#define COUNTERS_HISTOGRAM_STEP 1000000
+
+#define COUNTERS_PAGE_MAGIC "TGLCNTR"
+#define COUNTERS_PAGE_VERSION 2
+
+typedef enum
+{
+    COUNTER_TOTAL,
+    COUNTER_GAUGE
+} counter_kind_T;
+
+/**
+ * Every counter & the frame time histogram. This is also the layout
+ * of the shared memory page, which is rewritten once per frame:
+ * `sequence` is odd while that happens, readers retry until they saw
+ * the same even value before & after copying. `owner` is the pid of
+ * the exporting process.
+ */
+typedef struct COUNTERS_PAGE_STRUCT
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    _Atomic uint64_t sequence;
+    uint64_t owner;
+    char names[COUNTERS_MAX][COUNTERS_MAX_NAME];
+    uint32_t kinds[COUNTERS_MAX];
+    uint64_t values[COUNTERS_MAX];
+    uint64_t histogram[COUNTERS_HISTOGRAM_BUCKETS];
+} counters_page_T;
+
+/**
+ * Named counters, updated by index from the GL thread so setting one
+ * is a single store. counters_publish hands them to whoever watches,
+ * through a shared memory page and / or a unix socket that answers
+ * every connection with a text snapshot.
+ */
+typedef struct COUNTERS_STRUCT
+{
+    counters_page_T page;
+
+    counters_page_T* shared;
+    char* shared_name;
+
+    int socket;
+    char* socket_path;
+} counters_T;
+
+counters_T* init_counters(void);
+
+size_t counters_register(counters_T* counters, const char* name, counter_kind_T kind);
+
+void counters_set(counters_T* counters, size_t counter, uint64_t value);
+
+void counters_add(counters_T* counters, size_t counter, uint64_t value);
+
+void counters_frame_time(counters_T* counters, uint64_t nanoseconds);
+
+double counters_percentile(const counters_page_T* page, double fraction);
+
+size_t counters_format(const counters_page_T* page, int histogram, char* out, size_t size);
+
+int counters_export_shared(counters_T* counters, const char* name);
+
+int counters_listen(counters_T* counters, const char* path);
+
+void counters_publish(counters_T* counters);
+
+int counters_read_shared(const char* name, counters_page_T* page);
+
+void counters_free(counters_T* counters);
+#endif
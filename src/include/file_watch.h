@@ -0,0 +1,43 @@
+#ifndef FILE_WATCH_H
+#define FILE_WATCH_H
+#include <stddef.h>
+
+/**
+ * Called from file_watch_poll when a watched file changed.
+ */
+typedef void file_watch_fn_T(const char* path, void* data);
+
+/**
+ * A watched file. With inotify `handle` is the watch of the directory,
+ * since editors often save by replacing the file, with kqueue it is
+ * the open file itself.
+ */
+typedef struct FILE_WATCH_ENTRY_STRUCT
+{
+    char* path;
+    char* name;
+    int handle;
+    file_watch_fn_T* fn;
+    void* data;
+    int changed;
+} file_watch_entry_T;
+
+/**
+ * Watches files for changes without blocking, using inotify on Linux
+ * and kqueue on the BSDs & macOS.
+ */
+typedef struct FILE_WATCH_STRUCT
+{
+    int fd;
+    file_watch_entry_T* entries;
+    size_t entry_count;
+} file_watch_T;
+
+file_watch_T* init_file_watch(void);
+
+int file_watch_add(file_watch_T* watch, const char* path, file_watch_fn_T* fn, void* data);
+
+size_t file_watch_poll(file_watch_T* watch);
+
+void file_watch_free(file_watch_T* watch);
+#endif
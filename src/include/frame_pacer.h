@@ -0,0 +1,53 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Most frames the CPU may run ahead of the GPU with fence throttling.
+ */
+#define FRAME_PACER_MAX_QUEUED 8
+
+/**
+ * The frame cap sleeps until this close to the deadline, then spins,
+ * since sleeps routinely oversleep by a fraction of a millisecond.
+ */
+#define FRAME_PACER_SPIN_NS 1000000
+
+typedef enum
+{
+    FRAME_PACER_VSYNC,
+    FRAME_PACER_ADAPTIVE,
+    FRAME_PACER_UNCAPPED,
+    FRAME_PACER_CAPPED
+} frame_pacer_mode_T;
+
+/**
+ * Decides when frames start & how far the CPU may get ahead.
+ * `max_queued` of 0 leaves queueing to the driver.
+ */
+typedef struct FRAME_PACER_STRUCT
+{
+    frame_pacer_mode_T mode;
+    uint64_t period;
+    uint64_t deadline;
+    size_t max_queued;
+    int finish;
+    GLsync fences[FRAME_PACER_MAX_QUEUED];
+    size_t fence_index;
+    size_t missed;
+} frame_pacer_T;
+
+frame_pacer_T* init_frame_pacer(frame_pacer_mode_T mode, double fps, size_t max_queued, int finish);
+
+int frame_pacer_parse_mode(const char* name, frame_pacer_mode_T* mode);
+
+void frame_pacer_apply(frame_pacer_T* pacer);
+
+void frame_pacer_wait(frame_pacer_T* pacer);
+
+void frame_pacer_end_frame(frame_pacer_T* pacer);
+
+void frame_pacer_free(frame_pacer_T* pacer);
+#endif
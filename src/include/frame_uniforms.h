@@ -0,0 +1,47 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+#include "stream_buffer.h"
+#include <GL/glew.h>
+#include <cglm/cglm.h>
+
+/**
+ * Uniform buffer binding point of the `Frame` block.
+ */
+#define FRAME_UNIFORMS_BINDING 0
+
+#define FRAME_UNIFORMS_BLOCK_NAME "Frame"
+
+/**
+ * std140 layout of the block, matches
+ *
+ *   layout(std140) uniform Frame { mat4 VP; vec2 Viewport; vec2 Cursor; float Time; };
+ */
+typedef struct FRAME_UNIFORMS_BLOCK_STRUCT
+{
+    mat4 view_projection;
+    vec2 viewport;
+    vec2 cursor;
+    float time;
+    float padding[3];
+} frame_uniforms_block_T;
+
+/**
+ * Per frame data shared by every program, written once per frame
+ * into a stream buffer instead of per program glUniform calls.
+ */
+typedef struct FRAME_UNIFORMS_STRUCT
+{
+    stream_buffer_T* stream;
+    size_t alignment;
+} frame_uniforms_T;
+
+frame_uniforms_T* init_frame_uniforms(void);
+
+int frame_uniforms_bind_program(GLuint program);
+
+void frame_uniforms_begin(frame_uniforms_T* uniforms, const frame_uniforms_block_T* block);
+
+void frame_uniforms_end(frame_uniforms_T* uniforms);
+
+void frame_uniforms_free(frame_uniforms_T* uniforms);
+#endif
@@ -0,0 +1,20 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+#include <GL/glew.h>
+
+/**
+ * Offscreen render target with a single color attachment,
+ * lets us draw at any resolution without a visible window.
+ */
+typedef struct FRAMEBUFFER_STRUCT
+{
+    GLuint fbo;
+    GLuint color;
+    int width;
+    int height;
+} framebuffer_T;
+
+framebuffer_T* init_framebuffer(int width, int height);
+
+void framebuffer_free(framebuffer_T* framebuffer);
+#endif
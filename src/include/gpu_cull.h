@@ -0,0 +1,61 @@
+#ifndef GPU_CULL_H
+#define GPU_CULL_H
+#include "batch_renderer.h"
+#include "render_state.h"
+#include <GL/glew.h>
+#include <stddef.h>
+
+/**
+ * Invocations per compute work group, one instance each.
+ */
+#define GPU_CULL_GROUP_SIZE 64
+
+/**
+ * Layout of a glMultiDrawArraysIndirect command.
+ */
+typedef struct GPU_CULL_COMMAND_STRUCT
+{
+    GLuint count;
+    GLuint instance_count;
+    GLuint first;
+    GLuint base_instance;
+} gpu_cull_command_T;
+
+/**
+ * Frustum culls batch instances on the GPU.
+ * A compute shader tests the bounding sphere of every instance against
+ * the Frame block's view projection and copies the visible ones into
+ * `visible`, counting them into the indirect command of their run, so
+ * the CPU never learns how many survived.
+ * `commands` are the runs of this frame, one per indirect command,
+ * with `base_instance` the first instance of the run.
+ */
+typedef struct GPU_CULL_STRUCT
+{
+    GLuint program;
+    GLint instance_count_location;
+    GLint command_count_location;
+    GLint stride_location;
+    GLint radius_location;
+
+    GLuint visible;
+    GLuint indirect;
+    size_t capacity;
+    float radius;
+
+    gpu_cull_command_T* commands;
+    size_t command_count;
+    size_t command_capacity;
+    size_t dispatches;
+} gpu_cull_T;
+
+gpu_cull_T* init_gpu_cull(size_t capacity, float radius);
+
+void gpu_cull_begin(gpu_cull_T* cull);
+
+void gpu_cull_add(gpu_cull_T* cull, size_t first, GLsizei vertex_count);
+
+void gpu_cull_dispatch(gpu_cull_T* cull, render_state_T* state, GLuint instances, size_t offset, size_t count);
+
+void gpu_cull_free(gpu_cull_T* cull);
+#endif
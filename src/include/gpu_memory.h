@@ -0,0 +1,63 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Memory the driver should always have left, when it reports less
+ * than this the budget is treated as exceeded.
+ */
+#define GPU_MEMORY_RESERVE (64 * 1024 * 1024)
+
+/**
+ * Frames between asking the driver how much memory is left.
+ */
+#define GPU_MEMORY_QUERY_INTERVAL 60
+
+typedef enum
+{
+    GPU_MEMORY_TEXTURE,
+    GPU_MEMORY_BUFFER,
+    GPU_MEMORY_PROGRAM,
+    GPU_MEMORY_KIND_COUNT
+} gpu_memory_kind_T;
+
+/**
+ * Bytes allocated on the GPU per kind of resource, as far as we know.
+ * `available` is what the driver reports through GL_NVX_gpu_memory_info
+ * or GL_ATI_meminfo, 0 when neither is supported.
+ */
+typedef struct GPU_MEMORY_STRUCT
+{
+    size_t used[GPU_MEMORY_KIND_COUNT];
+    size_t peak;
+    size_t budget;
+    size_t available;
+    size_t frame;
+} gpu_memory_T;
+
+gpu_memory_T* init_gpu_memory(size_t budget);
+
+void gpu_memory_add(gpu_memory_T* memory, gpu_memory_kind_T kind, size_t bytes);
+
+void gpu_memory_remove(gpu_memory_T* memory, gpu_memory_kind_T kind, size_t bytes);
+
+size_t gpu_memory_used(gpu_memory_T* memory);
+
+size_t gpu_memory_over_budget(gpu_memory_T* memory);
+
+size_t gpu_memory_headroom(gpu_memory_T* memory);
+
+void gpu_memory_update(gpu_memory_T* memory);
+
+size_t gpu_memory_texture_size(GLenum target, GLuint texture);
+
+size_t gpu_memory_buffer_size(GLuint buffer);
+
+size_t gpu_memory_program_size(GLuint program);
+
+void gpu_memory_print_stats(gpu_memory_T* memory, FILE* out);
+
+void gpu_memory_free(gpu_memory_T* memory);
+#endif
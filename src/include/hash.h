@@ -0,0 +1,13 @@
+#ifndef HASH_H
+#define HASH_H
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_FNV1A64_SEED 0xcbf29ce484222325ULL
+
+uint64_t hash_fnv1a64(const void* data, size_t size, uint64_t seed);
+
+uint64_t hash_string(const char* str);
+
+int hash_file(const char* path, uint64_t* out, size_t* size);
+#endif
@@ -0,0 +1,54 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Rows of decoded images are padded to this, the default
+ * GL_UNPACK_ALIGNMENT, so they can be uploaded as they are.
+ */
+#define IMAGE_ROW_ALIGNMENT 4
+
+/**
+ * Decoded RGBA8 pixels, rows tightly packed.
+ */
+typedef struct IMAGE_STRUCT
+{
+    unsigned int width;
+    unsigned int height;
+    uint32_t* pixels;
+} image_T;
+
+/**
+ * Hands out the memory an image is decoded into, NULL on failure.
+ */
+typedef void* image_alloc_fn_T(size_t size, void* data);
+
+/**
+ * A file format backend. `probe` looks at the first bytes of a file,
+ * `decode` turns the whole file into RGBA8 pixels from `alloc` and
+ * must be safe to call from any thread.
+ */
+typedef struct IMAGE_DECODER_STRUCT
+{
+    const char* name;
+    int (*probe)(const unsigned char* bytes, size_t size);
+    int (*decode)(image_T* image, const unsigned char* bytes, size_t size, image_alloc_fn_T* alloc, void* data);
+} image_decoder_T;
+
+void* image_alloc_heap(size_t size, void* data);
+
+const image_decoder_T* image_decoders(size_t* count);
+
+const image_decoder_T* image_find_decoder(const unsigned char* bytes, size_t size);
+
+unsigned char* image_map(const char* path, size_t* size);
+
+void image_unmap(unsigned char* bytes, size_t size);
+
+int image_load(image_T* image, const char* path);
+
+int image_load_into(image_T* image, const char* path, image_alloc_fn_T* alloc, void* data);
+
+void image_release(image_T* image);
+#endif
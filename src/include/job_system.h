@@ -0,0 +1,92 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+#include "arena.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Jobs each deque can hold, a power of two.
+ * Submitting to a full deque runs the job right away instead.
+ */
+#define JOB_DEQUE_SIZE 4096
+
+struct JOB_SYSTEM_STRUCT;
+
+/**
+ * @param struct JOB_SYSTEM_STRUCT* system
+ * @param size_t worker, index of the thread running the job.
+ * @param void* data
+ */
+typedef void (*job_fn_T)(struct JOB_SYSTEM_STRUCT* system, size_t worker, void* data);
+
+/**
+ * Counts unfinished jobs, zero it before submitting and wait on it.
+ */
+typedef atomic_size_t job_counter_T;
+
+typedef struct JOB_STRUCT
+{
+    job_fn_T fn;
+    void* data;
+    job_counter_T* counter;
+} job_T;
+
+/**
+ * Chase-Lev work stealing deque.
+ * The owner pushes & pops at the bottom, everyone else steals
+ * from the top, without locks.
+ */
+typedef struct JOB_DEQUE_STRUCT
+{
+    _Alignas(64) atomic_int_fast64_t top;
+    _Alignas(64) atomic_int_fast64_t bottom;
+    job_T jobs[JOB_DEQUE_SIZE];
+} job_deque_T;
+
+/**
+ * Per thread state, worker `worker_count` is the thread that
+ * created the system, normally the GL thread.
+ */
+typedef struct JOB_WORKER_STRUCT
+{
+    struct JOB_SYSTEM_STRUCT* system;
+    size_t index;
+    pthread_t thread;
+    job_deque_T deque;
+    arena_T* arena;
+    uint32_t random;
+} job_worker_T;
+
+/**
+ * Worker threads running small jobs for the current frame, idle
+ * workers steal from busy ones and sleep when there is nothing left.
+ */
+typedef struct JOB_SYSTEM_STRUCT
+{
+    job_worker_T* workers;
+    size_t worker_count;
+    size_t slot_count;
+    atomic_size_t queued;
+    atomic_int sleeping;
+    atomic_int running;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    atomic_size_t steals;
+} job_system_T;
+
+job_system_T* init_job_system(size_t worker_count);
+
+size_t job_system_main_worker(job_system_T* system);
+
+arena_T* job_system_arena(job_system_T* system, size_t worker);
+
+void job_system_submit(job_system_T* system, size_t worker, job_fn_T fn, void* data, job_counter_T* counter);
+
+void job_system_wait(job_system_T* system, size_t worker, job_counter_T* counter);
+
+void job_system_reset_arenas(job_system_T* system);
+
+void job_system_free(job_system_T* system);
+#endif
@@ -0,0 +1,21 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+#include "image.h"
+#include <stddef.h>
+
+/**
+ * Enough levels for a 32768x32768 image.
+ */
+#define MIPMAP_MAX_LEVELS 16
+
+typedef enum
+{
+    MIPMAP_FILTER_NONE,
+    MIPMAP_FILTER_BOX,
+    MIPMAP_FILTER_KAISER
+} mipmap_filter_T;
+
+size_t mipmap_generate(image_T* levels, size_t max_levels, mipmap_filter_T filter);
+
+void mipmap_release(image_T* levels, size_t count);
+#endif
@@ -0,0 +1,49 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+#include "render_state.h"
+#include "shader_manager.h"
+#include "stream_buffer.h"
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Characters drawn per frame at most, the rest is cut off.
+ */
+#define OVERLAY_MAX_GLYPHS 4096
+
+/**
+ * Glyphs are 3x5 font pixels in 4x6 cells, drawn this many screen
+ * pixels per font pixel, OVERLAY_MARGIN pixels from the top left.
+ */
+#define OVERLAY_FONT_WIDTH 4
+#define OVERLAY_FONT_HEIGHT 6
+#define OVERLAY_SCALE 2
+#define OVERLAY_MARGIN 8
+
+typedef struct OVERLAY_VERTEX_STRUCT
+{
+    float position[2];
+    float texcoord[2];
+    uint8_t color[4];
+} overlay_vertex_T;
+
+/**
+ * Draws text on top of the frame, every character of a frame in
+ * one call. The font is built into a small texture at start up.
+ */
+typedef struct OVERLAY_STRUCT
+{
+    shader_program_T* shader;
+    size_t generation;
+    GLuint texture;
+    GLuint vao;
+    stream_buffer_T* stream;
+} overlay_T;
+
+overlay_T* init_overlay(shader_manager_T* manager, render_state_T* state);
+
+size_t overlay_draw(overlay_T* overlay, render_state_T* state, const char* text, int width, int height);
+
+void overlay_free(overlay_T* overlay);
+#endif
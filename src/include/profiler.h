@@ -0,0 +1,123 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define PROFILER_MAX_SCOPES 16
+
+/**
+ * GPU results are read back this many frames late so we never
+ * wait for a query.
+ */
+#define PROFILER_LATENCY 3
+
+/**
+ * Amount of frames kept for percentiles.
+ */
+#define PROFILER_HISTORY 1024
+
+/**
+ * Default size of the trace ring, the oldest events are overwritten
+ * so a long session still holds the last few seconds.
+ */
+#define PROFILER_MAX_EVENTS 65536
+
+/**
+ * Region name of the input latency stats, the time from sampling
+ * input until the frame was submitted (cpu) or finished on the GPU (gpu).
+ */
+#define PROFILER_LATENCY_NAME "latency"
+
+/**
+ * One timed region of one frame.
+ */
+typedef struct PROFILER_SAMPLE_STRUCT
+{
+    const char* name;
+    GLuint queries[2];
+    uint64_t cpu_begin;
+    uint64_t cpu_end;
+} profiler_sample_T;
+
+/**
+ * Everything recorded for a frame that is still waiting on the GPU.
+ */
+typedef struct PROFILER_FRAME_STRUCT
+{
+    profiler_sample_T samples[PROFILER_MAX_SCOPES];
+    size_t sample_count;
+    int pending;
+    uint64_t input;
+} profiler_frame_T;
+
+/**
+ * Rolling timings of a named region, in nanoseconds.
+ */
+typedef struct PROFILER_STATS_STRUCT
+{
+    const char* name;
+    uint64_t cpu[PROFILER_HISTORY];
+    uint64_t gpu[PROFILER_HISTORY];
+    size_t cpu_count;
+    size_t gpu_count;
+} profiler_stats_T;
+
+/**
+ * A finished region for the trace, timestamps relative to the
+ * profiler's creation.
+ */
+typedef struct PROFILER_EVENT_STRUCT
+{
+    const char* name;
+    uint64_t begin;
+    uint64_t duration;
+    int gpu;
+} profiler_event_T;
+
+/**
+ * CPU and GPU frame profiler with a Chrome trace export.
+ */
+typedef struct PROFILER_STRUCT
+{
+    int gpu;
+    uint64_t cpu_epoch;
+    int64_t gpu_epoch;
+
+    profiler_frame_T frames[PROFILER_LATENCY];
+    size_t frame;
+
+    uint64_t frame_begin;
+    size_t frame_scope;
+    uint64_t frame_times[PROFILER_HISTORY];
+    size_t frame_count;
+
+    profiler_stats_T stats[PROFILER_MAX_SCOPES];
+    size_t stats_count;
+
+    profiler_event_T* events;
+    size_t max_events;
+    size_t event_count;
+} profiler_T;
+
+profiler_T* init_profiler(size_t max_events);
+
+uint64_t profiler_now(void);
+
+void profiler_begin_frame(profiler_T* profiler);
+
+size_t profiler_begin(profiler_T* profiler, const char* name);
+
+void profiler_end(profiler_T* profiler, size_t scope);
+
+void profiler_mark_input(profiler_T* profiler);
+
+void profiler_end_frame(profiler_T* profiler);
+
+void profiler_print_stats(profiler_T* profiler, FILE* out);
+
+int profiler_write_trace(profiler_T* profiler, const char* path);
+
+void profiler_free(profiler_T* profiler);
+#endif
@@ -0,0 +1,23 @@
+#ifndef QOI_H
+#define QOI_H
+#include "image.h"
+#include <stddef.h>
+
+#define QOI_MAGIC "qoif"
+#define QOI_EXTENSION ".qoi"
+#define QOI_HEADER_SIZE 14
+#define QOI_PADDING_SIZE 8
+
+/**
+ * Larger images are refused, the same limit as the reference decoder.
+ */
+#define QOI_PIXELS_MAX 400000000u
+
+int qoi_probe(const unsigned char* bytes, size_t size);
+
+int qoi_decode(image_T* image, const unsigned char* bytes, size_t size, image_alloc_fn_T* alloc, void* data);
+
+unsigned char* qoi_encode(const image_T* image, size_t* size);
+
+int qoi_write(const image_T* image, const char* path);
+#endif
@@ -0,0 +1,93 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+#include "batch_renderer.h"
+#include "gpu_cull.h"
+#include "render_state.h"
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Sort key layout, most significant first.
+ * Draws are ordered by layer, then by the state that is most
+ * expensive to change.
+ */
+#define RENDER_QUEUE_LAYER_BITS 8
+#define RENDER_QUEUE_PROGRAM_BITS 12
+#define RENDER_QUEUE_TEXTURE_BITS 16
+#define RENDER_QUEUE_VAO_BITS 12
+#define RENDER_QUEUE_DEPTH_BITS 16
+
+/**
+ * Everything a draw needs bound, a `sampler` of 0 samples the texture
+ * with its own parameters.
+ * Draws with equal state are merged into one instanced call.
+ */
+typedef struct RENDER_DRAW_STRUCT
+{
+    GLuint program;
+    GLuint vao;
+    GLenum texture_target;
+    GLuint texture;
+    GLsizei vertex_count;
+    GLuint sampler;
+} render_draw_T;
+
+typedef struct RENDER_COMMAND_STRUCT
+{
+    render_draw_T draw;
+    batch_instance_T instance;
+} render_command_T;
+
+/**
+ * Draws recorded off the GL thread, for example by a job into its
+ * worker's arena, and handed to the queue in one go.
+ */
+typedef struct RENDER_PACKET_STRUCT
+{
+    render_command_T* commands;
+    uint64_t* keys;
+    size_t count;
+    struct RENDER_PACKET_STRUCT* next;
+} render_packet_T;
+
+typedef struct RENDER_SORT_ITEM_STRUCT
+{
+    uint64_t key;
+    uint32_t index;
+} render_sort_item_T;
+
+/**
+ * Collects a frame's draws, sorts them by key and submits them
+ * through the batch renderer & the state tracker, or culls and draws
+ * them indirectly on the GPU when `cull` is set.
+ */
+typedef struct RENDER_QUEUE_STRUCT
+{
+    batch_renderer_T* batch;
+    render_state_T* state;
+    render_command_T* commands;
+    render_sort_item_T* items;
+    render_sort_item_T* scratch;
+    size_t count;
+    size_t capacity;
+    size_t sort_passes;
+    gpu_cull_T* cull;
+} render_queue_T;
+
+render_queue_T* init_render_queue(batch_renderer_T* batch, render_state_T* state);
+
+uint64_t render_queue_key(unsigned int layer, GLuint program, GLuint texture, GLuint vao, float depth);
+
+batch_instance_T* render_queue_push(render_queue_T* queue, uint64_t key, const render_draw_T* draw);
+
+void render_queue_append(render_queue_T* queue, const render_packet_T* packet);
+
+void render_queue_sort(render_queue_T* queue);
+
+void render_queue_flush(render_queue_T* queue);
+
+void render_queue_set_cull(render_queue_T* queue, gpu_cull_T* cull);
+
+void render_queue_free(render_queue_T* queue);
+#endif
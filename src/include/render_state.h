@@ -0,0 +1,63 @@
+#ifndef RENDER_STATE_H
+#define RENDER_STATE_H
+#include <GL/glew.h>
+#include <stddef.h>
+
+#define RENDER_STATE_TEXTURE_UNITS 16
+
+/**
+ * Shadow value for state we do not know, the next call always
+ * reaches the driver.
+ */
+#define RENDER_STATE_UNKNOWN ((GLuint) -1)
+
+/**
+ * Shadows the bits of GL state the draw path touches and drops calls
+ * that would not change anything.
+ * Code binding objects behind its back must call one of the
+ * invalidate functions afterwards.
+ */
+typedef struct RENDER_STATE_STRUCT
+{
+    GLuint program;
+    GLuint vertex_array;
+    GLuint framebuffer;
+    GLuint active_texture;
+    GLuint textures[RENDER_STATE_TEXTURE_UNITS];
+    GLenum texture_targets[RENDER_STATE_TEXTURE_UNITS];
+    GLuint samplers[RENDER_STATE_TEXTURE_UNITS];
+    GLint viewport[4];
+    GLuint blend;
+    GLenum blend_src;
+    GLenum blend_dst;
+
+    size_t calls;
+    size_t skipped;
+} render_state_T;
+
+render_state_T* init_render_state(void);
+
+void render_state_use_program(render_state_T* state, GLuint program);
+
+void render_state_bind_vertex_array(render_state_T* state, GLuint vertex_array);
+
+void render_state_bind_framebuffer(render_state_T* state, GLuint framebuffer);
+
+void render_state_bind_texture(render_state_T* state, GLuint unit, GLenum target, GLuint texture);
+
+void render_state_bind_sampler(render_state_T* state, GLuint unit, GLuint sampler);
+
+void render_state_viewport(render_state_T* state, GLint x, GLint y, GLint width, GLint height);
+
+void render_state_blend(render_state_T* state, int enabled, GLenum src, GLenum dst);
+
+void render_state_invalidate_textures(render_state_T* state);
+
+void render_state_invalidate_framebuffer(render_state_T* state);
+
+void render_state_invalidate(render_state_T* state);
+
+void render_state_reset_counters(render_state_T* state);
+
+void render_state_free(render_state_T* state);
+#endif
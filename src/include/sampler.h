@@ -0,0 +1,45 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+#include <GL/glew.h>
+
+/**
+ * Anisotropy asked for by the anisotropic preset when none is given,
+ * clamped to what the driver supports.
+ */
+#define SAMPLER_ANISOTROPY_DEFAULT 8.0f
+
+typedef enum
+{
+    SAMPLER_NEAREST,
+    SAMPLER_BILINEAR,
+    SAMPLER_TRILINEAR,
+    SAMPLER_ANISOTROPIC,
+    SAMPLER_PRESET_COUNT
+} sampler_preset_T;
+
+/**
+ * One sampler object per filtering preset, all with the same wrap mode.
+ * Bound in place of the texture's own parameters, so switching
+ * `preset` changes how every texture drawn with it is filtered.
+ * `anisotropy` is what the anisotropic preset uses, 1 when the driver
+ * has no anisotropic filtering.
+ */
+typedef struct SAMPLER_STRUCT
+{
+    GLuint samplers[SAMPLER_PRESET_COUNT];
+    sampler_preset_T preset;
+    float anisotropy;
+} sampler_T;
+
+sampler_T* init_sampler(GLenum wrap, sampler_preset_T preset, float anisotropy);
+
+int sampler_parse_preset(const char* name, sampler_preset_T* preset, float* anisotropy);
+
+const char* sampler_preset_name(sampler_preset_T preset);
+
+void sampler_set_preset(sampler_T* sampler, sampler_preset_T preset);
+
+GLuint sampler_current(sampler_T* sampler);
+
+void sampler_free(sampler_T* sampler);
+#endif
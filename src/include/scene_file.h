@@ -0,0 +1,122 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+#include "transform.h"
+#include "vertex_layout.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCENE_FILE_MAGIC "TGLSCNE"
+#define SCENE_FILE_VERSION 1
+#define SCENE_FILE_EXTENSION ".tsc"
+
+/**
+ * Every section starts at a multiple of this many bytes.
+ */
+#define SCENE_FILE_ALIGNMENT 16
+
+/**
+ * Meshes scene_file_generate makes at most. Mesh i has i + 1 triangles,
+ * so this keeps the vertex count at 3 * 4096 * 4097 / 2, well within
+ * the header's uint32_t.
+ */
+#define SCENE_FILE_MAX_MESHES 4096
+
+/**
+ * Instance data is stored as one array per field, in the order of
+ * transform_soa_T, followed by the mesh & texture index of every instance.
+ */
+typedef enum
+{
+    SCENE_FILE_X,
+    SCENE_FILE_Y,
+    SCENE_FILE_Z,
+    SCENE_FILE_ROTATION,
+    SCENE_FILE_SCALE_X,
+    SCENE_FILE_SCALE_Y,
+    SCENE_FILE_MESH,
+    SCENE_FILE_TEXTURE,
+    SCENE_FILE_ARRAY_COUNT
+} scene_file_array_T;
+
+/**
+ * On-disk header, every other section is found through its offset.
+ * Everything is little endian and used straight from the mapping.
+ * A `width` & `height` of 0 keeps the default window size.
+ */
+typedef struct SCENE_FILE_HEADER_STRUCT
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mesh_count;
+    uint32_t texture_count;
+    uint32_t vertex_count;
+    uint32_t instance_count;
+    uint64_t meshes;
+    uint64_t textures;
+    uint64_t vertices;
+    uint64_t strings;
+    uint64_t strings_size;
+    uint64_t arrays[SCENE_FILE_ARRAY_COUNT];
+} scene_file_header_T;
+
+/**
+ * A range of the vertex array drawn as triangles. `radius` encloses
+ * every vertex around the mesh's origin, before instance scaling.
+ */
+typedef struct SCENE_FILE_MESH_STRUCT
+{
+    uint32_t first_vertex;
+    uint32_t vertex_count;
+    float radius;
+    uint32_t reserved;
+} scene_file_mesh_T;
+
+/**
+ * A texture path, `length` bytes at `path` into the strings section
+ * followed by a 0.
+ */
+typedef struct SCENE_FILE_TEXTURE_STRUCT
+{
+    uint32_t path;
+    uint32_t length;
+} scene_file_texture_T;
+
+/**
+ * A scene file mapped into memory, every pointer points into the mapping.
+ */
+typedef struct SCENE_FILE_STRUCT
+{
+    void* mapping;
+    size_t mapping_size;
+    const scene_file_header_T* header;
+    const scene_file_mesh_T* meshes;
+    const scene_file_texture_T* textures;
+    const packed_vertex_T* vertices;
+    const char* strings;
+    const float* transforms[SCENE_FILE_MESH];
+    const uint32_t* instance_meshes;
+    const uint32_t* instance_textures;
+} scene_file_T;
+
+scene_file_T* scene_file_open(const char* path);
+
+const char* scene_file_texture_path(scene_file_T* scene, size_t texture);
+
+float scene_file_radius(scene_file_T* scene);
+
+void scene_file_load_transforms(scene_file_T* scene, transform_soa_T* transforms);
+
+void scene_file_close(scene_file_T* scene);
+
+int scene_file_write(const char* path, scene_file_header_T* header, const scene_file_mesh_T* meshes,
+                     const packed_vertex_T* vertices, const char* const* texture_paths,
+                     const transform_soa_T* transforms, const uint32_t* instance_meshes,
+                     const uint32_t* instance_textures);
+
+int scene_file_generate(const char* path, size_t instance_count, size_t mesh_count,
+                        const char* const* texture_paths, size_t texture_count,
+                        uint32_t width, uint32_t height, uint32_t seed);
+#endif
@@ -0,0 +1,51 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHADER_CACHE_MAGIC "TGLPROG"
+#define SHADER_CACHE_VERSION 1
+
+/**
+ * On-disk header of a cached program, followed by `size` bytes
+ * of whatever glGetProgramBinary returned.
+ */
+typedef struct SHADER_CACHE_HEADER_STRUCT
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t key;
+    uint64_t size;
+} shader_cache_header_T;
+
+/**
+ * Keeps linked program binaries on disk so the next launch can
+ * skip compiling GLSL.
+ * Binaries only work on the driver they came from, so the driver
+ * strings are part of every key.
+ */
+typedef struct SHADER_CACHE_STRUCT
+{
+    char* directory;
+    uint64_t driver_hash;
+    int supported;
+    size_t hits;
+    size_t misses;
+} shader_cache_T;
+
+shader_cache_T* init_shader_cache(const char* directory);
+
+uint64_t shader_cache_key(shader_cache_T* cache,
+                          const char* const* vertex_sources, size_t vertex_count,
+                          const char* const* fragment_sources, size_t fragment_count);
+
+GLuint shader_cache_load(shader_cache_T* cache, uint64_t key);
+
+void shader_cache_prepare(shader_cache_T* cache, GLuint program);
+
+int shader_cache_store(shader_cache_T* cache, uint64_t key, GLuint program);
+
+void shader_cache_free(shader_cache_T* cache);
+#endif
@@ -0,0 +1,62 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+#include "shader_cache.h"
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum
+{
+    SHADER_PROGRAM_COMPILING,
+    SHADER_PROGRAM_LINKING,
+    SHADER_PROGRAM_READY,
+    SHADER_PROGRAM_FAILED
+} shader_program_state_T;
+
+/**
+ * A program that may still be compiling, only draw with it once
+ * `program` is not 0. A reload builds into `linking` while the old
+ * `program` stays usable, `generation` goes up whenever `program`
+ * is replaced so users know to rebind uniforms.
+ */
+typedef struct SHADER_PROGRAM_STRUCT
+{
+    char* name;
+    GLuint program;
+    GLuint linking;
+    GLuint vertex_shader;
+    GLuint fragment_shader;
+    uint64_t key;
+    shader_program_state_T state;
+    size_t generation;
+} shader_program_T;
+
+/**
+ * Submits every compile up front and checks on them without blocking,
+ * so with KHR_parallel_shader_compile the driver builds them on its
+ * own threads while we keep loading.
+ */
+typedef struct SHADER_MANAGER_STRUCT
+{
+    shader_cache_T* cache;
+    int parallel;
+    shader_program_T** programs;
+    size_t program_count;
+} shader_manager_T;
+
+shader_manager_T* init_shader_manager(shader_cache_T* cache);
+
+shader_program_T* shader_manager_add(shader_manager_T* manager, const char* name,
+                                     const char* const* vertex_sources, size_t vertex_count,
+                                     const char* const* fragment_sources, size_t fragment_count);
+
+void shader_manager_reload(shader_manager_T* manager, shader_program_T* program,
+                           const char* const* vertex_sources, size_t vertex_count,
+                           const char* const* fragment_sources, size_t fragment_count);
+
+size_t shader_manager_update(shader_manager_T* manager);
+
+void shader_manager_finish(shader_manager_T* manager);
+
+void shader_manager_free(shader_manager_T* manager);
+#endif
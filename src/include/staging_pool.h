@@ -0,0 +1,89 @@
+#ifndef STAGING_POOL_H
+#define STAGING_POOL_H
+#include <GL/glew.h>
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * Offsets into the upload buffer are aligned for any pixel format.
+ */
+#define STAGING_POOL_ALIGNMENT 256
+
+/**
+ * Heap blocks are rounded up to a power of two, at least
+ * 1 << STAGING_POOL_MIN_CLASS bytes, and a few of each size
+ * are kept around for the next image.
+ */
+#define STAGING_POOL_MIN_CLASS 12
+#define STAGING_POOL_CLASSES 32
+#define STAGING_POOL_CACHED 4
+
+/**
+ * Memory an image is decoded into. A `mapped` block lives in the
+ * upload buffer at `offset`, so it can be uploaded without a copy.
+ */
+typedef struct STAGING_BLOCK_STRUCT
+{
+    void* data;
+    size_t offset;
+    size_t size;
+    int mapped;
+} staging_block_T;
+
+/**
+ * A free range of the upload buffer, sorted by offset.
+ */
+typedef struct STAGING_RANGE_STRUCT
+{
+    size_t offset;
+    size_t size;
+    struct STAGING_RANGE_STRUCT* next;
+} staging_range_T;
+
+/**
+ * A block the GPU may still read from.
+ */
+typedef struct STAGING_RETIRED_STRUCT
+{
+    staging_block_T block;
+    GLsync fence;
+    struct STAGING_RETIRED_STRUCT* next;
+} staging_retired_T;
+
+/**
+ * Hands out memory to decode images into, from any thread.
+ * With ARB_buffer_storage it is carved out of one persistently mapped
+ * pixel unpack buffer, otherwise, or when that is full, it comes from
+ * recycled heap blocks.
+ */
+typedef struct STAGING_POOL_STRUCT
+{
+    pthread_mutex_t lock;
+
+    GLuint buffer;
+    unsigned char* mapped;
+    size_t size;
+    staging_range_T* ranges;
+    staging_retired_T* retired;
+    staging_retired_T* retired_tail;
+
+    void* cached[STAGING_POOL_CLASSES][STAGING_POOL_CACHED];
+    size_t cached_count[STAGING_POOL_CLASSES];
+
+    size_t mapped_allocs;
+    size_t heap_allocs;
+    size_t heap_reuses;
+} staging_pool_T;
+
+staging_pool_T* init_staging_pool(size_t size);
+
+int staging_pool_alloc(staging_pool_T* pool, size_t size, int mapped, staging_block_T* block);
+
+void staging_pool_release(staging_pool_T* pool, staging_block_T* block);
+
+void staging_pool_retire(staging_pool_T* pool, staging_block_T* block);
+
+void staging_pool_update(staging_pool_T* pool);
+
+void staging_pool_free(staging_pool_T* pool);
+#endif
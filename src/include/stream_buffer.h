@@ -0,0 +1,41 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+#include <GL/glew.h>
+#include <stddef.h>
+
+/**
+ * The buffer is split into this many per frame regions, the CPU
+ * writes one while the GPU may still read the other two.
+ */
+#define STREAM_BUFFER_REGIONS 3
+
+/**
+ * One big buffer for geometry that changes every frame.
+ * With ARB_buffer_storage it stays persistently mapped, otherwise each
+ * region is mapped unsynchronized for the duration of a frame.
+ */
+typedef struct STREAM_BUFFER_STRUCT
+{
+    GLuint buffer;
+    GLenum target;
+    int persistent;
+    void* mapped;
+    size_t region_size;
+    size_t region;
+    size_t offset;
+    GLsync fences[STREAM_BUFFER_REGIONS];
+    size_t stalls;
+} stream_buffer_T;
+
+stream_buffer_T* init_stream_buffer(GLenum target, size_t region_size);
+
+void stream_buffer_begin_frame(stream_buffer_T* stream);
+
+void* stream_buffer_alloc(stream_buffer_T* stream, size_t size, size_t alignment, size_t* offset);
+
+void stream_buffer_commit(stream_buffer_T* stream);
+
+void stream_buffer_end_frame(stream_buffer_T* stream);
+
+void stream_buffer_free(stream_buffer_T* stream);
+#endif
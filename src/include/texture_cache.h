@@ -0,0 +1,153 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+#include "gpu_memory.h"
+#include "texture_loader.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Textures are never shrunk below this many texels per side,
+ * smaller ones are evicted entirely instead.
+ */
+#define TEXTURE_CACHE_MIN_SIZE 32
+
+/**
+ * Textures used within this many frames are never evicted.
+ */
+#define TEXTURE_CACHE_IDLE_FRAMES 60
+
+/**
+ * A texture on the GPU, shared by every path with the same file
+ * contents. `refs` counts those paths and `path` is one of them, the
+ * file it is decoded from.
+ * `bytes` is its size on the GPU, `lod` the amount of mip levels it
+ * was shrunk by to stay within the memory budget and `resident` is 0
+ * once it was evicted down to the placeholder. Both are undone when
+ * the texture is used again and fits, and only change once the resized
+ * texture has been uploaded. `failed` is set when an evicted texture
+ * could not be loaded again, it is retried once its file changes.
+ * `content_hash` & `content_size` describe the file it was decoded
+ * from, other files only share it when their bytes are equal.
+ */
+typedef struct TEXTURE_IMAGE_STRUCT
+{
+    unsigned int id;
+    uint64_t content_hash;
+    size_t content_size;
+    size_t refs;
+
+    char* path;
+    size_t bytes;
+    size_t full_bytes;
+    unsigned int width;
+    unsigned int height;
+    size_t lod;
+    int resident;
+    int failed;
+    size_t loading;
+    uint64_t last_used;
+    struct TEXTURE_IMAGE_STRUCT* prev;
+    struct TEXTURE_IMAGE_STRUCT* next;
+} texture_image_T;
+
+/**
+ * A reference counted texture for one path.
+ * `id` is the GL texture of `image`, it changes when the file is edited
+ * while other paths still share the old contents.
+ */
+typedef struct TEXTURE_STRUCT
+{
+    unsigned int id;
+    size_t refs;
+    char* path;
+    texture_image_T* image;
+} texture_T;
+
+/**
+ * Slot in one of the open addressing tables.
+ * `key` is the canonical path for the path table and NULL for
+ * the content & id tables. The path table holds a `texture`,
+ * the others an `image`.
+ */
+typedef struct TEXTURE_CACHE_SLOT_STRUCT
+{
+    uint64_t hash;
+    char* key;
+    texture_T* texture;
+    texture_image_T* image;
+    int state;
+} texture_cache_slot_T;
+
+/**
+ * Registry of loaded textures, deduplicated on path and file contents.
+ * Textures are kept in least recently used order, most recent first,
+ * and shrunk or evicted from the back when `memory` is over budget.
+ */
+typedef struct TEXTURE_CACHE_STRUCT
+{
+    texture_loader_T* loader;
+    gpu_memory_T* memory;
+
+    texture_cache_slot_T* paths;
+    size_t paths_capacity;
+    size_t paths_used;
+
+    texture_cache_slot_T* contents;
+    size_t contents_capacity;
+    size_t contents_used;
+
+    texture_cache_slot_T* ids;
+    size_t ids_capacity;
+    size_t ids_used;
+
+    texture_image_T* lru_head;
+    texture_image_T* lru_tail;
+    uint64_t frame;
+
+    size_t hits;
+    size_t content_hits;
+    size_t misses;
+    size_t reloads;
+    size_t shrinks;
+    size_t evictions;
+    size_t restores;
+} texture_cache_T;
+
+/**
+ * Textures requested together, e.g. everything a level needs.
+ * `loaded` of them have finished, successfully or not, `bytes` is what
+ * those take on the GPU. Updated by texture_batch_update.
+ */
+typedef struct TEXTURE_BATCH_STRUCT
+{
+    texture_T** textures;
+    size_t count;
+    size_t loaded;
+    size_t bytes;
+} texture_batch_T;
+
+texture_cache_T* init_texture_cache(texture_loader_T* loader, gpu_memory_T* memory);
+
+texture_T* texture_cache_get(texture_cache_T* cache, const char* path);
+
+int texture_cache_reload(texture_cache_T* cache, const char* path);
+
+void texture_cache_touch(texture_cache_T* cache, texture_T* texture);
+
+size_t texture_cache_update(texture_cache_T* cache);
+
+void texture_cache_retain(texture_T* texture);
+
+void texture_cache_release(texture_cache_T* cache, texture_T* texture);
+
+texture_batch_T* texture_cache_load_batch(texture_cache_T* cache, const char* const* paths, size_t count);
+
+int texture_batch_update(texture_batch_T* batch);
+
+void texture_batch_free(texture_cache_T* cache, texture_batch_T* batch);
+
+void texture_cache_print_stats(texture_cache_T* cache, FILE* out);
+
+void texture_cache_free(texture_cache_T* cache);
+#endif
@@ -0,0 +1,21 @@
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+#include "image.h"
+#include <GL/glew.h>
+#include <stddef.h>
+
+/**
+ * Block compressed formats we know how to encode.
+ * BC1 is 8 bytes and BC3 is 16 bytes per 4x4 block.
+ */
+#define TEXTURE_COMPRESS_BC1 GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define TEXTURE_COMPRESS_BC3 GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+
+int texture_compress_supported(void);
+
+GLenum texture_compress_choose_format(const image_T* image);
+
+size_t texture_compress_size(GLenum format, unsigned int width, unsigned int height);
+
+void* texture_compress_image(const image_T* image, GLenum format, size_t* size);
+#endif
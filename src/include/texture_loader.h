@@ -0,0 +1,199 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+#include "image.h"
+#include "mipmap.h"
+#include "staging_pool.h"
+#include <GL/glew.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Amount of pixel buffer objects used as upload staging.
+ * Every upload of a frame that is not decoded into mapped memory is
+ * packed into the same one, three lets the driver read those of the
+ * last frames while we fill another.
+ */
+#define TEXTURE_LOADER_PBO_COUNT 3
+
+/**
+ * Bytes a staging buffer is created with at least, so a frame's worth
+ * of small uploads fits in one. Larger jobs grow it.
+ */
+#define TEXTURE_LOADER_PBO_SIZE (8 * 1024 * 1024)
+
+/**
+ * Offset alignment of uploads packed into a staging buffer.
+ */
+#define TEXTURE_LOADER_PBO_ALIGNMENT 16
+
+/**
+ * Frames a decoded job waits at most before it is uploaded ahead of
+ * the smaller ones, so large textures are not starved.
+ */
+#define TEXTURE_LOADER_MAX_WAIT 30
+
+/**
+ * Bytes of mapped upload memory images are decoded straight into.
+ */
+#define TEXTURE_LOADER_STAGING_SIZE (32 * 1024 * 1024)
+
+/**
+ * Nanoseconds per frame spent issuing uploads, at least one texture
+ * is uploaded every frame regardless.
+ */
+#define TEXTURE_LOADER_UPLOAD_BUDGET 2000000
+
+/**
+ * GL_TIME_ELAPSED queries around each frame's uploads, read back this
+ * many frames late so we never wait for one.
+ */
+#define TEXTURE_LOADER_TIMERS 4
+
+/**
+ * Default GL_TEXTURE_MAX_LEVEL, glGenerateMipmap fills every level up to it.
+ */
+#define TEXTURE_LOADER_MAX_LEVEL_DEFAULT 1000
+
+/**
+ * A single texture waiting to be decoded and / or uploaded.
+ * `lod` drops that many levels off the top of the mip chain, a resize
+ * is a reload to free or regain memory and is not reported.
+ * The base level is decoded into `staging`, when it is mapped it is
+ * uploaded from there without being copied. `upload_size` is the
+ * bytes of every level, known once decoded. A `cancelled` job belongs
+ * to a texture that was deleted and is dropped without touching GL.
+ */
+typedef struct TEXTURE_JOB_STRUCT
+{
+    unsigned int texture;
+    char* path;
+    image_T levels[MIPMAP_MAX_LEVELS];
+    size_t level_count;
+    staging_block_T staging;
+    GLenum format;
+    void* compressed;
+    size_t compressed_sizes[MIPMAP_MAX_LEVELS];
+    int failed;
+    int reload;
+    int resize;
+    int direct;
+    int cancelled;
+    struct TEXTURE_LOADER_STRUCT* loader;
+    size_t lod;
+    size_t upload_size;
+    uint64_t ready_frame;
+    struct TEXTURE_JOB_STRUCT* next;
+} texture_job_T;
+
+/**
+ * A texture whose storage was (re)specified, `lod` is the amount of
+ * levels it is missing. Failed jobs are recorded too, so every request
+ * ends in exactly one of these.
+ */
+typedef struct TEXTURE_UPLOAD_STRUCT
+{
+    unsigned int texture;
+    size_t lod;
+    int failed;
+} texture_upload_T;
+
+/**
+ * A pixel buffer object used to hand decoded pixels over to GL,
+ * `used` bytes of it were filled this frame.
+ */
+typedef struct TEXTURE_PBO_STRUCT
+{
+    GLuint buffer;
+    size_t size;
+    size_t used;
+    void* mapped;
+    GLsync fence;
+} texture_pbo_T;
+
+/**
+ * GPU time of the uploads of one frame, `bytes` of them.
+ */
+typedef struct TEXTURE_UPLOAD_TIMER_STRUCT
+{
+    GLuint query;
+    size_t bytes;
+    int pending;
+} texture_upload_timer_T;
+
+/**
+ * Decodes images on worker threads and uploads them on the GL thread.
+ * Decoded jobs wait in `ready`, sorted by size with the smallest last,
+ * and are uploaded smallest first for up to `upload_budget` nanoseconds
+ * a frame, 0 for no limit. A job that waited TEXTURE_LOADER_MAX_WAIT
+ * frames goes first. `frame` counts texture_loader_update calls.
+ * `uploads` collects what happened since the owner last emptied it,
+ * by setting `upload_count` to 0. `uploaded_bytes` adds up every upload
+ * issued so far, `upload_time` is the GPU time in nanoseconds that
+ * `timed_bytes` of those took, see texture_loader_upload_throughput.
+ */
+typedef struct TEXTURE_LOADER_STRUCT
+{
+    pthread_t* workers;
+    size_t worker_count;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int running;
+
+    texture_job_T* queued;
+    texture_job_T* queued_tail;
+    texture_job_T* processing;
+    texture_job_T* decoded;
+    texture_job_T* decoded_tail;
+    size_t in_flight;
+
+    texture_job_T** ready;
+    size_t ready_count;
+    size_t ready_capacity;
+    uint64_t upload_budget;
+    uint64_t frame;
+
+    int persistent;
+    int compress;
+    mipmap_filter_T mipmap_filter;
+    texture_pbo_T pbos[TEXTURE_LOADER_PBO_COUNT];
+    size_t pbo_index;
+    staging_pool_T* staging;
+
+    texture_upload_T* uploads;
+    size_t upload_count;
+    size_t upload_capacity;
+
+    size_t uploaded_bytes;
+    size_t timed_bytes;
+    uint64_t upload_time;
+    texture_upload_timer_T timers[TEXTURE_LOADER_TIMERS];
+    size_t timer_index;
+} texture_loader_T;
+
+texture_loader_T* init_texture_loader(size_t worker_count);
+
+unsigned int texture_loader_get_texture(texture_loader_T* loader, const char* path);
+
+void texture_loader_reload(texture_loader_T* loader, unsigned int texture, const char* path);
+
+void texture_loader_resize(texture_loader_T* loader, unsigned int texture, const char* path, size_t lod);
+
+void texture_loader_evict(texture_loader_T* loader, unsigned int texture);
+
+void texture_loader_cancel(texture_loader_T* loader, unsigned int texture);
+
+int texture_loader_set_compression(texture_loader_T* loader, int enabled);
+
+void texture_loader_set_mipmap_filter(texture_loader_T* loader, mipmap_filter_T filter);
+
+void texture_loader_set_upload_budget(texture_loader_T* loader, uint64_t budget);
+
+size_t texture_loader_update(texture_loader_T* loader);
+
+size_t texture_loader_pending(texture_loader_T* loader);
+
+double texture_loader_upload_throughput(texture_loader_T* loader);
+
+void texture_loader_free(texture_loader_T* loader);
+#endif
@@ -0,0 +1,29 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+#include <stddef.h>
+
+/**
+ * 2D transforms of many objects as structure of arrays, every array
+ * is 16 byte aligned and padded so the kernels can always load
+ * whole vectors.
+ * `rotation` is around z in radians.
+ */
+typedef struct TRANSFORM_SOA_STRUCT
+{
+    float* x;
+    float* y;
+    float* z;
+    float* rotation;
+    float* scale_x;
+    float* scale_y;
+    size_t count;
+} transform_soa_T;
+
+transform_soa_T* init_transform_soa(size_t count);
+
+void transform_sincos(const float* angles, float* sin_out, float* cos_out, size_t count);
+
+void transform_soa_models(const transform_soa_T* soa, size_t first, size_t count, float* out, size_t stride);
+
+void transform_soa_free(transform_soa_T* soa);
+#endif
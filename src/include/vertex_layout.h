@@ -0,0 +1,71 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define VERTEX_LAYOUT_MAX_ATTRIBUTES 8
+
+/**
+ * Compile time description of the interleaved vertex format.
+ * X(field, shader name, C type, components, GL type, normalized, inputs)
+ * Change the packing here, the struct, the attribute table and
+ * vertex_pack are all generated from it. `inputs` is the amount of
+ * floats vertex_pack reads for the field, missing components are
+ * filled in like GL does, with 0 and 1 for the fourth.
+ */
+#define PACKED_VERTEX_ATTRIBUTES(X) \
+    X(position, "vPos",      uint16_t, 2, GL_HALF_FLOAT,     GL_FALSE, 2) \
+    X(texcoord, "aTexCoord", uint16_t, 2, GL_UNSIGNED_SHORT, GL_TRUE,  2) \
+    X(color,    "vCol",      uint8_t,  4, GL_UNSIGNED_BYTE,  GL_TRUE,  3)
+
+/**
+ * Bytes per component of the GL types vertex_pack can convert to,
+ * 0 for anything else.
+ */
+#define VERTEX_LAYOUT_TYPE_SIZE(type) \
+    ((type) == GL_FLOAT ? 4 : \
+     (type) == GL_HALF_FLOAT || (type) == GL_SHORT || (type) == GL_UNSIGNED_SHORT ? 2 : \
+     (type) == GL_BYTE || (type) == GL_UNSIGNED_BYTE ? 1 : 0)
+
+#define VERTEX_LAYOUT_FIELD(field, name, ctype, size, type, normalized, inputs) ctype field[size];
+
+/**
+ * One interleaved vertex, 12 bytes with the packing above.
+ */
+typedef struct PACKED_VERTEX_STRUCT
+{
+    PACKED_VERTEX_ATTRIBUTES(VERTEX_LAYOUT_FIELD)
+} packed_vertex_T;
+
+typedef struct VERTEX_ATTRIBUTE_STRUCT
+{
+    const char* name;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+} vertex_attribute_T;
+
+typedef struct VERTEX_LAYOUT_STRUCT
+{
+    GLsizei stride;
+    size_t attribute_count;
+    vertex_attribute_T attributes[VERTEX_LAYOUT_MAX_ATTRIBUTES];
+} vertex_layout_T;
+
+extern const vertex_layout_T packed_vertex_layout;
+
+void vertex_layout_apply(const vertex_layout_T* layout, GLuint program, size_t base_offset);
+
+uint16_t vertex_pack_half(float v);
+
+uint16_t vertex_pack_unorm16(float v);
+
+uint8_t vertex_pack_unorm8(float v);
+
+void vertex_pack_attribute(void* dst, GLint size, GLenum type, GLboolean normalized,
+                           const float* src, size_t inputs);
+
+void vertex_pack(packed_vertex_T* vertex, const float* position, const float* texcoord, const float* color);
+#endif
@@ -0,0 +1,168 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+#include "mipmap.h"
+#include "render_state.h"
+#include <GL/glew.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define VIRTUAL_TEXTURE_MAGIC "TGLVTEX"
+#define VIRTUAL_TEXTURE_VERSION 1
+#define VIRTUAL_TEXTURE_EXTENSION ".tvt"
+
+/**
+ * Texels per page side, plus a border of texels repeated from the
+ * neighbouring pages so bilinear filtering does not show seams.
+ */
+#define VIRTUAL_TEXTURE_PAGE_SIZE 128
+#define VIRTUAL_TEXTURE_PAGE_BORDER 1
+
+/**
+ * The page table stores slot coordinates in 8 bits each, and 16 levels
+ * of 128 texel pages cover any image MIPMAP_MAX_LEVELS allows.
+ */
+#define VIRTUAL_TEXTURE_MAX_SLOTS_PER_SIDE 256
+#define VIRTUAL_TEXTURE_MAX_LEVELS MIPMAP_MAX_LEVELS
+
+/**
+ * The feedback buffer is read back at 1/8 of the viewport, a few
+ * frames late so the read never stalls.
+ */
+#define VIRTUAL_TEXTURE_FEEDBACK_SCALE 8
+#define VIRTUAL_TEXTURE_FEEDBACK_FRAMES 3
+
+/**
+ * Pages waiting for the streaming thread & pages uploaded per frame.
+ */
+#define VIRTUAL_TEXTURE_MAX_REQUESTS 256
+#define VIRTUAL_TEXTURE_UPLOADS_PER_FRAME 16
+
+/**
+ * Values of `page_slots` for pages that are not in the cache.
+ */
+#define VIRTUAL_TEXTURE_PAGE_FREE -1
+#define VIRTUAL_TEXTURE_PAGE_LOADING -2
+#define VIRTUAL_TEXTURE_PAGE_EMPTY -3
+
+/**
+ * On-disk header, followed by one uint64_t file offset per page for
+ * every level, level 0 first and rows top to bottom. An offset of 0
+ * is a page entirely outside the image, which is not stored.
+ * Every stored page is (PAGE_SIZE + 2 * PAGE_BORDER)^2 RGBA8 texels.
+ */
+typedef struct VIRTUAL_TEXTURE_HEADER_STRUCT
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t page_size;
+    uint32_t page_border;
+    uint32_t pages;
+    uint32_t level_count;
+} virtual_texture_header_T;
+
+/**
+ * A physical page of the cache texture, linked into the LRU list.
+ */
+typedef struct VIRTUAL_TEXTURE_SLOT_STRUCT
+{
+    int32_t page;
+    int32_t prev;
+    int32_t next;
+    uint64_t frame;
+} virtual_texture_slot_T;
+
+/**
+ * A page read by the streaming thread, waiting to be uploaded.
+ */
+typedef struct VIRTUAL_TEXTURE_LOAD_STRUCT
+{
+    int32_t page;
+    uint32_t* pixels;
+    struct VIRTUAL_TEXTURE_LOAD_STRUCT* next;
+} virtual_texture_load_T;
+
+typedef struct VIRTUAL_TEXTURE_FEEDBACK_STRUCT
+{
+    GLuint buffer;
+    GLsync fence;
+    int width;
+    int height;
+} virtual_texture_feedback_T;
+
+/**
+ * A texture of any size drawn from a fixed size cache of pages.
+ * Draws write the pages they need into a feedback attachment, which
+ * is read back asynchronously to stream missing pages from disk.
+ * Until a page arrives its closest resident ancestor is sampled.
+ */
+typedef struct VIRTUAL_TEXTURE_STRUCT
+{
+    int fd;
+    virtual_texture_header_T header;
+    uint64_t* offsets;
+    size_t page_count;
+    size_t page_bytes;
+    uint32_t level_first[VIRTUAL_TEXTURE_MAX_LEVELS];
+
+    int32_t* page_slots;
+    uint32_t* table;
+    uint32_t dirty_levels;
+    GLuint page_table;
+
+    GLuint cache;
+    size_t slots_per_side;
+    virtual_texture_slot_T* slots;
+    size_t slot_count;
+    int32_t lru_head;
+    int32_t lru_tail;
+    uint64_t frame;
+
+    pthread_t thread;
+    int thread_started;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int running;
+    int32_t requests[VIRTUAL_TEXTURE_MAX_REQUESTS];
+    size_t request_head;
+    size_t request_count;
+    virtual_texture_load_T* loaded;
+    virtual_texture_load_T* loaded_tail;
+
+    GLuint scene_fbo;
+    GLuint scene_color;
+    GLuint scene_feedback;
+    GLuint feedback_fbo;
+    GLuint feedback_color;
+    int width;
+    int height;
+    virtual_texture_feedback_T feedback[VIRTUAL_TEXTURE_FEEDBACK_FRAMES];
+    size_t feedback_index;
+
+    size_t uploads;
+    size_t evictions;
+    size_t thrashing;
+} virtual_texture_T;
+
+const char* virtual_texture_glsl(void);
+
+virtual_texture_T* init_virtual_texture(const char* path, size_t budget);
+
+int virtual_texture_bind_program(virtual_texture_T* vt, GLuint program, GLint table_unit);
+
+size_t virtual_texture_update(virtual_texture_T* vt);
+
+void virtual_texture_begin_frame(virtual_texture_T* vt, render_state_T* state, int width, int height);
+
+void virtual_texture_end_frame(virtual_texture_T* vt, render_state_T* state, GLuint target);
+
+void virtual_texture_uv_rect(virtual_texture_T* vt, float* uv_rect);
+
+size_t virtual_texture_resident(virtual_texture_T* vt);
+
+void virtual_texture_free(virtual_texture_T* vt);
+
+int virtual_texture_bake(const char* src, const char* dst, mipmap_filter_T filter);
+#endif
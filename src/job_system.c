@@ -0,0 +1,356 @@
+#include "include/job_system.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/**
+ * Owner only.
+ *
+ * @param job_deque_T* deque
+ * @param const job_T* job
+ * @return int 0 when the deque is full.
+ */
+static int job_deque_push(job_deque_T* deque, const job_T* job)
+{
+    int_fast64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    int_fast64_t t = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+    if (b - t >= JOB_DEQUE_SIZE)
+        return 0;
+
+    deque->jobs[b & (JOB_DEQUE_SIZE - 1)] = *job;
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+
+    return 1;
+}
+
+/**
+ * Owner only, takes the newest job.
+ *
+ * @param job_deque_T* deque
+ * @param job_T* job
+ * @return int 0 when empty.
+ */
+static int job_deque_pop(job_deque_T* deque, job_T* job)
+{
+    int_fast64_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int_fast64_t t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (t > b)
+    {
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return 0;
+    }
+
+    *job = deque->jobs[b & (JOB_DEQUE_SIZE - 1)];
+
+    if (t == b)
+    {
+        /**
+         * Last job, race the thieves for it.
+         */
+        int won = atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1,
+                                                          memory_order_seq_cst,
+                                                          memory_order_relaxed);
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return won;
+    }
+
+    return 1;
+}
+
+/**
+ * Any thread, takes the oldest job.
+ *
+ * @param job_deque_T* deque
+ * @param job_T* job
+ * @return int 0 when empty or another thread was faster.
+ */
+static int job_deque_steal(job_deque_T* deque, job_T* job)
+{
+    int_fast64_t t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int_fast64_t b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (t >= b)
+        return 0;
+
+    *job = deque->jobs[t & (JOB_DEQUE_SIZE - 1)];
+
+    return atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1,
+                                                   memory_order_seq_cst,
+                                                   memory_order_relaxed);
+}
+
+/**
+ * @param job_T* job
+ * @param job_system_T* system
+ * @param size_t worker
+ */
+static void job_run(job_T* job, job_system_T* system, size_t worker)
+{
+    job->fn(system, worker, job->data);
+
+    if (job->counter)
+        atomic_fetch_sub_explicit(job->counter, 1, memory_order_release);
+}
+
+/**
+ * Find a job, our own deque first, then steal starting at a random
+ * victim so thieves spread out.
+ *
+ * @param job_system_T* system
+ * @param job_worker_T* worker
+ * @param job_T* job
+ * @return int 0 if there was nothing to do.
+ */
+static int job_system_next(job_system_T* system, job_worker_T* worker, job_T* job)
+{
+    if (job_deque_pop(&worker->deque, job))
+        return 1;
+
+    size_t count = system->slot_count;
+
+    worker->random ^= worker->random << 13;
+    worker->random ^= worker->random >> 17;
+    worker->random ^= worker->random << 5;
+
+    size_t start = worker->random % count;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t victim = (start + i) % count;
+        if (victim == worker->index)
+            continue;
+
+        if (job_deque_steal(&system->workers[victim].deque, job))
+        {
+            atomic_fetch_add_explicit(&system->steals, 1, memory_order_relaxed);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void* job_system_worker(void* ptr)
+{
+    job_worker_T* worker = (job_worker_T*) ptr;
+    job_system_T* system = worker->system;
+    job_T job;
+
+    while (atomic_load(&system->running))
+    {
+        if (job_system_next(system, worker, &job))
+        {
+            atomic_fetch_sub(&system->queued, 1);
+            job_run(&job, system, worker->index);
+            continue;
+        }
+
+        /**
+         * Nothing to steal right now, sleep until something is submitted.
+         * `sleeping` is raised before checking `queued`, and submitters
+         * bump `queued` before checking `sleeping`, so a wake up is
+         * never missed.
+         */
+        pthread_mutex_lock(&system->lock);
+        atomic_fetch_add(&system->sleeping, 1);
+
+        while (atomic_load(&system->running) && atomic_load(&system->queued) == 0)
+            pthread_cond_wait(&system->cond, &system->lock);
+
+        atomic_fetch_sub(&system->sleeping, 1);
+        pthread_mutex_unlock(&system->lock);
+    }
+
+    return NULL;
+}
+
+/**
+ * Start a job system.
+ *
+ * @param size_t worker_count, 0 means one per core, minus the GL thread.
+ * @return job_system_T*
+ */
+job_system_T* init_job_system(size_t worker_count)
+{
+    if (worker_count == 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_count = cores > 1 ? (size_t) cores - 1 : 1;
+    }
+
+    job_system_T* system = calloc(1, sizeof(struct JOB_SYSTEM_STRUCT));
+    size_t size = (worker_count + 1) * sizeof(job_worker_T);
+    system->workers = aligned_alloc(64, (size + 63) & ~(size_t) 63);
+    memset(system->workers, 0, size);
+
+    system->slot_count = worker_count + 1;
+
+    pthread_mutex_init(&system->lock, NULL);
+    pthread_cond_init(&system->cond, NULL);
+    atomic_store(&system->running, 1);
+
+    for (size_t i = 0; i <= worker_count; i++)
+    {
+        job_worker_T* worker = &system->workers[i];
+        worker->system = system;
+        worker->index = i;
+        worker->arena = init_arena(0);
+        worker->random = 2654435761u * (i + 1);
+    }
+
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        if (pthread_create(&system->workers[i].thread, NULL, job_system_worker, &system->workers[i]) != 0)
+        {
+            fprintf(stderr, "Could not create job system thread\n");
+            break;
+        }
+        system->worker_count++;
+    }
+
+    /**
+     * The creating thread takes the first slot without a thread,
+     * which is the last one unless some threads failed to start.
+     */
+    for (size_t i = system->worker_count + 1; i <= worker_count; i++)
+    {
+        arena_free(system->workers[i].arena);
+        system->workers[i].arena = NULL;
+    }
+
+    return system;
+}
+
+/**
+ * Worker index of the thread that created the system.
+ *
+ * @param job_system_T* system
+ * @return size_t
+ */
+size_t job_system_main_worker(job_system_T* system)
+{
+    return system->worker_count;
+}
+
+/**
+ * Linear arena of a worker, only that worker may allocate from it
+ * while jobs are running.
+ *
+ * @param job_system_T* system
+ * @param size_t worker
+ * @return arena_T*
+ */
+arena_T* job_system_arena(job_system_T* system, size_t worker)
+{
+    return system->workers[worker].arena;
+}
+
+/**
+ * Queue a job on the calling worker's deque.
+ *
+ * @param job_system_T* system
+ * @param size_t worker, index of the calling thread.
+ * @param job_fn_T fn
+ * @param void* data
+ * @param job_counter_T* counter, decremented when the job is done, may be NULL.
+ */
+void job_system_submit(job_system_T* system, size_t worker, job_fn_T fn, void* data, job_counter_T* counter)
+{
+    job_T job = { fn, data, counter };
+
+    if (counter)
+        atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+
+    /**
+     * Counted before it is pushed, so a thief can never take
+     * `queued` below zero.
+     */
+    atomic_fetch_add(&system->queued, 1);
+
+    if (!job_deque_push(&system->workers[worker].deque, &job))
+    {
+        atomic_fetch_sub(&system->queued, 1);
+        job_run(&job, system, worker);
+        return;
+    }
+
+    if (atomic_load(&system->sleeping) > 0)
+    {
+        pthread_mutex_lock(&system->lock);
+        pthread_cond_broadcast(&system->cond);
+        pthread_mutex_unlock(&system->lock);
+    }
+}
+
+/**
+ * Wait for a counter to reach zero, running jobs meanwhile instead
+ * of blocking.
+ *
+ * @param job_system_T* system
+ * @param size_t worker, index of the calling thread.
+ * @param job_counter_T* counter
+ */
+void job_system_wait(job_system_T* system, size_t worker, job_counter_T* counter)
+{
+    job_worker_T* self = &system->workers[worker];
+    job_T job;
+
+    while (atomic_load_explicit(counter, memory_order_acquire) > 0)
+    {
+        if (job_system_next(system, self, &job))
+        {
+            atomic_fetch_sub(&system->queued, 1);
+            job_run(&job, system, worker);
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * Forget everything allocated from the worker arenas, call once
+ * per frame when no jobs are running.
+ *
+ * @param job_system_T* system
+ */
+void job_system_reset_arenas(job_system_T* system)
+{
+    for (size_t i = 0; i <= system->worker_count; i++)
+        arena_reset(system->workers[i].arena);
+}
+
+/**
+ * Stop the workers and free the system.
+ * Jobs still queued are dropped.
+ *
+ * @param job_system_T* system
+ */
+void job_system_free(job_system_T* system)
+{
+    pthread_mutex_lock(&system->lock);
+    atomic_store(&system->running, 0);
+    pthread_cond_broadcast(&system->cond);
+    pthread_mutex_unlock(&system->lock);
+
+    for (size_t i = 0; i < system->worker_count; i++)
+        pthread_join(system->workers[i].thread, NULL);
+
+    for (size_t i = 0; i <= system->worker_count; i++)
+        arena_free(system->workers[i].arena);
+
+    pthread_mutex_destroy(&system->lock);
+    pthread_cond_destroy(&system->cond);
+    free(system->workers);
+    free(system);
+}
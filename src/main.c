@@ -1,10 +1,38 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <cglm/cglm.h>
 #include <cglm/call.h>
 #include <math.h>
 #include <png.h>
+#include "include/texture_loader.h"
+#include "include/texture_cache.h"
+#include "include/baked_texture.h"
+#include "include/texture_compress.h"
+#include "include/batch_renderer.h"
+#include "include/atlas.h"
+#include "include/vertex_layout.h"
+#include "include/profiler.h"
+#include "include/framebuffer.h"
+#include "include/shader_manager.h"
+#include "include/file_watch.h"
+#include "include/gpu_memory.h"
+#include "include/frame_uniforms.h"
+#include "include/render_state.h"
+#include "include/render_queue.h"
+#include "include/job_system.h"
+#include "include/transform.h"
+#include "include/frame_pacer.h"
+#include "include/virtual_texture.h"
+#include "include/image.h"
+#include "include/qoi.h"
+#include "include/sampler.h"
+#include "include/bench.h"
+#include "include/scene_file.h"
+#include "include/counters.h"
+#include "include/overlay.h"
+#include <string.h>
 
 
 /**
@@ -38,6 +66,16 @@ static void error_callback(int error, const char* description)
     fprintf(stderr, "Error: %s\n", description);
 }
 
+/**
+ * Filtering of the scene texture, switched at runtime with F.
+ */
+static sampler_T* sampler;
+
+/**
+ * Whether the counters are drawn over the frame, toggled with O.
+ */
+static int show_overlay;
+
 /**
  * Capture key callbacks from glfw
  */
@@ -45,75 +83,913 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GLFW_TRUE);
+
+    if (key == GLFW_KEY_F && action == GLFW_PRESS && sampler)
+    {
+        sampler_set_preset(sampler, (sampler->preset + 1) % SAMPLER_PRESET_COUNT);
+        printf("Sampler: %s\n", sampler_preset_name(sampler->preset));
+    }
+
+    if (key == GLFW_KEY_O && action == GLFW_PRESS)
+        show_overlay = !show_overlay;
+}
+
+/**
+ * Decodes & uploads textures in the background.
+ */
+static texture_loader_T* texture_loader;
+
+/**
+ * Shares textures between everyone loading the same file.
+ */
+static texture_cache_T* texture_cache;
+
+/**
+ * Get a shared texture, release it with texture_cache_release.
+ * A placeholder is shown until the image has been streamed in.
+ *
+ * @param const char* path
+ * @return texture_T*
+ */
+static texture_T* get_texture(const char* path)
+{
+    return texture_cache_get(texture_cache, path);
+}
+
+/**
+ * Re-decode a texture whose file changed, the new pixels are
+ * uploaded by texture_cache_update at the next frame.
+ *
+ * @param const char* path
+ * @param void* data
+ */
+static void reload_texture(const char* path, void* data)
+{
+    texture_cache_reload(texture_cache, path);
+}
+
+/**
+ * Read a whole text file.
+ *
+ * @param const char* path
+ * @return char*, NULL if it could not be read.
+ */
+static char* read_text_file(const char* path)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char* text = size >= 0 ? malloc(size + 1) : NULL;
+    if (text && fread(text, 1, size, fp) != (size_t) size)
+    {
+        free(text);
+        text = NULL;
+    }
+
+    if (text)
+        text[size] = 0;
+
+    fclose(fp);
+    return text;
+}
+
+/**
+ * Start loading every texture listed in a manifest, one path per line.
+ * Empty lines & lines starting with # are skipped.
+ *
+ * @param const char* path
+ * @return texture_batch_T* or NULL if the manifest could not be read.
+ */
+static texture_batch_T* load_manifest(const char* path)
+{
+    char* text = read_text_file(path);
+    if (text == NULL)
+    {
+        fprintf(stderr, "Could not read manifest `%s`\n", path);
+        return NULL;
+    }
+
+    const char** paths = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+
+    for (char* line = strtok(text, "\r\n"); line; line = strtok(NULL, "\r\n"))
+    {
+        if (line[0] == '#')
+            continue;
+
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 16;
+            paths = realloc(paths, capacity * sizeof(const char*));
+        }
+
+        paths[count++] = line;
+    }
+
+    texture_batch_T* batch = texture_cache_load_batch(texture_cache, paths, count);
+
+    free(paths);
+    free(text);
+    return batch;
 }
 
 /**
- * Get a texture as an unsigned integer
+ * Shader stages loaded from disk with --shaders, the header & defines
+ * chunks stay embedded so the files do not depend on the mode.
+ */
+typedef struct SHADER_FILES_STRUCT
+{
+    shader_manager_T* manager;
+    shader_program_T* program;
+    char* vertex_path;
+    char* fragment_path;
+    char* vertex_text;
+    char* fragment_text;
+    const char* vertex_sources[3];
+    const char* fragment_sources[4];
+} shader_files_T;
+
+/**
+ * Load the stages of `files`, writing out `vertex_text` & `fragment_text`
+ * first for the stages that do not exist yet.
+ *
+ * @param shader_files_T* files
+ * @param const char* vertex_text
+ * @param const char* fragment_text
+ * @return int 0 if a stage could not be read.
+ */
+static int load_shader_files(shader_files_T* files, const char* vertex_text, const char* fragment_text)
+{
+    const char* paths[2] = { files->vertex_path, files->fragment_path };
+    const char* texts[2] = { vertex_text, fragment_text };
+
+    for (int i = 0; i < 2; i++)
+    {
+        FILE* fp = fopen(paths[i], "r");
+        if (!fp && texts[i] && (fp = fopen(paths[i], "w")))
+            fputs(texts[i], fp);
+
+        if (fp)
+            fclose(fp);
+    }
+
+    char* vertex = read_text_file(files->vertex_path);
+    char* fragment = read_text_file(files->fragment_path);
+
+    if (!vertex || !fragment)
+    {
+        fprintf(stderr, "Could not read `%s` & `%s`\n", files->vertex_path, files->fragment_path);
+        free(vertex);
+        free(fragment);
+        return 0;
+    }
+
+    free(files->vertex_text);
+    free(files->fragment_text);
+    files->vertex_text = vertex;
+    files->fragment_text = fragment;
+    files->vertex_sources[2] = vertex;
+    files->fragment_sources[3] = fragment;
+    return 1;
+}
+
+/**
+ * Rebuild the scene program after one of its stages changed, the old
+ * program keeps drawing until the new one has linked.
  *
  * @param const char* path
- * @return unsigned int
+ * @param void* data, the shader_files_T.
+ */
+static void reload_shader(const char* path, void* data)
+{
+    shader_files_T* files = data;
+
+    if (!load_shader_files(files, NULL, NULL))
+        return;
+
+    fprintf(stdout, "Reloading %s\n", files->program->name);
+    shader_manager_reload(files->manager, files->program, files->vertex_sources, 3,
+                          files->fragment_sources, 4);
+}
+
+/**
+ * Shared by every scene update job of a frame.
+ * Each worker links the packets it records into its own list,
+ * so no locking is needed. Every other triangle is drawn with
+ * `alternate_sampler` instead, when it is not 0. With a scene `file`
+ * every instance draws its own mesh & texture.
  */
-static unsigned int get_texture(const char* path)
+typedef struct SCENE_UPDATE_STRUCT
 {
+    double t;
+    size_t columns;
+    float cell;
+    transform_soa_T* transforms;
+    uint64_t key;
+    render_draw_T draw;
+    GLuint alternate_sampler;
+    atlas_sprite_T sprite;
+    render_packet_T** packets;
+    scene_file_T* file;
+    const GLuint* vaos;
+    texture_T** textures;
+} scene_update_T;
+
+typedef struct SCENE_JOB_STRUCT
+{
+    scene_update_T* scene;
+    size_t first;
+    size_t count;
+} scene_job_T;
+
+/**
+ * Animate a range of triangles into a draw packet, allocated from
+ * the arena of the worker running the job.
+ *
+ * @param job_system_T* system
+ * @param size_t worker
+ * @param void* data, scene_job_T*
+ */
+static void update_instances(job_system_T* system, size_t worker, void* data)
+{
+    scene_job_T* job = (scene_job_T*) data;
+    scene_update_T* scene = job->scene;
+    arena_T* arena = job_system_arena(system, worker);
+
+    render_packet_T* packet = arena_alloc(arena, sizeof(render_packet_T), _Alignof(render_packet_T));
+    packet->commands = arena_alloc(arena, job->count * sizeof(render_command_T), 16);
+    packet->keys = arena_alloc(arena, job->count * sizeof(uint64_t), _Alignof(uint64_t));
+    packet->count = job->count;
+
+    float cell = scene->cell;
+    transform_soa_T* transforms = scene->transforms;
+
     /**
-     * Texture will be stored in this unsigned integer.
+     * Bounce every triangle around its cell, the cosines of the
+     * whole range are computed 4 at a time
      */
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    float* bounce = arena_alloc(arena, job->count * sizeof(float), 16);
+
+    for (size_t j = 0; j < job->count; j++)
+        bounce[j] = (float) (scene->t + (job->first + j) * 0.1);
+
+    transform_sincos(bounce, NULL, bounce, job->count);
+
+    for (size_t j = 0; j < job->count; j++)
+    {
+        size_t i = job->first + j;
+        float y = scene->file ? scene->file->transforms[SCENE_FILE_Y][i] : -1.0f + cell * (i / scene->columns + 0.5f);
+        transforms->y[i] = y + bounce[j] * transforms->scale_y[i];
+    }
+
+    transform_soa_models(transforms, job->first, job->count,
+                         (float*) packet->commands[0].instance.model, sizeof(render_command_T));
+
+    for (size_t j = 0; j < job->count; j++)
+    {
+        render_command_T* command = &packet->commands[j];
+        command->draw = scene->draw;
+        if (scene->alternate_sampler && (job->first + j) % 2)
+            command->draw.sampler = scene->alternate_sampler;
+        memcpy(command->instance.uv_rect, scene->sprite.uv_rect, sizeof(vec4));
+        command->instance.layer = scene->sprite.layer;
+        packet->keys[j] = scene->key;
+
+        if (scene->file)
+        {
+            uint32_t mesh = scene->file->instance_meshes[job->first + j];
+            command->draw.vao = scene->vaos[mesh];
+            command->draw.vertex_count = scene->file->meshes[mesh].vertex_count;
+            command->draw.texture = scene->textures[scene->file->instance_textures[job->first + j]]->id;
+            packet->keys[j] = render_queue_key(0, command->draw.program, command->draw.texture,
+                                               command->draw.vao, 0.0f);
+        }
+    }
+
+    packet->next = scene->packets[worker];
+    scene->packets[worker] = packet;
+}
+
+/**
+ * Parse a mip filter name.
+ *
+ * @param const char* name
+ * @param mipmap_filter_T* filter
+ * @return int 0 if the name is unknown.
+ */
+static int parse_mipmap_filter(const char* name, mipmap_filter_T* filter)
+{
+    if (strcmp(name, "box") == 0)
+        *filter = MIPMAP_FILTER_BOX;
+    else if (strcmp(name, "kaiser") == 0)
+        *filter = MIPMAP_FILTER_KAISER;
+    else if (strcmp(name, "none") == 0 || strcmp(name, "gpu") == 0)
+        *filter = MIPMAP_FILTER_NONE;
+    else
+        return 0;
+
+    return 1;
+}
+
+/**
+ * Bake .png files into GPU ready textures, no window needed.
+ * Usage: --bake input.png [output.tgb] [--format=rgba8|bc1|bc3|auto|qoi]
+ *                                      [--mip-filter=box|kaiser|none] [--virtual]
+ * --virtual cuts the image into pages for --virtual= instead,
+ * --format=qoi only re-encodes the image as a .qoi, without mipmaps.
+ *
+ * @param int argc
+ * @param char* argv[]
+ * @return int
+ */
+static int bake(int argc, char* argv[])
+{
+    const char* paths[2] = { NULL, NULL };
+    size_t path_count = 0;
+    GLenum format = GL_RGBA8;
+    mipmap_filter_T filter = MIPMAP_FILTER_BOX;
+    int virtual = 0;
+    int qoi = 0;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--virtual") == 0)
+        {
+            virtual = 1;
+            continue;
+        }
+
+        if (strncmp(argv[i], "--mip-filter=", 13) == 0)
+        {
+            if (!parse_mipmap_filter(argv[i] + 13, &filter))
+                path_count = 0;
+            continue;
+        }
+
+        if (strncmp(argv[i], "--format=", 9) != 0)
+        {
+            if (path_count < 2)
+                paths[path_count++] = argv[i];
+            continue;
+        }
+
+        const char* name = argv[i] + 9;
+
+        if (strcmp(name, "rgba8") == 0)
+            format = GL_RGBA8;
+        else if (strcmp(name, "bc1") == 0)
+            format = TEXTURE_COMPRESS_BC1;
+        else if (strcmp(name, "bc3") == 0)
+            format = TEXTURE_COMPRESS_BC3;
+        else if (strcmp(name, "auto") == 0)
+            format = BAKED_TEXTURE_FORMAT_AUTO;
+        else if (strcmp(name, "qoi") == 0)
+            qoi = 1;
+        else
+            path_count = 0;
+    }
+
+    if (path_count < 1)
+    {
+        fprintf(stderr, "Usage: --bake input.png [output%s] [--format=rgba8|bc1|bc3|auto|qoi] "
+                        "[--mip-filter=box|kaiser|none] [--virtual]\n", BAKED_TEXTURE_EXTENSION);
+        return 1;
+    }
+
+    char* dst = path_count > 1 ? strdup(paths[1]) : baked_texture_path(paths[0]);
 
     /**
-     * This is texture parameters,
-     * you can see them as "effects" that are applied to the
-     * loaded texture.
+     * Both extensions are 4 characters, swap them in place
      */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    _Static_assert(sizeof(VIRTUAL_TEXTURE_EXTENSION) == sizeof(BAKED_TEXTURE_EXTENSION), "extension length");
+    _Static_assert(sizeof(QOI_EXTENSION) == sizeof(BAKED_TEXTURE_EXTENSION), "extension length");
+    if (virtual && path_count == 1)
+        memcpy(dst + strlen(dst) - strlen(VIRTUAL_TEXTURE_EXTENSION), VIRTUAL_TEXTURE_EXTENSION,
+               strlen(VIRTUAL_TEXTURE_EXTENSION));
+    else if (qoi && path_count == 1)
+        memcpy(dst + strlen(dst) - strlen(QOI_EXTENSION), QOI_EXTENSION, strlen(QOI_EXTENSION));
+
+    int ok = 0;
+
+    if (qoi && !virtual)
+    {
+        image_T image = {};
+        ok = image_load(&image, paths[0]) && qoi_write(&image, dst);
+        image_release(&image);
+    }
+    else
+    {
+        ok = virtual ?
+            virtual_texture_bake(paths[0], dst, filter) :
+            baked_texture_bake(paths[0], dst, format, filter);
+    }
+    free(dst);
+
+    return ok ? 0 : 1;
+}
+
+/**
+ * Generate a stress test scene for --scene, see scene_file_generate.
+ * Textures default to rainbow.png.
+ * Usage: --make-scene output.tsc [--instances=N] [--meshes=N]
+ *        [--size=WIDTHxHEIGHT] [--seed=N] textures...
+ *
+ * @param int argc
+ * @param char* argv[]
+ * @return int
+ */
+static int make_scene(int argc, char* argv[])
+{
+    const char* path = NULL;
+    const char** textures = calloc(argc + 1, sizeof(const char*));
+    size_t texture_count = 0;
+    size_t instance_count = 100000;
+    size_t mesh_count = 4;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    unsigned long seed = 1;
+    int usage = 0;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--instances=", 12) == 0)
+            usage |= (instance_count = strtoul(argv[i] + 12, NULL, 10)) > UINT32_MAX;
+        else if (strncmp(argv[i], "--meshes=", 9) == 0)
+            usage |= (mesh_count = strtoul(argv[i] + 9, NULL, 10)) > SCENE_FILE_MAX_MESHES;
+        else if (strncmp(argv[i], "--seed=", 7) == 0)
+            seed = strtoul(argv[i] + 7, NULL, 10);
+        else if (strncmp(argv[i], "--size=", 7) == 0)
+            usage |= sscanf(argv[i] + 7, "%ux%u", &width, &height) != 2;
+        else if (strncmp(argv[i], "--", 2) == 0)
+            usage = 1;
+        else if (path == NULL)
+            path = argv[i];
+        else
+            textures[texture_count++] = argv[i];
+    }
+
+    if (path == NULL || usage)
+    {
+        fprintf(stderr, "Usage: --make-scene output%s [--instances=N] [--meshes=N] "
+                        "[--size=WIDTHxHEIGHT] [--seed=N] textures...\n"
+                        "At most %u instances & %d meshes\n", SCENE_FILE_EXTENSION, UINT32_MAX, SCENE_FILE_MAX_MESHES);
+        free(textures);
+        return 1;
+    }
+
+    if (texture_count == 0)
+        textures[texture_count++] = "rainbow.png";
+
+    int ok = scene_file_generate(path, instance_count, mesh_count, textures, texture_count,
+                                 width, height, seed);
+    free(textures);
+
+    return ok ? 0 : 1;
+}
+
+/**
+ * Time `iterations` decodes of an encoded image & print the throughput,
+ * in decoded megabytes per second.
+ *
+ * @param const char* path
+ * @param const image_decoder_T* decoder
+ * @param const unsigned char* bytes
+ * @param size_t size
+ * @param int iterations
+ * @param const char* results_path, where to record the throughput, or NULL.
+ * @return int 0 if the image could not be decoded.
+ */
+static int decode_bench_run(const char* path, const image_decoder_T* decoder,
+                            const unsigned char* bytes, size_t size, int iterations,
+                            const char* results_path)
+{
+    image_T image = {};
+    uint64_t begin = profiler_now();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        if (!decoder->decode(&image, bytes, size, image_alloc_heap, NULL))
+        {
+            free(image.pixels);
+            fprintf(stderr, "Could not decode `%s` as %s\n", path, decoder->name);
+            return 0;
+        }
+
+        free(image.pixels);
+    }
+
+    double seconds = (profiler_now() - begin) / 1e9;
+    double decoded = (double) image.width * image.height * 4 * iterations;
+
+    double throughput = decoded / (1024.0 * 1024.0) / seconds;
+
+    printf("%-24s %-5s %10zu %12.3f %10.1f\n", path, decoder->name, size,
+           seconds * 1000.0 / iterations, throughput);
+
+    if (results_path)
+    {
+        char name[BENCH_MAX_NAME];
+        snprintf(name, sizeof(name), "decode/%s/%s", path, decoder->name);
+        return bench_record(results_path, name, "MB/s", throughput);
+    }
+
+    return 1;
+}
+
+/**
+ * Compare the image decoders on a set of files, no window needed.
+ * Every file is decoded by the backend for its format and also
+ * re-encoded as QOI in memory, to see what converting would gain.
+ * Usage: --decode-bench [--iterations=N] [--results=FILE] files...
+ *
+ * @param int argc
+ * @param char* argv[]
+ * @return int
+ */
+static int decode_bench(int argc, char* argv[])
+{
+    int iterations = 10;
+    const char* results_path = NULL;
+    int ok = 1;
+    int files = 0;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--iterations=", 13) == 0)
+            iterations = atoi(argv[i] + 13);
+        else if (strncmp(argv[i], "--results=", 10) == 0)
+            results_path = argv[i] + 10;
+        else
+            files++;
+    }
+
+    if (files == 0 || iterations < 1)
+    {
+        fprintf(stderr, "Usage: --decode-bench [--iterations=N] [--results=FILE] files...\n");
+        return 1;
+    }
+
+    printf("%-24s %-5s %10s %12s %10s\n", "file", "codec", "bytes", "ms/decode", "MB/s");
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--iterations=", 13) == 0 || strncmp(argv[i], "--results=", 10) == 0)
+            continue;
+
+        size_t size = 0;
+        unsigned char* bytes = image_map(argv[i], &size);
+        if (bytes == NULL)
+        {
+            ok = 0;
+            continue;
+        }
+
+        const image_decoder_T* decoder = image_find_decoder(bytes, size);
+        image_T image = {};
+
+        if (decoder == NULL)
+        {
+            fprintf(stderr, "Unknown image format `%s`\n", argv[i]);
+            ok = 0;
+        }
+        else if (!decode_bench_run(argv[i], decoder, bytes, size, iterations, results_path))
+        {
+            ok = 0;
+        }
+        else if (decoder->decode != qoi_decode && decoder->decode(&image, bytes, size, image_alloc_heap, NULL))
+        {
+            size_t qoi_size = 0;
+            unsigned char* qoi = qoi_encode(&image, &qoi_size);
+            const image_decoder_T* qoi_decoder = image_find_decoder(qoi, qoi_size);
+
+            if (qoi && qoi_decoder)
+                ok = decode_bench_run(argv[i], qoi_decoder, qoi, qoi_size, iterations, results_path) && ok;
+
+            free(qoi);
+        }
+
+        free(image.pixels);
+        image_unmap(bytes, size);
+    }
+
+    return ok ? 0 : 1;
+}
+
+/**
+ * Check benchmark results against a baseline, see bench.h.
+ * Usage: --bench-compare [--threshold=PERCENT] baseline.csv results.csv
+ *
+ * @param int argc
+ * @param char* argv[]
+ * @return int 1 if anything regressed.
+ */
+static int bench_compare_files(int argc, char* argv[])
+{
+    double threshold = BENCH_THRESHOLD;
+    const char* paths[2] = { NULL, NULL };
+    int path_count = 0;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--threshold=", 12) == 0)
+            threshold = strtod(argv[i] + 12, NULL);
+        else if (path_count < 2)
+            paths[path_count++] = argv[i];
+        else
+            path_count++;
+    }
+
+    if (path_count != 2 || threshold < 0)
+    {
+        fprintf(stderr, "Usage: --bench-compare [--threshold=PERCENT] baseline.csv results.csv\n");
+        return 1;
+    }
+
+    bench_results_T* baseline = bench_results_read(paths[0]);
+    bench_results_T* results = baseline ? bench_results_read(paths[1]) : NULL;
+
+    int regressions = results ? bench_compare(baseline, results, threshold, stdout) : 1;
+
+    if (results)
+        bench_results_free(results);
+    if (baseline)
+        bench_results_free(baseline);
+
+    return regressions > 0;
+}
+
+/**
+ * Print the counters another instance exports with --metrics-shm.
+ * Usage: --read-metrics NAME
+ *
+ * @param int argc
+ * @param char* argv[]
+ * @return int
+ */
+static int read_metrics(int argc, char* argv[])
+{
+    if (argc != 1)
+    {
+        fprintf(stderr, "Usage: --read-metrics NAME\n");
+        return 1;
+    }
+
+    counters_page_T page;
+    if (!counters_read_shared(argv[0], &page))
+        return 1;
+
+    char text[4096];
+    counters_format(&page, 1, text, sizeof(text));
+    fputs(text, stdout);
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--bake") == 0)
+        return bake(argc - 2, argv + 2);
+
+    if (argc > 1 && strcmp(argv[1], "--decode-bench") == 0)
+        return decode_bench(argc - 2, argv + 2);
+
+    if (argc > 1 && strcmp(argv[1], "--bench-compare") == 0)
+        return bench_compare_files(argc - 2, argv + 2);
+
+    if (argc > 1 && strcmp(argv[1], "--make-scene") == 0)
+        return make_scene(argc - 2, argv + 2);
+
+    if (argc > 1 && strcmp(argv[1], "--read-metrics") == 0)
+        return read_metrics(argc - 2, argv + 2);
 
     /**
-     * Using libpng to read & load a .png file
+     * Block compress textures and / or build mipmaps on the CPU
+     * while loading them
      */
-    png_image image = {};
-    image.version = PNG_IMAGE_VERSION;
+    int compress = 0;
+    mipmap_filter_T mipmap_filter = MIPMAP_FILTER_NONE;
 
-    if (!png_image_begin_read_from_file(&image, path))
-        fprintf(stderr, "Could not read file `%s`: %s\n", path, image.message);
+    /**
+     * Amount of triangles to draw, more than one turns on the
+     * benchmark scene which reports draw calls & frame times.
+     */
+    size_t instance_count = 1;
 
-    image.format = PNG_FORMAT_RGBA;
+    /**
+     * Pack textures into an array texture atlas instead of
+     * loading them as separate textures.
+     */
+    int use_atlas = 0;
 
     /**
-     * image_pixels in this case is the data we are interested in and which
-     * is used for drawing later.
+     * Stream a baked virtual texture through a fixed size page cache
+     * instead, see --bake --virtual.
      */
-    uint32_t *image_pixels = malloc(sizeof(uint32_t) * image.width * image.height);
-    if (image_pixels == NULL)
-        fprintf(stderr, "Could not allocate memory for an image\n");
+    const char* virtual_path = NULL;
+    size_t virtual_budget = 64;
 
     /**
-     * Check for errors
+     * Draw the meshes, textures & instances of a scene file instead
+     * of the triangle grid, see --make-scene.
      */
-    if (!png_image_finish_read(&image, NULL, image_pixels, 0, NULL))
-        fprintf(stderr, "libpng error: %s\n", image.message);
+    const char* scene_path = NULL;
 
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_RGBA,
-                 image.width,
-                 image.height,
-                 0,
-                 GL_RGBA,
-                 GL_UNSIGNED_BYTE,
-                 image_pixels);
+    /**
+     * Time the parts of every frame on the CPU & GPU, print
+     * percentiles at exit and optionally write a trace.
+     */
+    int profile = 0;
+    const char* trace_path = NULL;
 
-    glGenerateMipmap(GL_TEXTURE_2D);
+    /**
+     * Draw calls, upload & cache stats and frame times are counted
+     * every frame. They can be drawn over the frame and exported to
+     * a unix socket and / or a shared memory object for --read-metrics.
+     */
+    const char* metrics_socket = NULL;
+    const char* metrics_shm = NULL;
 
-    return texture;
-}
+    /**
+     * Render a fixed amount of frames into an offscreen framebuffer
+     * as fast as possible and report the throughput.
+     */
+    int bench = 0;
+    size_t bench_frames = 1000;
+    int bench_width = 640;
+    int bench_height = 480;
+
+    /**
+     * Append the benchmark's frame time, shader build time & upload
+     * throughput to a results file, see --bench-compare. With
+     * --state-changes neighbouring triangles switch samplers so
+     * every one of them is a draw call of its own.
+     */
+    const char* results_path = NULL;
+    int state_changes = 0;
+
+    /**
+     * How frames are presented, see frame_pacer.h. By default the
+     * driver decides how many frames may be queued.
+     */
+    frame_pacer_mode_T present_mode = FRAME_PACER_VSYNC;
+    double present_fps = 0;
+    size_t max_queued = 0;
+    int finish = 0;
+
+    /**
+     * Reload textures & shaders when their files change. With
+     * --shaders the stages are read from a directory, the embedded
+     * ones are written there first if it has none.
+     */
+    int watch_files = 0;
+    const char* shader_directory = NULL;
+
+    /**
+     * Megabytes textures, buffers & programs may take before the least
+     * recently used textures are shrunk or evicted, 0 only keeps to
+     * what the driver reports as free.
+     */
+    size_t gpu_budget = 0;
+
+    /**
+     * A text file listing textures to load up front, one path per line,
+     * and the milliseconds a frame may spend uploading them.
+     */
+    const char* manifest_path = NULL;
+    double upload_budget = TEXTURE_LOADER_UPLOAD_BUDGET / 1e6;
+
+    /**
+     * How the scene texture is filtered, see sampler.h.
+     * Virtual textures filter their pages themselves.
+     */
+    sampler_preset_T sampler_preset = SAMPLER_TRILINEAR;
+    float anisotropy = SAMPLER_ANISOTROPY_DEFAULT;
+
+    /**
+     * Frustum cull on the GPU & draw with glMultiDrawArraysIndirect,
+     * needs an OpenGL 4.3 context and falls back to instanced draws.
+     */
+    int gpu_cull = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--compress") == 0)
+            compress = 1;
+        else if (strncmp(argv[i], "--mipmaps=", 10) == 0 && !parse_mipmap_filter(argv[i] + 10, &mipmap_filter))
+            fprintf(stderr, "Unknown mipmap filter `%s`\n", argv[i] + 10);
+        else if (strncmp(argv[i], "--instances=", 12) == 0)
+            instance_count = strtoul(argv[i] + 12, NULL, 10);
+        else if (strcmp(argv[i], "--atlas") == 0)
+            use_atlas = 1;
+        else if (strncmp(argv[i], "--virtual=", 10) == 0)
+            virtual_path = argv[i] + 10;
+        else if (strncmp(argv[i], "--virtual-budget=", 17) == 0)
+            virtual_budget = strtoul(argv[i] + 17, NULL, 10);
+        else if (strncmp(argv[i], "--scene=", 8) == 0)
+            scene_path = argv[i] + 8;
+        else if (strcmp(argv[i], "--profile") == 0)
+            profile = 1;
+        else if (strncmp(argv[i], "--trace=", 8) == 0)
+            trace_path = argv[i] + 8;
+        else if (strcmp(argv[i], "--overlay") == 0)
+            show_overlay = 1;
+        else if (strncmp(argv[i], "--metrics-socket=", 17) == 0)
+            metrics_socket = argv[i] + 17;
+        else if (strncmp(argv[i], "--metrics-shm=", 14) == 0)
+            metrics_shm = argv[i] + 14;
+        else if (strcmp(argv[i], "--bench") == 0)
+            bench = 1;
+        else if (strncmp(argv[i], "--results=", 10) == 0)
+            results_path = argv[i] + 10;
+        else if (strcmp(argv[i], "--state-changes") == 0)
+            state_changes = 1;
+        else if (strncmp(argv[i], "--frames=", 9) == 0)
+        {
+            long frames = strtol(argv[i] + 9, NULL, 10);
+            if (frames < 1)
+            {
+                fprintf(stderr, "Usage: --bench [--frames=N] [--size=WIDTHxHEIGHT] [--results=FILE], "
+                                "N is at least 1\n");
+                return 1;
+            }
+            bench_frames = frames;
+        }
+        else if (strncmp(argv[i], "--size=", 7) == 0 &&
+                 (sscanf(argv[i] + 7, "%dx%d", &bench_width, &bench_height) != 2 ||
+                  bench_width <= 0 || bench_height <= 0))
+        {
+            fprintf(stderr, "Usage: --bench [--frames=N] [--size=WIDTHxHEIGHT] [--results=FILE], "
+                            "got --size=%s\n", argv[i] + 7);
+            return 1;
+        }
+        else if (strncmp(argv[i], "--present=", 10) == 0 && !frame_pacer_parse_mode(argv[i] + 10, &present_mode))
+            fprintf(stderr, "Unknown present mode `%s`\n", argv[i] + 10);
+        else if (strncmp(argv[i], "--fps=", 6) == 0)
+            present_fps = strtod(argv[i] + 6, NULL);
+        else if (strncmp(argv[i], "--max-queued=", 13) == 0)
+            max_queued = strtoul(argv[i] + 13, NULL, 10);
+        else if (strcmp(argv[i], "--finish") == 0)
+            finish = 1;
+        else if (strcmp(argv[i], "--watch") == 0)
+            watch_files = 1;
+        else if (strncmp(argv[i], "--shaders=", 10) == 0)
+            shader_directory = argv[i] + 10;
+        else if (strncmp(argv[i], "--gpu-budget=", 13) == 0)
+            gpu_budget = strtoul(argv[i] + 13, NULL, 10);
+        else if (strncmp(argv[i], "--manifest=", 11) == 0)
+            manifest_path = argv[i] + 11;
+        else if (strncmp(argv[i], "--upload-budget=", 16) == 0)
+            upload_budget = strtod(argv[i] + 16, NULL);
+        else if (strcmp(argv[i], "--gpu-cull") == 0)
+            gpu_cull = 1;
+        else if (strncmp(argv[i], "--filter=", 9) == 0 &&
+                 !sampler_parse_preset(argv[i] + 9, &sampler_preset, &anisotropy))
+            fprintf(stderr, "Unknown filter `%s`\n", argv[i] + 9);
+    }
+
+    /**
+     * A frame rate on its own means a frame cap
+     */
+    if (present_fps > 0 && present_mode == FRAME_PACER_VSYNC)
+        present_mode = FRAME_PACER_CAPPED;
+
+    /**
+     * The scene is only mapped here, its vertices are uploaded once
+     * there is a context
+     */
+    scene_file_T* scene_file = NULL;
+    int window_width = 640;
+    int window_height = 480;
+
+    if (scene_path)
+    {
+        if (!(scene_file = scene_file_open(scene_path)))
+            return 1;
+
+        instance_count = scene_file->header->instance_count;
+
+        if (scene_file->header->width > 0 && scene_file->header->height > 0)
+        {
+            window_width = scene_file->header->width;
+            window_height = scene_file->header->height;
+        }
+
+        if (use_atlas || virtual_path)
+            fprintf(stderr, "A scene brings its own textures, ignoring --atlas & --virtual\n");
+
+        use_atlas = 0;
+        virtual_path = NULL;
+    }
+
+    if (instance_count == 0)
+        instance_count = 1;
 
-int main(int argc, char* argv[])
-{
     glfwSetErrorCallback(error_callback);
 
     /**
@@ -124,18 +1000,33 @@ int main(int argc, char* argv[])
 
     /**
      * Setting some parameters to the window,
-     * using OpenGL 3.3
+     * using OpenGL 3.3, or 4.3 for GPU culling
      */
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, gpu_cull ? 4 : 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_FLOATING, GL_TRUE);
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 
+    if (bench)
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
     /**
      * Creating our window
      */
-    GLFWwindow* window = glfwCreateWindow(640, 480, "My Title", NULL, NULL);
+    GLFWwindow* window = bench ?
+        glfwCreateWindow(bench_width, bench_height, "My Title", NULL, NULL) :
+        glfwCreateWindow(window_width, window_height, "My Title", NULL, NULL);
+
+    if (!window && gpu_cull)
+    {
+        fprintf(stderr, "No OpenGL 4.3 context, drawing instanced instead\n");
+        gpu_cull = 0;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        window = bench ?
+            glfwCreateWindow(bench_width, bench_height, "My Title", NULL, NULL) :
+            glfwCreateWindow(window_width, window_height, "My Title", NULL, NULL);
+    }
     if (!window)
         perror("Failed to create window.\n");
 
@@ -154,31 +1045,57 @@ int main(int argc, char* argv[])
         fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
 
     fprintf(stdout, "Status: Using GLEW %s\n", glewGetString(GLEW_VERSION));
+
+    /**
+     * The benchmark never waits for vsync and draws offscreen,
+     * a hidden window's default framebuffer may not be backed at all.
+     */
+    framebuffer_T* framebuffer = NULL;
+    frame_pacer_T* pacer = bench ?
+        init_frame_pacer(FRAME_PACER_UNCAPPED, 0, max_queued, finish) :
+        init_frame_pacer(present_mode, present_fps, max_queued, finish);
+
+    frame_pacer_apply(pacer);
+
+    if (bench)
+    {
+        framebuffer = init_framebuffer(bench_width, bench_height);
+        if (!framebuffer)
+            return 1;
+    }
     
     unsigned int VAO;
     glGenVertexArrays(1, &VAO);
 
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
+    GLuint vertex_buffer, program;
+    GLint model_location, uv_rect_location, layer_location;
 
-    GLuint vertex_buffer, vertex_shader, fragment_shader, program;
-    GLint mvp_location, vpos_location, vcol_location, texcoord_location;
+    /**
+     * Shared by both shaders, the defines switch between sampling
+     * a plain texture or a layer of the atlas.
+     */
+    static const char* shader_header = "#version 330 core\n";
+    const char* shader_defines = virtual_path ? "#define VIRTUAL\n" : use_atlas ? "#define ATLAS\n" : "";
 
     /**
      * Vertex Shader
      */
     static const char* vertex_shader_text =
-        "#version 330 core\n"
-        "uniform mat4 MVP;\n"
+        "layout(std140) uniform Frame { mat4 VP; vec2 Viewport; vec2 Cursor; float Time; };\n"
         "attribute vec3 vCol;\n"
         "attribute vec2 vPos;\n"
         "attribute vec2 aTexCoord;\n"
+        "in mat4 iModel;\n"
+        "in vec4 iUVRect;\n"
+        "in float iLayer;\n"
         "varying vec3 color;\n"
         "out vec2 TexCoord;\n"
+        "flat out float Layer;\n"
         "void main()\n"
         "{\n"
-        "    gl_Position = MVP * vec4(vPos, 0.0, 1.0);\n"
-        "    TexCoord = aTexCoord;"
+        "    gl_Position = VP * iModel * vec4(vPos, 0.0, 1.0);\n"
+        "    TexCoord = iUVRect.xy + aTexCoord * iUVRect.zw;"
+        "    Layer = iLayer;\n"
         "    color = vCol;\n"
         "}\n";
     
@@ -186,101 +1103,374 @@ int main(int argc, char* argv[])
      * Fragment Shader
      */    
     static const char* fragment_shader_text =
-        "#version 330 core\n"
         "varying vec3 color;\n"
         "in vec2 TexCoord;\n"
+        "flat in float Layer;\n"
+        "#ifdef VIRTUAL\n"
+        "layout(location = 0) out vec4 FragColor;\n"
+        "layout(location = 1) out uvec4 Feedback;\n"
+        "uniform sampler2D ourTexture;\n"
+        "#elif defined(ATLAS)\n"
+        "uniform sampler2DArray ourTexture;\n"
+        "#else\n"
         "uniform sampler2D ourTexture;\n"
+        "#endif\n"
         "void main()\n"
         "{\n"
+        "#ifdef VIRTUAL\n"
+        "    FragColor = virtual_texture(ourTexture, TexCoord, Feedback);\n"
+        "#elif defined(ATLAS)\n"
+        "    gl_FragColor = texture(ourTexture, vec3(TexCoord, Layer));\n"
+        "#else\n"
         "    gl_FragColor = texture(ourTexture, TexCoord);\n"
+        "#endif\n"
         "}\n"; 
 
-    int success;
-    char infoLog[512];
- 
     /**
-     * Compile vertex shader and check for errors
+     * Start compiling, or reuse the binary from a previous launch.
+     * The driver may build it on its own threads while textures load.
      */
-    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_text, NULL);
-    glCompileShader(vertex_shader);
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-    if(!success)
+    shader_cache_T* shader_cache = init_shader_cache(".shader_cache");
+    shader_manager_T* shader_manager = init_shader_manager(shader_cache);
+    const char* vertex_sources[] = { shader_header, shader_defines, vertex_shader_text };
+    const char* fragment_sources[] = {
+        shader_header, shader_defines, virtual_path ? virtual_texture_glsl() : "", fragment_shader_text
+    };
+    shader_files_T shader_files = {};
+    shader_files.manager = shader_manager;
+
+    if (shader_directory)
     {
-        printf("Vertex Shader Error\n");
-        glGetShaderInfoLog(vertex_shader, 512, NULL, infoLog);
-        perror(infoLog);
+        size_t length = strlen(shader_directory) + 16;
+        shader_files.vertex_path = malloc(length);
+        shader_files.fragment_path = malloc(length);
+        snprintf(shader_files.vertex_path, length, "%s/scene.vert", shader_directory);
+        snprintf(shader_files.fragment_path, length, "%s/scene.frag", shader_directory);
+        memcpy(shader_files.vertex_sources, vertex_sources, sizeof(vertex_sources));
+        memcpy(shader_files.fragment_sources, fragment_sources, sizeof(fragment_sources));
+
+        if (load_shader_files(&shader_files, vertex_shader_text, fragment_shader_text))
+        {
+            vertex_sources[2] = shader_files.vertex_text;
+            fragment_sources[3] = shader_files.fragment_text;
+        }
     }
 
+    uint64_t shader_begin = profiler_now();
+    uint64_t shader_time = 0;
+    shader_program_T* shader = shader_manager_add(shader_manager, "scene", vertex_sources, 3,
+                                                  fragment_sources, 4);
+    shader_files.program = shader;
+
     /**
-     * Compile fragment shader and check for errors
-     */ 
-    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_text, NULL);
-    glCompileShader(fragment_shader);
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-    if(!success)
+     * Benchmark results time the build on its own, instead of
+     * overlapping it with loading textures
+     */
+    if (results_path)
     {
-        printf("Fragment Shader Error\n");
-        glGetShaderInfoLog(fragment_shader, 512, NULL, infoLog);
-        perror(infoLog);
+        shader_manager_finish(shader_manager);
+        shader_time = profiler_now() - shader_begin;
     }
 
     /**
-     * Create shader program and check for errors
-     */ 
-    program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if(!success)
+     * Start the texture decode workers
+     */
+    texture_loader = init_texture_loader(0);
+
+    texture_loader_set_mipmap_filter(texture_loader, mipmap_filter);
+    texture_loader_set_upload_budget(texture_loader, upload_budget > 0 ? upload_budget * 1e6 : 0);
+
+    if (compress && !texture_loader_set_compression(texture_loader, 1))
+        fprintf(stderr, "Texture compression is not supported by this driver\n");
+
+    gpu_memory_T* gpu_memory = init_gpu_memory(gpu_budget * 1024 * 1024);
+    texture_cache = init_texture_cache(texture_loader, gpu_memory);
+
+    texture_batch_T* manifest = NULL;
+    uint64_t manifest_begin = profiler_now();
+    size_t manifest_loaded = 0;
+
+    if (manifest_path && !(manifest = load_manifest(manifest_path)))
+        return 1;
+
+    texture_T** scene_textures = NULL;
+
+    if (scene_file)
     {
-        glGetProgramInfoLog(program, 512, NULL, infoLog);
-        perror(infoLog);
+        scene_textures = malloc(scene_file->header->texture_count * sizeof(texture_T*));
+        if (scene_textures == NULL)
+        {
+            fprintf(stderr, "Not enough memory for the textures of `%s`\n", scene_path);
+            return 1;
+        }
+
+        for (uint32_t i = 0; i < scene_file->header->texture_count; i++)
+            scene_textures[i] = get_texture(scene_file_texture_path(scene_file, i));
     }
 
     /**
-     * Grab locations from shader
+     * Create and bind texture, either on its own or as a sprite
+     * of the atlas. With a scene it is the scene's first texture,
+     * which scene_textures already holds.
+     */
+    texture_T* texture = NULL;
+    atlas_T* atlas = NULL;
+    virtual_texture_T* virtual_texture = NULL;
+    atlas_sprite_T sprite = { { 0, 0, 1, 1 }, 0 };
+
+    if (virtual_path)
+    {
+        virtual_texture = init_virtual_texture(virtual_path, virtual_budget * 1024 * 1024);
+        if (!virtual_texture)
+            return 1;
+
+        virtual_texture_uv_rect(virtual_texture, sprite.uv_rect);
+    }
+    else if (use_atlas)
+    {
+        atlas = init_atlas(1024, 4, 4, 4);
+        atlas_add_png(atlas, "rainbow.png", &sprite);
+        atlas_commit(atlas);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->texture);
+    }
+    else
+    {
+        texture = scene_file ? scene_textures[0] : get_texture("rainbow.png");
+        glBindTexture(GL_TEXTURE_2D, texture->id);
+    }
+
+    /**
+     * The atlas clamps like its own parameters, plain textures repeat
+     */
+    sampler = init_sampler(atlas ? GL_CLAMP_TO_EDGE : GL_REPEAT, sampler_preset, anisotropy);
+
+    /**
+     * Everything below needs the linked program
+     */
+    shader_manager_finish(shader_manager);
+    program = shader->program;
+    size_t shader_generation = shader->generation;
+
+    /**
+     * The atlas & virtual textures are built once, only plain
+     * textures are reloaded
+     */
+    file_watch_T* watch = watch_files ? init_file_watch() : NULL;
+
+    if (watch && texture && !scene_file)
+        file_watch_add(watch, "rainbow.png", reload_texture, NULL);
+
+    for (uint32_t i = 0; watch && scene_file && i < scene_file->header->texture_count; i++)
+        file_watch_add(watch, scene_file_texture_path(scene_file, i), reload_texture, NULL);
+
+    if (watch && shader_files.vertex_text)
+    {
+        file_watch_add(watch, shader_files.vertex_path, reload_shader, &shader_files);
+        file_watch_add(watch, shader_files.fragment_path, reload_shader, &shader_files);
+    }
+
+    /**
+     * Grab locations from shader, the view projection comes from
+     * the per frame uniform block shared by all programs
      */ 
-    mvp_location = glGetUniformLocation(program, "MVP");
-    vpos_location = glGetAttribLocation(program, "vPos");
-    vcol_location = glGetAttribLocation(program, "vCol");
-    texcoord_location = glGetAttribLocation(program, "aTexCoord");
+    frame_uniforms_T* frame_uniforms = init_frame_uniforms();
+    frame_uniforms_bind_program(program);
+    if (virtual_texture)
+        virtual_texture_bind_program(virtual_texture, program, 1);
+    model_location = glGetAttribLocation(program, "iModel");
+    uv_rect_location = glGetAttribLocation(program, "iUVRect");
+    layer_location = glGetAttribLocation(program, "iLayer");
 
     glBindVertexArray(VAO);
     
+    /**
+     * Pack positions, colors & texture coordinates into one
+     * interleaved vertex each
+     */
+    packed_vertex_T packed_vertices[3];
+    for (int i = 0; i < 3; i++)
+        vertex_pack(&packed_vertices[i], &vertices[i].x, &texCoords[i * 2], &vertices[i].r);
+
     /**
      * Buffer / send our vertices
      */
     glGenBuffers(1, &vertex_buffer);
     glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(packed_vertices), packed_vertices, GL_STATIC_DRAW);
  
     /**
      * Tell OpenGL where the data is stored in the buffer
      */
-    glEnableVertexAttribArray(vpos_location);
-    glVertexAttribPointer(vpos_location, 2, GL_FLOAT, GL_FALSE,
-                          sizeof(vertices[0]), (void*) 0);
-    glEnableVertexAttribArray(vcol_location);
-    glVertexAttribPointer(vcol_location, 3, GL_FLOAT, GL_FALSE,
-                          sizeof(vertices[0]), (void*) (sizeof(float) * 2));
+    vertex_layout_apply(&packed_vertex_layout, program, 0);
 
     /**
-     * Create and bind texture
+     * A scene's vertices are uploaded straight from the mapping, every
+     * mesh gets a VAO pointing at its part of the one buffer
      */
-    unsigned int texture = get_texture("rainbow.png");
-    glBindTexture(GL_TEXTURE_2D, texture);
+    GLuint scene_buffer = 0;
+    GLuint* scene_vaos = NULL;
+
+    if (scene_file)
+    {
+        const scene_file_header_T* header = scene_file->header;
+
+        glGenBuffers(1, &scene_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, scene_buffer);
+        glBufferData(GL_ARRAY_BUFFER, header->vertex_count * sizeof(packed_vertex_T),
+                     scene_file->vertices, GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        scene_vaos = malloc(header->mesh_count * sizeof(GLuint));
+        if (scene_vaos == NULL)
+        {
+            fprintf(stderr, "Not enough memory for the meshes of `%s`\n", scene_path);
+            return 1;
+        }
+
+        glGenVertexArrays(header->mesh_count, scene_vaos);
+
+        for (uint32_t i = 0; i < header->mesh_count; i++)
+        {
+            glBindVertexArray(scene_vaos[i]);
+            vertex_layout_apply(&packed_vertex_layout, program,
+                                scene_file->meshes[i].first_vertex * sizeof(packed_vertex_T));
+        }
+
+        glBindVertexArray(VAO);
+    }
 
     /**
-     * Buffer / send our texture coordinates
+     * Every triangle is an instance, the ones sharing state are
+     * drawn with a single call
      */
-    glBufferData(GL_ARRAY_BUFFER, sizeof(texCoords), texCoords, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(texcoord_location);
-    glVertexAttribPointer(texcoord_location, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*) 0);
+    render_state_T* render_state = init_render_state();
+    batch_renderer_T* batch = init_batch_renderer(VAO, model_location, uv_rect_location,
+                                                  layer_location, instance_count, render_state);
+
+    /**
+     * Draws are sorted to minimize state changes & merged into
+     * instanced calls before they reach the batch renderer
+     */
+    render_queue_T* render_queue = init_render_queue(batch, render_state);
+
+    for (uint32_t i = 0; scene_file && i < scene_file->header->mesh_count; i++)
+        batch_renderer_attach(batch, scene_vaos[i]);
+
+    /**
+     * Counters are updated by index every frame, the overlay is left
+     * out of benchmarks so it does not change what they measure
+     */
+    counters_T* counters = init_counters();
+    size_t frames_counter = counters_register(counters, "frames", COUNTER_TOTAL);
+    size_t draw_calls_counter = counters_register(counters, "draw_calls", COUNTER_GAUGE);
+    size_t skipped_counter = counters_register(counters, "state_calls_skipped", COUNTER_TOTAL);
+    size_t uploaded_counter = counters_register(counters, "bytes_uploaded", COUNTER_TOTAL);
+    size_t hit_rate_counter = counters_register(counters, "texture_cache_hit_percent", COUNTER_GAUGE);
+    size_t decode_queue_counter = counters_register(counters, "decode_queue", COUNTER_GAUGE);
+    size_t gpu_memory_counter = counters_register(counters, "gpu_memory_bytes", COUNTER_GAUGE);
+    size_t stalls_counter = counters_register(counters, "stream_stalls", COUNTER_TOTAL);
+    size_t skipped_seen = 0;
+    uint64_t last_frame = 0;
+
+    if (metrics_socket)
+        counters_listen(counters, metrics_socket);
+    if (metrics_shm)
+        counters_export_shared(counters, metrics_shm);
+
+    overlay_T* overlay = bench ? NULL : init_overlay(shader_manager, render_state);
+
+    /**
+     * The culling spheres enclose the triangle around its origin
+     */
+    gpu_cull_T* cull = NULL;
+
+    if (gpu_cull)
+    {
+        float radius = 0.0f;
+        for (int i = 0; i < 3; i++)
+            radius = fmaxf(radius, hypotf(vertices[i].x, vertices[i].y));
+
+        if (scene_file)
+            radius = scene_file_radius(scene_file);
+
+        cull = init_gpu_cull(instance_count, radius);
+        render_queue_set_cull(render_queue, cull);
+    }
+
+    /**
+     * Count everything allocated up front against the memory budget,
+     * textures from the cache count themselves
+     */
+    size_t program_bytes = gpu_memory_program_size(program);
+    gpu_memory_add(gpu_memory, GPU_MEMORY_PROGRAM, program_bytes);
+    gpu_memory_add(gpu_memory, GPU_MEMORY_BUFFER, sizeof(packed_vertices));
+    gpu_memory_add(gpu_memory, GPU_MEMORY_BUFFER, gpu_memory_buffer_size(batch->stream->buffer));
+    gpu_memory_add(gpu_memory, GPU_MEMORY_BUFFER, gpu_memory_buffer_size(frame_uniforms->stream->buffer));
+
+    if (cull)
+        gpu_memory_add(gpu_memory, GPU_MEMORY_BUFFER, gpu_memory_buffer_size(cull->visible));
+
+    if (scene_buffer)
+        gpu_memory_add(gpu_memory, GPU_MEMORY_BUFFER, gpu_memory_buffer_size(scene_buffer));
+
+    if (framebuffer)
+        gpu_memory_add(gpu_memory, GPU_MEMORY_TEXTURE, gpu_memory_texture_size(GL_TEXTURE_2D, framebuffer->color));
+
+    if (atlas)
+        gpu_memory_add(gpu_memory, GPU_MEMORY_TEXTURE, gpu_memory_texture_size(GL_TEXTURE_2D_ARRAY, atlas->texture));
+
+    if (virtual_texture)
+    {
+        gpu_memory_add(gpu_memory, GPU_MEMORY_TEXTURE, gpu_memory_texture_size(GL_TEXTURE_2D, virtual_texture->cache));
+        gpu_memory_add(gpu_memory, GPU_MEMORY_TEXTURE, gpu_memory_texture_size(GL_TEXTURE_2D, virtual_texture->page_table));
+    }
+
+    render_state_invalidate_textures(render_state);
+
+    /**
+     * Triangles are laid out on a square grid, unless the scene
+     * places them
+     */
+    size_t columns = ceil(sqrt((double) instance_count));
+    float cell = 2.0f / columns;
+
+    transform_soa_T* transforms = init_transform_soa(instance_count);
+    if (transforms == NULL)
+    {
+        fprintf(stderr, "Not enough memory for %zu instances\n", instance_count);
+        return 1;
+    }
+
+    if (scene_file)
+        scene_file_load_transforms(scene_file, transforms);
+
+    for (size_t i = 0; i < instance_count && !scene_file; i++)
+    {
+        transforms->x[i] = -1.0f + cell * (i % columns + 0.5f);
+        transforms->scale_x[i] = cell * 0.5f;
+        transforms->scale_y[i] = cell * 0.5f;
+    }
+
+    /**
+     * Scene updates run on worker threads, the GL thread only
+     * submits what they recorded
+     */
+    job_system_T* jobs = init_job_system(0);
+    size_t main_worker = job_system_main_worker(jobs);
+    render_packet_T** packets = calloc(jobs->slot_count, sizeof(render_packet_T*));
+    static const size_t scene_job_size = 1024;
+
+    profiler_T* profiler = profile || trace_path ? init_profiler(0) : NULL;
+
+    double stats_time = glfwGetTime();
+    size_t stats_frames = 0;
+
+    /**
+     * The first frames pay for shader & texture warm up,
+     * they are not part of the benchmark.
+     */
+    static const size_t bench_warmup = 16;
+    size_t frame = 0;
+    double bench_start = 0;
 
     /**
      * Main loop
@@ -288,28 +1478,367 @@ int main(int argc, char* argv[])
     while (!glfwWindowShouldClose(window))
     {
         int width, height;
-        mat4 p, mvp;
-        double t = glfwGetTime();
+        frame_uniforms_block_T frame_block = {};
+        render_draw_T draw = {
+            program, VAO,
+            atlas ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D,
+            atlas ? atlas->texture : virtual_texture ? virtual_texture->cache : texture->id,
+            3,
+            virtual_texture ? 0 : sampler_current(sampler)
+        };
+
+        /**
+         * Fixed time steps keep benchmark runs identical
+         */
+        double t = bench ? frame / 60.0 : glfwGetTime();
+        size_t scope = 0;
+
+        uint64_t now = profiler_now();
+        if (last_frame)
+            counters_frame_time(counters, now - last_frame);
+        last_frame = now;
+
+        /**
+         * Sleep off the frame cap & let the GPU catch up before doing
+         * any work, so the input sampled below is as fresh as possible
+         */
+        frame_pacer_wait(pacer);
+
+        /**
+         * Files changed since the last frame start decoding or
+         * compiling now & are swapped in by the updates below
+         */
+        if (watch)
+            file_watch_poll(watch);
+
+        if (profiler)
+        {
+            profiler_begin_frame(profiler);
+            scope = profiler_begin(profiler, "clear");
+        }
+
+        if (framebuffer)
+        {
+            render_state_bind_framebuffer(render_state, framebuffer->fbo);
+            width = framebuffer->width;
+            height = framebuffer->height;
+        }
+        else
+        {
+            glfwGetFramebufferSize(window, &width, &height);
+        }
+
+        render_state_viewport(render_state, 0, 0, width, height);
 
-        glfwGetFramebufferSize(window, &width, &height);
-        glViewport(0, 0, width, height);
-        glClear(GL_COLOR_BUFFER_BIT);
-        
-        mat4 m = GLM_MAT4_IDENTITY_INIT; 
+        /**
+         * A virtual texture draws into its own framebuffer which
+         * also collects the pages each pixel wants
+         */
+        if (virtual_texture)
+            virtual_texture_begin_frame(virtual_texture, render_state, width, height);
+        else
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        glm_translate(m, (vec3){ 0, cos(t), 0 });
-        
-        glm_ortho_default(width / (float) height, p);
-        glm_mat4_mul(p, m, mvp);
+        if (profiler)
+        {
+            profiler_end(profiler, scope);
+            scope = profiler_begin(profiler, "draw");
+        }
 
-        glUseProgram(program);
-        glUniformMatrix4fv(mvp_location, 1, GL_FALSE, (const GLfloat*) mvp);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+        /**
+         * Upload any textures that finished decoding, keep to the memory
+         * budget & check on programs that are still compiling
+         */
+        if (texture && !scene_file)
+            texture_cache_touch(texture_cache, texture);
 
-        glfwSwapBuffers(window);
+        for (uint32_t i = 0; scene_file && i < scene_file->header->texture_count; i++)
+            texture_cache_touch(texture_cache, scene_textures[i]);
+
+        gpu_memory_update(gpu_memory);
+
+        if (texture_cache_update(texture_cache))
+            render_state_invalidate_textures(render_state);
+
+        if (manifest && manifest_loaded < manifest->count)
+        {
+            int done = texture_batch_update(manifest);
+
+            if (manifest->loaded != manifest_loaded)
+                printf("\rLoading textures: %zu / %zu", manifest->loaded, manifest->count);
+
+            if (done)
+                printf("\nLoaded %zu textures, %.1f MB in %.1f ms\n", manifest->count,
+                       manifest->bytes / (1024.0 * 1024.0), (profiler_now() - manifest_begin) / 1e6);
+
+            manifest_loaded = manifest->loaded;
+            fflush(stdout);
+        }
+
+        if (virtual_texture)
+        {
+            if (virtual_texture_update(virtual_texture))
+                render_state_invalidate_textures(render_state);
+
+            render_state_bind_texture(render_state, 1, GL_TEXTURE_2D, virtual_texture->page_table);
+        }
+
+        shader_manager_update(shader_manager);
+
+        /**
+         * A reloaded program needs its uniforms bound again, binding
+         * them uses it behind the render state's back
+         */
+        if (shader->generation != shader_generation)
+        {
+            shader_generation = shader->generation;
+            program = shader->program;
+            frame_uniforms_bind_program(program);
+            if (virtual_texture)
+                virtual_texture_bind_program(virtual_texture, program, 1);
+            render_state_invalidate(render_state);
+            draw.program = program;
+
+            gpu_memory_remove(gpu_memory, GPU_MEMORY_PROGRAM, program_bytes);
+            program_bytes = gpu_memory_program_size(program);
+            gpu_memory_add(gpu_memory, GPU_MEMORY_PROGRAM, program_bytes);
+        }
+
+        scene_update_T scene = {
+            t, columns, cell, transforms,
+            render_queue_key(0, draw.program, draw.texture, draw.vao, 0.0f),
+            draw, state_changes && !virtual_texture ?
+                sampler->samplers[(sampler->preset + 1) % SAMPLER_PRESET_COUNT] : 0,
+            sprite, packets, scene_file, scene_vaos, scene_textures
+        };
+        job_counter_T counter = 0;
+
+        for (size_t first = 0; first < instance_count; first += scene_job_size)
+        {
+            scene_job_T* job = arena_alloc(job_system_arena(jobs, main_worker),
+                                           sizeof(scene_job_T), _Alignof(scene_job_T));
+            job->scene = &scene;
+            job->first = first;
+            job->count = instance_count - first < scene_job_size ? instance_count - first : scene_job_size;
+            job_system_submit(jobs, main_worker, update_instances, job, &counter);
+        }
+
+        job_system_wait(jobs, main_worker, &counter);
+
+        for (size_t w = 0; w < jobs->slot_count; w++)
+        {
+            for (render_packet_T* packet = packets[w]; packet; packet = packet->next)
+                render_queue_append(render_queue, packet);
+            packets[w] = NULL;
+        }
+
+        job_system_reset_arenas(jobs);
+
+        /**
+         * Latch input as late as possible, right before the per frame
+         * block that the draws read it from is uploaded
+         */
+        double cursor_x, cursor_y;
         glfwPollEvents();
+        glfwGetCursorPos(window, &cursor_x, &cursor_y);
+
+        if (profiler)
+            profiler_mark_input(profiler);
+
+        glm_ortho_default(width / (float) height, frame_block.view_projection);
+        frame_block.viewport[0] = width;
+        frame_block.viewport[1] = height;
+        frame_block.cursor[0] = cursor_x;
+        frame_block.cursor[1] = cursor_y;
+        frame_block.time = t;
+        frame_uniforms_begin(frame_uniforms, &frame_block);
+
+        render_queue_flush(render_queue);
+
+        if (virtual_texture)
+            virtual_texture_end_frame(virtual_texture, render_state, framebuffer ? framebuffer->fbo : 0);
+
+        size_t lookups = texture_cache->hits + texture_cache->misses;
+        counters_add(counters, frames_counter, 1);
+        counters_set(counters, draw_calls_counter, batch->draw_calls);
+        counters_add(counters, skipped_counter, render_state->skipped - skipped_seen);
+        counters_set(counters, uploaded_counter, texture_loader->uploaded_bytes);
+        counters_set(counters, hit_rate_counter, lookups ? texture_cache->hits * 100 / lookups : 0);
+        counters_set(counters, decode_queue_counter, texture_loader_pending(texture_loader));
+        counters_set(counters, gpu_memory_counter, gpu_memory_used(gpu_memory));
+        counters_set(counters, stalls_counter, batch->stream->stalls);
+        skipped_seen = render_state->skipped;
+
+        /**
+         * Drawn last so it ends up on top, still reading this
+         * frame's uniform block
+         */
+        if (overlay && show_overlay)
+        {
+            char text[2048];
+            counters_format(&counters->page, 0, text, sizeof(text));
+            overlay_draw(overlay, render_state, text, width, height);
+        }
+
+        frame_uniforms_end(frame_uniforms);
+        counters_publish(counters);
+
+        if (profiler)
+        {
+            profiler_end(profiler, scope);
+            scope = profiler_begin(profiler, "swap");
+        }
+
+        if (!framebuffer)
+            glfwSwapBuffers(window);
+
+        frame_pacer_end_frame(pacer);
+
+        if (profiler)
+        {
+            profiler_end(profiler, scope);
+            profiler_end_frame(profiler);
+        }
+
+        frame++;
+        if (bench)
+        {
+            if (frame == bench_warmup)
+            {
+                glFinish();
+                bench_start = glfwGetTime();
+            }
+
+            if (frame == bench_warmup + bench_frames)
+                break;
+        }
+
+        /**
+         * Benchmark scene, report once per second
+         */
+        stats_frames++;
+        if (instance_count > 1 && !bench && glfwGetTime() - stats_time >= 1.0)
+        {
+            double elapsed = glfwGetTime() - stats_time;
+            printf("%zu instances, %zu draw calls/frame, %.3f ms/frame, %zu stream stalls, "
+                   "%zu state calls skipped/frame\n",
+                   instance_count, batch->draw_calls, elapsed * 1000.0 / stats_frames,
+                   batch->stream->stalls, render_state->skipped / stats_frames);
+            render_state_reset_counters(render_state);
+            skipped_seen = 0;
+            stats_time = glfwGetTime();
+            stats_frames = 0;
+        }
+    }
+
+    if (bench && frame == bench_warmup + bench_frames)
+    {
+        glFinish();
+        double elapsed = glfwGetTime() - bench_start;
+        printf("bench: %zu frames, %dx%d, %zu instances, %.1f frames/sec, %.1f us/frame\n",
+               bench_frames, bench_width, bench_height, instance_count,
+               bench_frames / elapsed, elapsed * 1e6 / bench_frames);
+
+        if (results_path)
+        {
+            /**
+             * Every result is named after the run it came from, so runs
+             * of a suite never overwrite each other's
+             */
+            char scenario[BENCH_MAX_NAME - 16];
+            char name[BENCH_MAX_NAME];
+            snprintf(scenario, sizeof(scenario), "%dx%d/%zu%s%s%s%s%s%s", bench_width, bench_height, instance_count,
+                     atlas ? "/atlas" : "", virtual_texture ? "/virtual" : "", scene_file ? "/scene" : "",
+                     cull ? "/gpu-cull" : "", state_changes ? "/state-changes" : "", manifest ? "/manifest" : "");
+
+            snprintf(name, sizeof(name), "frame/%s", scenario);
+            bench_record(results_path, name, "us", elapsed * 1e6 / bench_frames);
+
+            snprintf(name, sizeof(name), "shader/%s/%s", shader_cache->hits ? "cached" : "compile", scenario);
+            bench_record(results_path, name, "ms", shader_time / 1e6);
+
+            double upload_throughput = texture_loader_upload_throughput(texture_loader);
+            if (upload_throughput > 0)
+            {
+                snprintf(name, sizeof(name), "upload/%s", scenario);
+                bench_record(results_path, name, "MB/s", upload_throughput);
+            }
+        }
+    }
+
+    if (framebuffer)
+        framebuffer_free(framebuffer);
+
+    if (pacer->missed)
+        printf("%zu frames missed the frame cap\n", pacer->missed);
+    frame_pacer_free(pacer);
+
+    if (profiler)
+    {
+        profiler_print_stats(profiler, stdout);
+        if (trace_path)
+            profiler_write_trace(profiler, trace_path);
+        profiler_free(profiler);
     }
+
+    if (overlay)
+        overlay_free(overlay);
+    counters_free(counters);
+
+    job_system_free(jobs);
+    transform_soa_free(transforms);
+    free(packets);
+    render_queue_free(render_queue);
+    if (cull)
+        gpu_cull_free(cull);
+    batch_renderer_free(batch);
+    render_state_free(render_state);
+    frame_uniforms_free(frame_uniforms);
    
+    if (texture && !scene_file)
+        texture_cache_release(texture_cache, texture);
+
+    if (scene_file)
+    {
+        for (uint32_t i = 0; i < scene_file->header->texture_count; i++)
+            texture_cache_release(texture_cache, scene_textures[i]);
+
+        glDeleteVertexArrays(scene_file->header->mesh_count, scene_vaos);
+        glDeleteBuffers(1, &scene_buffer);
+        free(scene_vaos);
+        free(scene_textures);
+        scene_file_close(scene_file);
+    }
+    sampler_free(sampler);
+    if (manifest)
+        texture_batch_free(texture_cache, manifest);
+    if (atlas)
+        atlas_free(atlas);
+
+    if (virtual_texture)
+    {
+        printf("Virtual texture: %zu pages resident, %zu uploaded, %zu evicted, %zu thrashing\n",
+               virtual_texture_resident(virtual_texture), virtual_texture->uploads,
+               virtual_texture->evictions, virtual_texture->thrashing);
+        virtual_texture_free(virtual_texture);
+    }
+
+    texture_cache_print_stats(texture_cache, stdout);
+    gpu_memory_print_stats(gpu_memory, stdout);
+    texture_cache_free(texture_cache);
+    gpu_memory_free(gpu_memory);
+    shader_manager_free(shader_manager);
+
+    if (watch)
+        file_watch_free(watch);
+
+    free(shader_files.vertex_path);
+    free(shader_files.fragment_path);
+    free(shader_files.vertex_text);
+    free(shader_files.fragment_text);
+    shader_cache_free(shader_cache);
+    texture_loader_free(texture_loader);
+
     glfwDestroyWindow(window); 
     glfwTerminate();
     return 0;
@@ -0,0 +1,347 @@
+#include "include/mipmap.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * Source pixels on each side of a Kaiser filtered output pixel.
+ */
+#define KAISER_RADIUS 4
+#define KAISER_TAPS (KAISER_RADIUS * 2)
+#define KAISER_BETA 4.0f
+
+/**
+ * Resolution of the linear to sRGB table.
+ */
+#define SRGB_TABLE_SIZE 4096
+
+
+/**
+ * One RGBA pixel in linear floating point, four lanes wide when
+ * SIMD is available.
+ */
+#if defined(__SSE2__)
+typedef __m128 pixel_T;
+#define pixel_load(p) _mm_loadu_ps(p)
+#define pixel_store(p, v) _mm_storeu_ps(p, v)
+#define pixel_add(a, b) _mm_add_ps(a, b)
+#define pixel_mul(a, s) _mm_mul_ps(a, _mm_set1_ps(s))
+#define pixel_zero() _mm_setzero_ps()
+#elif defined(__ARM_NEON)
+typedef float32x4_t pixel_T;
+#define pixel_load(p) vld1q_f32(p)
+#define pixel_store(p, v) vst1q_f32(p, v)
+#define pixel_add(a, b) vaddq_f32(a, b)
+#define pixel_mul(a, s) vmulq_n_f32(a, s)
+#define pixel_zero() vdupq_n_f32(0.0f)
+#else
+typedef struct { float v[4]; } pixel_T;
+static inline pixel_T pixel_load(const float* p) { pixel_T r = {{ p[0], p[1], p[2], p[3] }}; return r; }
+static inline void pixel_store(float* p, pixel_T a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline pixel_T pixel_add(pixel_T a, pixel_T b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+static inline pixel_T pixel_mul(pixel_T a, float s) { for (int i = 0; i < 4; i++) a.v[i] *= s; return a; }
+static inline pixel_T pixel_zero(void) { pixel_T r = {{ 0, 0, 0, 0 }}; return r; }
+#endif
+
+static float srgb_to_linear[256];
+static unsigned char linear_to_srgb[SRGB_TABLE_SIZE];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Fill the sRGB conversion tables, exactly once.
+ */
+static void init_tables(void)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        float c = i / 255.0f;
+        srgb_to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    for (int i = 0; i < SRGB_TABLE_SIZE; i++)
+    {
+        float c = i / (float) (SRGB_TABLE_SIZE - 1);
+        float s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+        linear_to_srgb[i] = (unsigned char) (s * 255.0f + 0.5f);
+    }
+}
+
+/**
+ * Convert RGBA8 sRGB pixels into linear floats, alpha stays linear.
+ *
+ * @param const image_T* image
+ * @return float* 4 floats per pixel.
+ */
+static float* decode_linear(const image_T* image)
+{
+    size_t count = (size_t) image->width * image->height;
+    float* out = malloc(count * 4 * sizeof(float));
+    const unsigned char* in = (const unsigned char*) image->pixels;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        out[i * 4 + 0] = srgb_to_linear[in[i * 4 + 0]];
+        out[i * 4 + 1] = srgb_to_linear[in[i * 4 + 1]];
+        out[i * 4 + 2] = srgb_to_linear[in[i * 4 + 2]];
+        out[i * 4 + 3] = in[i * 4 + 3] / 255.0f;
+    }
+
+    return out;
+}
+
+/**
+ * Clamp to [0, 1].
+ *
+ * @param float v
+ * @return float
+ */
+static float saturate(float v)
+{
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+/**
+ * Convert linear floats back to RGBA8 sRGB.
+ *
+ * @param const float* in
+ * @param image_T* image, width & height set, pixels allocated here.
+ */
+static void encode_srgb(const float* in, image_T* image)
+{
+    size_t count = (size_t) image->width * image->height;
+    image->pixels = malloc(count * sizeof(uint32_t));
+    unsigned char* out = (unsigned char*) image->pixels;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int c = 0; c < 3; c++)
+            out[i * 4 + c] = linear_to_srgb[(int) (saturate(in[i * 4 + c]) * (SRGB_TABLE_SIZE - 1) + 0.5f)];
+
+        out[i * 4 + 3] = (unsigned char) (saturate(in[i * 4 + 3]) * 255.0f + 0.5f);
+    }
+}
+
+/**
+ * Halve with a 2x2 box filter.
+ *
+ * @param const float* src
+ * @param unsigned int sw
+ * @param unsigned int sh
+ * @param float* dst
+ * @param unsigned int dw
+ * @param unsigned int dh
+ */
+static void downsample_box(const float* src, unsigned int sw, unsigned int sh,
+                           float* dst, unsigned int dw, unsigned int dh)
+{
+    for (unsigned int y = 0; y < dh; y++)
+    {
+        const float* row0 = src + (size_t) (y * 2) * sw * 4;
+        const float* row1 = src + (size_t) (y * 2 + 1 < sh ? y * 2 + 1 : y * 2) * sw * 4;
+
+        for (unsigned int x = 0; x < dw; x++)
+        {
+            unsigned int x0 = x * 2;
+            unsigned int x1 = x0 + 1 < sw ? x0 + 1 : x0;
+
+            pixel_T sum = pixel_add(pixel_add(pixel_load(row0 + x0 * 4), pixel_load(row0 + x1 * 4)),
+                                    pixel_add(pixel_load(row1 + x0 * 4), pixel_load(row1 + x1 * 4)));
+
+            pixel_store(dst + ((size_t) y * dw + x) * 4, pixel_mul(sum, 0.25f));
+        }
+    }
+}
+
+/**
+ * Zeroth order modified Bessel function of the first kind.
+ *
+ * @param float x
+ * @return float
+ */
+static float bessel_i0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+
+    for (int k = 1; k < 16; k++)
+    {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+/**
+ * Weights of a Kaiser windowed sinc for a factor two reduction.
+ * Tap `i` reads source pixel `2x - KAISER_RADIUS + 1 + i`.
+ *
+ * @param float* weights, KAISER_TAPS floats.
+ */
+static void kaiser_weights(float* weights)
+{
+    float total = 0.0f;
+
+    for (int i = 0; i < KAISER_TAPS; i++)
+    {
+        /**
+         * Distance from the center of the output pixel, in source pixels.
+         */
+        float d = i - KAISER_RADIUS + 0.5f;
+        float t = d / (float) KAISER_RADIUS;
+        float window = bessel_i0(KAISER_BETA * sqrtf(1.0f - t * t)) / bessel_i0(KAISER_BETA);
+        float x = (float) M_PI * d * 0.5f;
+        float sinc = x == 0.0f ? 1.0f : sinf(x) / x;
+
+        weights[i] = sinc * window;
+        total += weights[i];
+    }
+
+    for (int i = 0; i < KAISER_TAPS; i++)
+        weights[i] /= total;
+}
+
+/**
+ * Halve with a separable Kaiser filter, sharper than a box
+ * and with less aliasing.
+ *
+ * @param const float* src
+ * @param unsigned int sw
+ * @param unsigned int sh
+ * @param float* dst
+ * @param unsigned int dw
+ * @param unsigned int dh
+ */
+static void downsample_kaiser(const float* src, unsigned int sw, unsigned int sh,
+                              float* dst, unsigned int dw, unsigned int dh)
+{
+    float weights[KAISER_TAPS];
+    kaiser_weights(weights);
+
+    /**
+     * A 1 pixel wide or tall level is passed through on that axis.
+     */
+    int filter_x = sw > 1;
+    int filter_y = sh > 1;
+
+    float* tmp = malloc((size_t) dw * sh * 4 * sizeof(float));
+
+    for (unsigned int y = 0; y < sh; y++)
+    {
+        const float* row = src + (size_t) y * sw * 4;
+
+        for (unsigned int x = 0; x < dw; x++)
+        {
+            pixel_T sum = pixel_zero();
+
+            if (!filter_x)
+            {
+                sum = pixel_load(row);
+            }
+            else
+            {
+                for (int i = 0; i < KAISER_TAPS; i++)
+                {
+                    int sx = (int) (x * 2) - KAISER_RADIUS + 1 + i;
+                    sx = sx < 0 ? 0 : (sx >= (int) sw ? (int) sw - 1 : sx);
+                    sum = pixel_add(sum, pixel_mul(pixel_load(row + sx * 4), weights[i]));
+                }
+            }
+
+            pixel_store(tmp + ((size_t) y * dw + x) * 4, sum);
+        }
+    }
+
+    for (unsigned int y = 0; y < dh; y++)
+    {
+        for (unsigned int x = 0; x < dw; x++)
+        {
+            pixel_T sum = pixel_zero();
+
+            if (!filter_y)
+            {
+                sum = pixel_load(tmp + (size_t) x * 4);
+            }
+            else
+            {
+                for (int i = 0; i < KAISER_TAPS; i++)
+                {
+                    int sy = (int) (y * 2) - KAISER_RADIUS + 1 + i;
+                    sy = sy < 0 ? 0 : (sy >= (int) sh ? (int) sh - 1 : sy);
+                    sum = pixel_add(sum, pixel_mul(pixel_load(tmp + ((size_t) sy * dw + x) * 4), weights[i]));
+                }
+            }
+
+            pixel_store(dst + ((size_t) y * dw + x) * 4, sum);
+        }
+    }
+
+    free(tmp);
+}
+
+/**
+ * Generate a gamma correct mip chain on the CPU.
+ * `levels[0]` is the base image, levels 1 and up are allocated here.
+ * Filtering happens in linear space, the image is assumed to be sRGB.
+ *
+ * @param image_T* levels
+ * @param size_t max_levels
+ * @param mipmap_filter_T filter
+ * @return size_t amount of levels including the base.
+ */
+size_t mipmap_generate(image_T* levels, size_t max_levels, mipmap_filter_T filter)
+{
+    if (filter == MIPMAP_FILTER_NONE || max_levels < 2)
+        return 1;
+
+    pthread_once(&tables_once, init_tables);
+
+    float* src = decode_linear(&levels[0]);
+    unsigned int sw = levels[0].width;
+    unsigned int sh = levels[0].height;
+    size_t count = 1;
+
+    while (count < max_levels && (sw > 1 || sh > 1))
+    {
+        unsigned int dw = sw > 1 ? sw / 2 : 1;
+        unsigned int dh = sh > 1 ? sh / 2 : 1;
+        float* dst = malloc((size_t) dw * dh * 4 * sizeof(float));
+
+        if (filter == MIPMAP_FILTER_KAISER)
+            downsample_kaiser(src, sw, sh, dst, dw, dh);
+        else
+            downsample_box(src, sw, sh, dst, dw, dh);
+
+        levels[count].width = dw;
+        levels[count].height = dh;
+        encode_srgb(dst, &levels[count]);
+
+        free(src);
+        src = dst;
+        sw = dw;
+        sh = dh;
+        count++;
+    }
+
+    free(src);
+
+    return count;
+}
+
+/**
+ * Free generated levels, the base level is left alone.
+ *
+ * @param image_T* levels
+ * @param size_t count
+ */
+void mipmap_release(image_T* levels, size_t count)
+{
+    for (size_t i = 1; i < count; i++)
+        image_release(&levels[i]);
+}
@@ -0,0 +1,294 @@
+#include "include/overlay.h"
+#include "include/frame_uniforms.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Texture layout, ASCII in 16 columns of 8 rows. DEL is drawn fully
+ * covered for the background.
+ */
+#define OVERLAY_COLUMNS 16
+#define OVERLAY_ROWS 8
+#define OVERLAY_SOLID 127
+
+/**
+ * 3x5 glyphs, one octal digit per row from the top, 4 is the left pixel.
+ * Lower case is drawn as upper case, anything missing as `?`.
+ */
+static const unsigned short overlay_font[128] = {
+    ['0'] = 075557, ['1'] = 026227, ['2'] = 071747, ['3'] = 071317, ['4'] = 055711,
+    ['5'] = 074717, ['6'] = 074757, ['7'] = 071222, ['8'] = 075757, ['9'] = 075717,
+    ['A'] = 025755, ['B'] = 065656, ['C'] = 034443, ['D'] = 065556, ['E'] = 074647,
+    ['F'] = 074644, ['G'] = 034553, ['H'] = 055755, ['I'] = 072227, ['J'] = 011152,
+    ['K'] = 055655, ['L'] = 044447, ['M'] = 057755, ['N'] = 065555, ['O'] = 025552,
+    ['P'] = 065644, ['Q'] = 025563, ['R'] = 065655, ['S'] = 034216, ['T'] = 072222,
+    ['U'] = 055557, ['V'] = 055552, ['W'] = 055775, ['X'] = 055255, ['Y'] = 055222,
+    ['Z'] = 071247, ['.'] = 000002, [','] = 000024, [':'] = 002020, ['-'] = 000700,
+    ['_'] = 000007, ['/'] = 011244, ['%'] = 051245, ['('] = 012221, [')'] = 042224,
+    ['='] = 007070, ['+'] = 002720, ['#'] = 057575, ['<'] = 012421, ['>'] = 042124,
+    ['|'] = 022222, ['?'] = 071202,
+};
+
+static const char* overlay_vertex_text =
+    "#version 330 core\n"
+    "layout(std140) uniform Frame { mat4 VP; vec2 Viewport; vec2 Cursor; float Time; };\n"
+    "layout(location = 0) in vec2 aPos;\n"
+    "layout(location = 1) in vec2 aTexCoord;\n"
+    "layout(location = 2) in vec4 aColor;\n"
+    "out vec2 TexCoord;\n"
+    "out vec4 Color;\n"
+    "void main()\n"
+    "{\n"
+    "    vec2 ndc = aPos / Viewport * 2.0 - 1.0;\n"
+    "    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);\n"
+    "    TexCoord = aTexCoord;\n"
+    "    Color = aColor;\n"
+    "}\n";
+
+static const char* overlay_fragment_text =
+    "#version 330 core\n"
+    "uniform sampler2D Glyphs;\n"
+    "in vec2 TexCoord;\n"
+    "in vec4 Color;\n"
+    "out vec4 FragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    FragColor = vec4(Color.rgb, Color.a * texture(Glyphs, TexCoord).r);\n"
+    "}\n";
+
+
+/**
+ * Rasterize the font into a single channel texture.
+ *
+ * @return GLuint, bound on the active unit.
+ */
+static GLuint overlay_build_font(void)
+{
+    static const int width = OVERLAY_COLUMNS * OVERLAY_FONT_WIDTH;
+    static const int height = OVERLAY_ROWS * OVERLAY_FONT_HEIGHT;
+    unsigned char* pixels = calloc(width * height, 1);
+
+    for (int c = 0; c < 128; c++)
+    {
+        int x0 = (c % OVERLAY_COLUMNS) * OVERLAY_FONT_WIDTH;
+        int y0 = (c / OVERLAY_COLUMNS) * OVERLAY_FONT_HEIGHT;
+        unsigned short glyph = overlay_font[c];
+
+        for (int y = 0; y < OVERLAY_FONT_HEIGHT; y++)
+        {
+            for (int x = 0; x < OVERLAY_FONT_WIDTH; x++)
+            {
+                int on = c == OVERLAY_SOLID ||
+                         (x < 3 && y < 5 && ((glyph >> (3 * (4 - y))) & (4 >> x)));
+                pixels[(y0 + y) * width + x0 + x] = on ? 255 : 0;
+            }
+        }
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    free(pixels);
+    return texture;
+}
+
+/**
+ * Create the overlay, its program is compiled by `manager` and
+ * nothing is drawn until it is ready.
+ *
+ * @param shader_manager_T* manager
+ * @param render_state_T* state
+ * @return overlay_T*
+ */
+overlay_T* init_overlay(shader_manager_T* manager, render_state_T* state)
+{
+    overlay_T* overlay = calloc(1, sizeof(struct OVERLAY_STRUCT));
+
+    const char* vertex_sources[] = { overlay_vertex_text };
+    const char* fragment_sources[] = { overlay_fragment_text };
+    overlay->shader = shader_manager_add(manager, "overlay", vertex_sources, 1, fragment_sources, 1);
+    overlay->generation = (size_t) -1;
+
+    overlay->texture = overlay_build_font();
+    render_state_invalidate_textures(state);
+
+    /**
+     * The background & every glyph are a quad of two triangles
+     */
+    overlay->stream = init_stream_buffer(GL_ARRAY_BUFFER, (OVERLAY_MAX_GLYPHS + 1) * 6 * sizeof(overlay_vertex_T));
+
+    glGenVertexArrays(1, &overlay->vao);
+    render_state_bind_vertex_array(state, overlay->vao);
+    for (GLuint i = 0; i < 3; i++)
+        glEnableVertexAttribArray(i);
+
+    return overlay;
+}
+
+/**
+ * @param overlay_vertex_T* v, 6 vertices.
+ * @param float x
+ * @param float y
+ * @param float w
+ * @param float h
+ * @param int cell, character of the texture cell.
+ * @param const uint8_t* color
+ */
+static void overlay_quad(overlay_vertex_T* v, float x, float y, float w, float h, int cell, const uint8_t* color)
+{
+    float u0 = (cell % OVERLAY_COLUMNS) / (float) OVERLAY_COLUMNS;
+    float v0 = (cell / OVERLAY_COLUMNS) / (float) OVERLAY_ROWS;
+    float u1 = u0 + 1.0f / OVERLAY_COLUMNS;
+    float v1 = v0 + 1.0f / OVERLAY_ROWS;
+
+    const float corners[6][4] = {
+        { x, y, u0, v0 }, { x + w, y, u1, v0 }, { x, y + h, u0, v1 },
+        { x + w, y, u1, v0 }, { x + w, y + h, u1, v1 }, { x, y + h, u0, v1 }
+    };
+
+    for (int i = 0; i < 6; i++)
+    {
+        memcpy(v[i].position, corners[i], 2 * sizeof(float));
+        memcpy(v[i].texcoord, corners[i] + 2, 2 * sizeof(float));
+        memcpy(v[i].color, color, 4);
+    }
+}
+
+/**
+ * Draw `text` over a translucent box in the top left corner, `\n`
+ * starts a new line. Expects the frame's uniform block to be bound
+ * and blends on top of whatever is in the bound framebuffer.
+ *
+ * @param overlay_T* overlay
+ * @param render_state_T* state
+ * @param const char* text
+ * @param int width, of the viewport.
+ * @param int height
+ * @return size_t amount of characters drawn.
+ */
+size_t overlay_draw(overlay_T* overlay, render_state_T* state, const char* text, int width, int height)
+{
+    static const uint8_t text_color[4] = { 255, 255, 255, 255 };
+    static const uint8_t background_color[4] = { 0, 0, 0, 160 };
+    static const float advance = OVERLAY_FONT_WIDTH * OVERLAY_SCALE;
+    static const float line_height = OVERLAY_FONT_HEIGHT * OVERLAY_SCALE;
+
+    shader_program_T* shader = overlay->shader;
+    if (shader->program == 0)
+        return 0;
+
+    if (overlay->generation != shader->generation)
+    {
+        frame_uniforms_bind_program(shader->program);
+        overlay->generation = shader->generation;
+    }
+
+    size_t glyphs = 0;
+    size_t columns = 0;
+    size_t lines = 1;
+    size_t column = 0;
+
+    for (const char* c = text; *c; c++)
+    {
+        if (*c == '\n')
+        {
+            lines += c[1] != 0;
+            column = 0;
+            continue;
+        }
+
+        column++;
+        columns = column > columns ? column : columns;
+        glyphs += *c != ' ';
+    }
+
+    if (glyphs > OVERLAY_MAX_GLYPHS)
+        glyphs = OVERLAY_MAX_GLYPHS;
+
+    size_t offset;
+    stream_buffer_begin_frame(overlay->stream);
+    overlay_vertex_T* vertices = stream_buffer_alloc(overlay->stream, (glyphs + 1) * 6 * sizeof(overlay_vertex_T),
+                                                     16, &offset);
+    if (vertices == NULL)
+    {
+        stream_buffer_end_frame(overlay->stream);
+        return 0;
+    }
+
+    float padding = OVERLAY_SCALE * 2;
+    overlay_quad(vertices, OVERLAY_MARGIN, OVERLAY_MARGIN, columns * advance + padding * 2,
+                 lines * line_height + padding * 2, OVERLAY_SOLID, background_color);
+
+    float x = OVERLAY_MARGIN + padding;
+    float y = OVERLAY_MARGIN + padding;
+    size_t written = 0;
+
+    for (const char* c = text; *c && written < glyphs; c++)
+    {
+        if (*c == '\n')
+        {
+            x = OVERLAY_MARGIN + padding;
+            y += line_height;
+            continue;
+        }
+
+        if (*c != ' ')
+        {
+            unsigned char ch = *c >= 'a' && *c <= 'z' ? *c - 'a' + 'A' : (unsigned char) *c;
+            if (ch >= 128 || overlay_font[ch] == 0)
+                ch = '?';
+
+            overlay_quad(vertices + (++written) * 6, x, y, advance, line_height, ch, text_color);
+        }
+
+        x += advance;
+    }
+
+    stream_buffer_commit(overlay->stream);
+
+    render_state_viewport(state, 0, 0, width, height);
+    render_state_use_program(state, shader->program);
+    render_state_bind_vertex_array(state, overlay->vao);
+    render_state_bind_texture(state, 0, GL_TEXTURE_2D, overlay->texture);
+    render_state_bind_sampler(state, 0, 0);
+    render_state_blend(state, 1, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    /**
+     * Every frame lands somewhere else in the stream, so the
+     * attributes are pointed at it again
+     */
+    glBindBuffer(GL_ARRAY_BUFFER, overlay->stream->buffer);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(overlay_vertex_T),
+                          (void*) (offset + offsetof(overlay_vertex_T, position)));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(overlay_vertex_T),
+                          (void*) (offset + offsetof(overlay_vertex_T, texcoord)));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(overlay_vertex_T),
+                          (void*) (offset + offsetof(overlay_vertex_T, color)));
+
+    glDrawArrays(GL_TRIANGLES, 0, (written + 1) * 6);
+
+    render_state_blend(state, 0, GL_ONE, GL_ZERO);
+    stream_buffer_end_frame(overlay->stream);
+
+    return written;
+}
+
+/**
+ * @param overlay_T* overlay
+ */
+void overlay_free(overlay_T* overlay)
+{
+    glDeleteVertexArrays(1, &overlay->vao);
+    glDeleteTextures(1, &overlay->texture);
+    stream_buffer_free(overlay->stream);
+    free(overlay);
+}
@@ -0,0 +1,401 @@
+#include "include/profiler.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/**
+ * Create a profiler, needs a current GL context.
+ *
+ * @param size_t max_events, size of the trace ring, 0 for the default.
+ * @return profiler_T*
+ */
+profiler_T* init_profiler(size_t max_events)
+{
+    profiler_T* profiler = calloc(1, sizeof(struct PROFILER_STRUCT));
+    profiler->max_events = max_events ? max_events : PROFILER_MAX_EVENTS;
+    profiler->events = calloc(profiler->max_events, sizeof(struct PROFILER_EVENT_STRUCT));
+    profiler->frame = PROFILER_LATENCY - 1;
+    profiler->frame_scope = PROFILER_MAX_SCOPES;
+
+    /**
+     * Timer queries are core since 3.3, the check only matters
+     * for odd drivers.
+     */
+    profiler->gpu = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+
+    if (profiler->gpu)
+    {
+        for (size_t f = 0; f < PROFILER_LATENCY; f++)
+        {
+            for (size_t i = 0; i < PROFILER_MAX_SCOPES; i++)
+                glGenQueries(2, profiler->frames[f].samples[i].queries);
+        }
+
+        /**
+         * GPU timestamps run on their own clock, remember where it was
+         * when we started so both timelines line up in the trace.
+         */
+        GLint64 now;
+        glGetInteger64v(GL_TIMESTAMP, &now);
+        profiler->gpu_epoch = now;
+    }
+
+    profiler->cpu_epoch = profiler_now();
+
+    return profiler;
+}
+
+/**
+ * Monotonic CPU time.
+ *
+ * @return uint64_t nanoseconds.
+ */
+uint64_t profiler_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * Find the stats of a region, adding them if this is the first time
+ * it shows up.
+ *
+ * @param profiler_T* profiler
+ * @param const char* name
+ * @return profiler_stats_T* or NULL if there are too many regions.
+ */
+static profiler_stats_T* profiler_stats(profiler_T* profiler, const char* name)
+{
+    for (size_t i = 0; i < profiler->stats_count; i++)
+    {
+        if (profiler->stats[i].name == name || strcmp(profiler->stats[i].name, name) == 0)
+            return &profiler->stats[i];
+    }
+
+    if (profiler->stats_count == PROFILER_MAX_SCOPES)
+        return NULL;
+
+    profiler_stats_T* stats = &profiler->stats[profiler->stats_count++];
+    stats->name = name;
+
+    return stats;
+}
+
+/**
+ * Append an event to the trace ring.
+ *
+ * @param profiler_T* profiler
+ * @param const char* name
+ * @param uint64_t begin
+ * @param uint64_t duration
+ * @param int gpu
+ */
+static void profiler_event(profiler_T* profiler, const char* name, uint64_t begin, uint64_t duration, int gpu)
+{
+    profiler_event_T* event = &profiler->events[profiler->event_count % profiler->max_events];
+    event->name = name;
+    event->begin = begin;
+    event->duration = duration;
+    event->gpu = gpu;
+
+    profiler->event_count++;
+}
+
+/**
+ * Read back the GPU timings of an old frame.
+ * Results that are somehow still not ready are dropped instead
+ * of waiting for them.
+ *
+ * @param profiler_T* profiler
+ * @param profiler_frame_T* frame
+ */
+static void profiler_collect(profiler_T* profiler, profiler_frame_T* frame)
+{
+    for (size_t i = 0; i < frame->sample_count; i++)
+    {
+        profiler_sample_T* sample = &frame->samples[i];
+
+        GLint available = 0;
+        glGetQueryObjectiv(sample->queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint64 begin, end;
+        glGetQueryObjectui64v(sample->queries[0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(sample->queries[1], GL_QUERY_RESULT, &end);
+
+        if (end < begin || begin < (GLuint64) profiler->gpu_epoch)
+            continue;
+
+        profiler_stats_T* stats = profiler_stats(profiler, sample->name);
+        if (stats)
+            stats->gpu[stats->gpu_count++ % PROFILER_HISTORY] = end - begin;
+
+        profiler_event(profiler, sample->name, begin - profiler->gpu_epoch, end - begin, 1);
+
+        /**
+         * The frame region is always the first one, the GPU finished
+         * the frame at its end timestamp.
+         */
+        if (i == 0 && frame->input)
+        {
+            int64_t done = (int64_t) (end - profiler->gpu_epoch);
+            int64_t input = (int64_t) (frame->input - profiler->cpu_epoch);
+
+            profiler_stats_T* latency = profiler_stats(profiler, PROFILER_LATENCY_NAME);
+            if (latency && done > input)
+                latency->gpu[latency->gpu_count++ % PROFILER_HISTORY] = done - input;
+        }
+    }
+
+    frame->pending = 0;
+}
+
+/**
+ * Start a frame, also times the whole frame as the "frame" region.
+ *
+ * @param profiler_T* profiler
+ */
+void profiler_begin_frame(profiler_T* profiler)
+{
+    uint64_t now = profiler_now();
+
+    if (profiler->frame_begin)
+        profiler->frame_times[profiler->frame_count++ % PROFILER_HISTORY] = now - profiler->frame_begin;
+
+    profiler->frame_begin = now;
+    profiler->frame = (profiler->frame + 1) % PROFILER_LATENCY;
+
+    profiler_frame_T* frame = &profiler->frames[profiler->frame];
+    if (frame->pending)
+        profiler_collect(profiler, frame);
+
+    frame->sample_count = 0;
+    frame->input = 0;
+    profiler->frame_scope = profiler_begin(profiler, "frame");
+}
+
+/**
+ * Start timing a region of the current frame.
+ *
+ * @param profiler_T* profiler
+ * @param const char* name, must outlive the profiler, for example a literal.
+ * @return size_t scope to pass to profiler_end.
+ */
+size_t profiler_begin(profiler_T* profiler, const char* name)
+{
+    profiler_frame_T* frame = &profiler->frames[profiler->frame];
+    if (frame->sample_count == PROFILER_MAX_SCOPES)
+        return PROFILER_MAX_SCOPES;
+
+    size_t scope = frame->sample_count++;
+    profiler_sample_T* sample = &frame->samples[scope];
+    sample->name = name;
+    sample->cpu_begin = profiler_now();
+    sample->cpu_end = sample->cpu_begin;
+
+    if (profiler->gpu)
+        glQueryCounter(sample->queries[0], GL_TIMESTAMP);
+
+    return scope;
+}
+
+/**
+ * Stop timing a region.
+ *
+ * @param profiler_T* profiler
+ * @param size_t scope
+ */
+void profiler_end(profiler_T* profiler, size_t scope)
+{
+    profiler_frame_T* frame = &profiler->frames[profiler->frame];
+    if (scope >= frame->sample_count)
+        return;
+
+    profiler_sample_T* sample = &frame->samples[scope];
+    sample->cpu_end = profiler_now();
+
+    if (profiler->gpu)
+        glQueryCounter(sample->queries[1], GL_TIMESTAMP);
+}
+
+/**
+ * Remember when input was sampled for this frame, the latency from
+ * then until the frame is done is recorded as PROFILER_LATENCY_NAME.
+ *
+ * @param profiler_T* profiler
+ */
+void profiler_mark_input(profiler_T* profiler)
+{
+    profiler->frames[profiler->frame].input = profiler_now();
+}
+
+/**
+ * Finish the frame, the CPU timings are recorded right away while
+ * the GPU ones are read PROFILER_LATENCY frames later.
+ *
+ * @param profiler_T* profiler
+ */
+void profiler_end_frame(profiler_T* profiler)
+{
+    profiler_end(profiler, profiler->frame_scope);
+    profiler->frame_scope = PROFILER_MAX_SCOPES;
+
+    profiler_frame_T* frame = &profiler->frames[profiler->frame];
+
+    for (size_t i = 0; i < frame->sample_count; i++)
+    {
+        profiler_sample_T* sample = &frame->samples[i];
+        uint64_t duration = sample->cpu_end - sample->cpu_begin;
+
+        profiler_stats_T* stats = profiler_stats(profiler, sample->name);
+        if (stats)
+            stats->cpu[stats->cpu_count++ % PROFILER_HISTORY] = duration;
+
+        profiler_event(profiler, sample->name, sample->cpu_begin - profiler->cpu_epoch, duration, 0);
+    }
+
+    if (frame->input && frame->sample_count > 0)
+    {
+        profiler_stats_T* latency = profiler_stats(profiler, PROFILER_LATENCY_NAME);
+        if (latency)
+            latency->cpu[latency->cpu_count++ % PROFILER_HISTORY] = frame->samples[0].cpu_end - frame->input;
+    }
+
+    frame->pending = profiler->gpu;
+}
+
+static int compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Print p50 / p99 / max of a history ring.
+ *
+ * @param FILE* out
+ * @param const char* label
+ * @param const uint64_t* history
+ * @param size_t count, total amount of samples ever recorded.
+ */
+static void print_percentiles(FILE* out, const char* label, const uint64_t* history, size_t count)
+{
+    size_t n = count < PROFILER_HISTORY ? count : PROFILER_HISTORY;
+    if (n == 0)
+    {
+        fprintf(out, " %s -", label);
+        return;
+    }
+
+    uint64_t sorted[PROFILER_HISTORY];
+    memcpy(sorted, history, n * sizeof(uint64_t));
+    qsort(sorted, n, sizeof(uint64_t), compare_u64);
+
+    fprintf(out, " %s %.3f / %.3f / %.3f", label,
+            sorted[(n - 1) / 2] / 1e6,
+            sorted[(n - 1) * 99 / 100] / 1e6,
+            sorted[n - 1] / 1e6);
+}
+
+/**
+ * Print percentiles of the recent frames.
+ *
+ * @param profiler_T* profiler
+ * @param FILE* out
+ */
+void profiler_print_stats(profiler_T* profiler, FILE* out)
+{
+    fprintf(out, "Profiler (p50 / p99 / max ms over the last %d frames)\n", PROFILER_HISTORY);
+    fprintf(out, "  %-10s", "interval");
+    print_percentiles(out, "cpu", profiler->frame_times, profiler->frame_count);
+    fprintf(out, "\n");
+
+    for (size_t i = 0; i < profiler->stats_count; i++)
+    {
+        profiler_stats_T* stats = &profiler->stats[i];
+
+        fprintf(out, "  %-10s", stats->name);
+        print_percentiles(out, "cpu", stats->cpu, stats->cpu_count);
+        if (profiler->gpu)
+            print_percentiles(out, "gpu", stats->gpu, stats->gpu_count);
+        fprintf(out, "\n");
+    }
+}
+
+/**
+ * Write the events in the trace ring to a file.
+ * A path ending in .csv gives one event per line, anything else is
+ * Chrome trace JSON, open it in chrome://tracing or Perfetto.
+ *
+ * @param profiler_T* profiler
+ * @param const char* path
+ * @return int 0 on failure.
+ */
+int profiler_write_trace(profiler_T* profiler, const char* path)
+{
+    FILE* out = fopen(path, "w");
+    if (!out)
+    {
+        fprintf(stderr, "Could not write trace `%s`\n", path);
+        return 0;
+    }
+
+    size_t len = strlen(path);
+    int csv = len > 4 && strcmp(path + len - 4, ".csv") == 0;
+
+    size_t count = profiler->event_count < profiler->max_events ? profiler->event_count : profiler->max_events;
+    size_t first = profiler->event_count - count;
+
+    if (csv)
+        fprintf(out, "name,timeline,begin_us,duration_us\n");
+    else
+        fprintf(out, "{\"traceEvents\":[\n"
+                     "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n"
+                     "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+
+    for (size_t i = first; i < profiler->event_count; i++)
+    {
+        profiler_event_T* event = &profiler->events[i % profiler->max_events];
+
+        if (csv)
+            fprintf(out, "%s,%s,%.3f,%.3f\n", event->name, event->gpu ? "gpu" : "cpu",
+                    event->begin / 1e3, event->duration / 1e3);
+        else
+            fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    event->name, event->gpu ? 2 : 1, event->begin / 1e3, event->duration / 1e3);
+    }
+
+    if (!csv)
+        fprintf(out, "\n]}\n");
+
+    int ok = ferror(out) == 0;
+    ok = fclose(out) == 0 && ok;
+
+    return ok;
+}
+
+/**
+ * Free a profiler and its queries.
+ *
+ * @param profiler_T* profiler
+ */
+void profiler_free(profiler_T* profiler)
+{
+    if (profiler->gpu)
+    {
+        for (size_t f = 0; f < PROFILER_LATENCY; f++)
+        {
+            for (size_t i = 0; i < PROFILER_MAX_SCOPES; i++)
+                glDeleteQueries(2, profiler->frames[f].samples[i].queries);
+        }
+    }
+
+    free(profiler->events);
+    free(profiler);
+}
@@ -0,0 +1,293 @@
+#include "include/qoi.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Chunk tags, see https://qoiformat.org/qoi-specification.pdf
+ */
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_MASK 0xc0
+
+#define QOI_HASH(p) (((p).rgba[0] * 3 + (p).rgba[1] * 5 + (p).rgba[2] * 7 + (p).rgba[3] * 11) % 64)
+
+/**
+ * A pixel in memory order, compared as one word.
+ */
+typedef union
+{
+    unsigned char rgba[4];
+    uint32_t value;
+} qoi_pixel_T;
+
+static const unsigned char qoi_padding[QOI_PADDING_SIZE] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+
+/**
+ * @param const unsigned char* p
+ * @return uint32_t big endian value at p.
+ */
+static uint32_t qoi_read32(const unsigned char* p)
+{
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+/**
+ * @param unsigned char* p
+ * @param uint32_t value, written big endian.
+ */
+static void qoi_write32(unsigned char* p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+/**
+ * @param const unsigned char* bytes
+ * @param size_t size
+ * @return int 1 if the bytes start like a QOI file.
+ */
+int qoi_probe(const unsigned char* bytes, size_t size)
+{
+    return size >= QOI_HEADER_SIZE && memcmp(bytes, QOI_MAGIC, 4) == 0;
+}
+
+/**
+ * Decode a QOI image into RGBA pixels from `alloc`, three channel
+ * images get an opaque alpha. Safe to call from any thread.
+ *
+ * @param image_T* image
+ * @param const unsigned char* bytes
+ * @param size_t size
+ * @param image_alloc_fn_T* alloc
+ * @param void* data, passed on to alloc.
+ * @return int 0 on failure.
+ */
+int qoi_decode(image_T* image, const unsigned char* bytes, size_t size, image_alloc_fn_T* alloc, void* data)
+{
+    image->pixels = NULL;
+
+    if (!qoi_probe(bytes, size) || size < QOI_HEADER_SIZE + QOI_PADDING_SIZE)
+        return 0;
+
+    uint32_t width = qoi_read32(bytes + 4);
+    uint32_t height = qoi_read32(bytes + 8);
+    unsigned char channels = bytes[12];
+
+    if (width == 0 || height == 0 || (channels != 3 && channels != 4) ||
+        height >= QOI_PIXELS_MAX / width)
+        return 0;
+
+    size_t pixel_count = (size_t) width * height;
+    qoi_pixel_T* pixels = alloc(pixel_count * sizeof(qoi_pixel_T), data);
+    if (pixels == NULL)
+        return 0;
+
+    qoi_pixel_T index[64];
+    memset(index, 0, sizeof(index));
+
+    qoi_pixel_T px = { { 0, 0, 0, 255 } };
+    size_t p = QOI_HEADER_SIZE;
+    size_t chunks = size - QOI_PADDING_SIZE;
+    unsigned int run = 0;
+
+    for (size_t i = 0; i < pixel_count; i++)
+    {
+        if (run > 0)
+        {
+            run--;
+        }
+        else if (p < chunks)
+        {
+            unsigned char b1 = bytes[p++];
+
+            if (b1 == QOI_OP_RGB)
+            {
+                px.rgba[0] = bytes[p++];
+                px.rgba[1] = bytes[p++];
+                px.rgba[2] = bytes[p++];
+            }
+            else if (b1 == QOI_OP_RGBA)
+            {
+                px.rgba[0] = bytes[p++];
+                px.rgba[1] = bytes[p++];
+                px.rgba[2] = bytes[p++];
+                px.rgba[3] = bytes[p++];
+            }
+            else if ((b1 & QOI_MASK) == QOI_OP_INDEX)
+            {
+                px = index[b1];
+            }
+            else if ((b1 & QOI_MASK) == QOI_OP_DIFF)
+            {
+                px.rgba[0] += ((b1 >> 4) & 0x03) - 2;
+                px.rgba[1] += ((b1 >> 2) & 0x03) - 2;
+                px.rgba[2] += (b1 & 0x03) - 2;
+            }
+            else if ((b1 & QOI_MASK) == QOI_OP_LUMA)
+            {
+                unsigned char b2 = bytes[p++];
+                int vg = (b1 & 0x3f) - 32;
+                px.rgba[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+                px.rgba[1] += vg;
+                px.rgba[2] += vg - 8 + (b2 & 0x0f);
+            }
+            else
+            {
+                run = b1 & 0x3f;
+            }
+
+            index[QOI_HASH(px)] = px;
+        }
+
+        pixels[i] = px;
+    }
+
+    image->width = width;
+    image->height = height;
+    image->pixels = (uint32_t*) pixels;
+
+    return 1;
+}
+
+/**
+ * Encode RGBA pixels as a four channel QOI image.
+ *
+ * @param const image_T* image
+ * @param size_t* size, bytes written.
+ * @return unsigned char*, free with free(), NULL on failure.
+ */
+unsigned char* qoi_encode(const image_T* image, size_t* size)
+{
+    if (image->width == 0 || image->height == 0 || image->height >= QOI_PIXELS_MAX / image->width)
+        return NULL;
+
+    size_t pixel_count = (size_t) image->width * image->height;
+    unsigned char* bytes = malloc(QOI_HEADER_SIZE + pixel_count * 5 + QOI_PADDING_SIZE);
+    if (bytes == NULL)
+        return NULL;
+
+    memcpy(bytes, QOI_MAGIC, 4);
+    qoi_write32(bytes + 4, image->width);
+    qoi_write32(bytes + 8, image->height);
+    bytes[12] = 4;
+    bytes[13] = 0;
+
+    qoi_pixel_T index[64];
+    memset(index, 0, sizeof(index));
+
+    const qoi_pixel_T* pixels = (const qoi_pixel_T*) image->pixels;
+    qoi_pixel_T prev = { { 0, 0, 0, 255 } };
+    size_t p = QOI_HEADER_SIZE;
+    unsigned int run = 0;
+
+    for (size_t i = 0; i < pixel_count; i++)
+    {
+        qoi_pixel_T px = pixels[i];
+
+        if (px.value == prev.value)
+        {
+            run++;
+            if (run == 62 || i == pixel_count - 1)
+            {
+                bytes[p++] = QOI_OP_RUN | (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run > 0)
+        {
+            bytes[p++] = QOI_OP_RUN | (run - 1);
+            run = 0;
+        }
+
+        unsigned int hash = QOI_HASH(px);
+
+        if (index[hash].value == px.value)
+        {
+            bytes[p++] = QOI_OP_INDEX | hash;
+        }
+        else
+        {
+            index[hash] = px;
+
+            if (px.rgba[3] == prev.rgba[3])
+            {
+                signed char vr = px.rgba[0] - prev.rgba[0];
+                signed char vg = px.rgba[1] - prev.rgba[1];
+                signed char vb = px.rgba[2] - prev.rgba[2];
+                signed char vg_r = vr - vg;
+                signed char vg_b = vb - vg;
+
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+                {
+                    bytes[p++] = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                }
+                else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+                {
+                    bytes[p++] = QOI_OP_LUMA | (vg + 32);
+                    bytes[p++] = (vg_r + 8) << 4 | (vg_b + 8);
+                }
+                else
+                {
+                    bytes[p++] = QOI_OP_RGB;
+                    bytes[p++] = px.rgba[0];
+                    bytes[p++] = px.rgba[1];
+                    bytes[p++] = px.rgba[2];
+                }
+            }
+            else
+            {
+                bytes[p++] = QOI_OP_RGBA;
+                memcpy(bytes + p, px.rgba, 4);
+                p += 4;
+            }
+        }
+
+        prev = px;
+    }
+
+    memcpy(bytes + p, qoi_padding, QOI_PADDING_SIZE);
+    *size = p + QOI_PADDING_SIZE;
+
+    return bytes;
+}
+
+/**
+ * Encode an image and write it to `path`.
+ *
+ * @param const image_T* image
+ * @param const char* path
+ * @return int 0 on failure, the error has been printed.
+ */
+int qoi_write(const image_T* image, const char* path)
+{
+    size_t size = 0;
+    unsigned char* bytes = qoi_encode(image, &size);
+    if (bytes == NULL)
+    {
+        fprintf(stderr, "Could not encode `%s`\n", path);
+        return 0;
+    }
+
+    FILE* fp = fopen(path, "wb");
+    int ok = fp && fwrite(bytes, 1, size, fp) == size;
+
+    if (fp)
+        ok = fclose(fp) == 0 && ok;
+
+    if (!ok)
+        fprintf(stderr, "Could not write `%s`\n", path);
+
+    free(bytes);
+    return ok;
+}
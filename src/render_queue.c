@@ -0,0 +1,347 @@
+#include "include/render_queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Create a render queue holding up to the batch's capacity of draws.
+ *
+ * @param batch_renderer_T* batch
+ * @param render_state_T* state
+ * @return render_queue_T*
+ */
+render_queue_T* init_render_queue(batch_renderer_T* batch, render_state_T* state)
+{
+    render_queue_T* queue = calloc(1, sizeof(struct RENDER_QUEUE_STRUCT));
+    queue->batch = batch;
+    queue->state = state;
+    queue->capacity = batch->capacity;
+    queue->commands = malloc(queue->capacity * sizeof(render_command_T));
+    queue->items = malloc(queue->capacity * sizeof(render_sort_item_T));
+    queue->scratch = malloc(queue->capacity * sizeof(render_sort_item_T));
+
+    return queue;
+}
+
+/**
+ * Build a sort key, fields wider than their bits are truncated,
+ * which only costs some merging, never correctness.
+ *
+ * @param unsigned int layer
+ * @param GLuint program
+ * @param GLuint texture
+ * @param GLuint vao
+ * @param float depth, in [0, 1].
+ * @return uint64_t
+ */
+uint64_t render_queue_key(unsigned int layer, GLuint program, GLuint texture, GLuint vao, float depth)
+{
+    depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+    uint64_t d = (uint64_t) (depth * ((1 << RENDER_QUEUE_DEPTH_BITS) - 1));
+
+    uint64_t key = layer & ((1 << RENDER_QUEUE_LAYER_BITS) - 1);
+    key = (key << RENDER_QUEUE_PROGRAM_BITS) | (program & ((1 << RENDER_QUEUE_PROGRAM_BITS) - 1));
+    key = (key << RENDER_QUEUE_TEXTURE_BITS) | (texture & ((1 << RENDER_QUEUE_TEXTURE_BITS) - 1));
+    key = (key << RENDER_QUEUE_VAO_BITS) | (vao & ((1 << RENDER_QUEUE_VAO_BITS) - 1));
+    key = (key << RENDER_QUEUE_DEPTH_BITS) | d;
+
+    return key;
+}
+
+/**
+ * Queue a draw of one instance.
+ *
+ * @param render_queue_T* queue
+ * @param uint64_t key, from render_queue_key.
+ * @param const render_draw_T* draw
+ * @return batch_instance_T* to fill in, NULL when the queue is full.
+ */
+batch_instance_T* render_queue_push(render_queue_T* queue, uint64_t key, const render_draw_T* draw)
+{
+    if (queue->count == queue->capacity)
+    {
+        fprintf(stderr, "Render queue is full, pushed draws are dropped\n");
+        return NULL;
+    }
+
+    size_t index = queue->count++;
+    render_command_T* command = &queue->commands[index];
+    command->draw = *draw;
+    command->instance.layer = 0;
+
+    queue->items[index].key = key;
+    queue->items[index].index = index;
+
+    return &command->instance;
+}
+
+/**
+ * Queue every draw of a packet.
+ *
+ * @param render_queue_T* queue
+ * @param const render_packet_T* packet
+ */
+void render_queue_append(render_queue_T* queue, const render_packet_T* packet)
+{
+    size_t count = packet->count;
+    if (count > queue->capacity - queue->count)
+    {
+        fprintf(stderr, "Render queue is full, pushed draws are dropped\n");
+        count = queue->capacity - queue->count;
+    }
+
+    memcpy(&queue->commands[queue->count], packet->commands, count * sizeof(render_command_T));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        queue->items[queue->count + i].key = packet->keys[i];
+        queue->items[queue->count + i].index = queue->count + i;
+    }
+
+    queue->count += count;
+}
+
+/**
+ * Stable LSD radix sort of the keys, 8 bits per pass.
+ * Passes over bytes that are the same for every key are skipped,
+ * so a frame with little state variety only pays for a scan.
+ *
+ * @param render_queue_T* queue
+ */
+void render_queue_sort(render_queue_T* queue)
+{
+    size_t count = queue->count;
+    queue->sort_passes = 0;
+
+    if (count < 2)
+        return;
+
+    uint64_t all_or = 0;
+    uint64_t all_and = ~0ull;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        all_or |= queue->items[i].key;
+        all_and &= queue->items[i].key;
+    }
+
+    uint64_t varying = all_or ^ all_and;
+    render_sort_item_T* src = queue->items;
+    render_sort_item_T* dst = queue->scratch;
+
+    for (unsigned int shift = 0; shift < 64; shift += 8)
+    {
+        if (((varying >> shift) & 0xff) == 0)
+            continue;
+
+        size_t offsets[256] = {};
+
+        for (size_t i = 0; i < count; i++)
+            offsets[(src[i].key >> shift) & 0xff]++;
+
+        size_t sum = 0;
+        for (size_t b = 0; b < 256; b++)
+        {
+            size_t n = offsets[b];
+            offsets[b] = sum;
+            sum += n;
+        }
+
+        for (size_t i = 0; i < count; i++)
+            dst[offsets[(src[i].key >> shift) & 0xff]++] = src[i];
+
+        render_sort_item_T* tmp = src;
+        src = dst;
+        dst = tmp;
+        queue->sort_passes++;
+    }
+
+    if (src != queue->items)
+    {
+        queue->scratch = queue->items;
+        queue->items = src;
+    }
+}
+
+/**
+ * @param const render_draw_T* a
+ * @param const render_draw_T* b
+ * @return int 1 if both need the same state bound.
+ */
+static int render_draw_same_state(const render_draw_T* a, const render_draw_T* b)
+{
+    return a->program == b->program &&
+           a->vao == b->vao &&
+           a->texture_target == b->texture_target &&
+           a->texture == b->texture &&
+           a->sampler == b->sampler;
+}
+
+/**
+ * @param const render_draw_T* a
+ * @param const render_draw_T* b
+ * @return int 1 if both can share an instanced call.
+ */
+static int render_draw_compatible(const render_draw_T* a, const render_draw_T* b)
+{
+    return render_draw_same_state(a, b) && a->vertex_count == b->vertex_count;
+}
+
+/**
+ * @param render_queue_T* queue
+ * @param size_t i, position in sorted order.
+ * @return const render_draw_T*
+ */
+static const render_draw_T* render_queue_draw_at(render_queue_T* queue, size_t i)
+{
+    return &queue->commands[queue->items[i].index].draw;
+}
+
+/**
+ * Bind the state of a draw.
+ *
+ * @param render_queue_T* queue
+ * @param const render_draw_T* draw
+ */
+static void render_queue_bind(render_queue_T* queue, const render_draw_T* draw)
+{
+    render_state_use_program(queue->state, draw->program);
+    render_state_bind_texture(queue->state, 0, draw->texture_target, draw->texture);
+    render_state_bind_sampler(queue->state, 0, draw->sampler);
+}
+
+/**
+ * Submit the pushed instances, one instanced call per run of
+ * compatible draws.
+ *
+ * @param render_queue_T* queue
+ */
+static void render_queue_draw_instanced(render_queue_T* queue)
+{
+    batch_renderer_T* batch = queue->batch;
+    size_t first = 0;
+
+    while (first < batch->instance_count)
+    {
+        const render_draw_T* draw = &queue->commands[queue->items[first].index].draw;
+        size_t last = first + 1;
+
+        while (last < batch->instance_count &&
+               render_draw_compatible(draw, &queue->commands[queue->items[last].index].draw))
+            last++;
+
+        render_queue_bind(queue, draw);
+        batch_renderer_draw(batch, draw->vao, first, last - first, draw->vertex_count);
+
+        first = last;
+    }
+}
+
+/**
+ * GPU driven submit of the pushed instances. Every run of compatible
+ * draws becomes an indirect command, the GPU culls the instances into
+ * them and every run of draws sharing state is drawn with a single
+ * glMultiDrawArraysIndirect.
+ *
+ * @param render_queue_T* queue
+ */
+static void render_queue_draw_culled(render_queue_T* queue)
+{
+    batch_renderer_T* batch = queue->batch;
+    gpu_cull_T* cull = queue->cull;
+    size_t first = 0;
+
+    gpu_cull_begin(cull);
+
+    while (first < batch->instance_count)
+    {
+        const render_draw_T* draw = render_queue_draw_at(queue, first);
+        size_t last = first + 1;
+
+        while (last < batch->instance_count && render_draw_compatible(draw, render_queue_draw_at(queue, last)))
+            last++;
+
+        gpu_cull_add(cull, first, draw->vertex_count);
+        first = last;
+    }
+
+    batch_renderer_commit(batch);
+    gpu_cull_dispatch(cull, queue->state, batch->stream->buffer, batch->instance_offset, batch->instance_count);
+
+    size_t command = 0;
+
+    while (command < cull->command_count)
+    {
+        const render_draw_T* draw = render_queue_draw_at(queue, cull->commands[command].base_instance);
+        size_t last = command + 1;
+
+        while (last < cull->command_count &&
+               render_draw_same_state(draw, render_queue_draw_at(queue, cull->commands[last].base_instance)))
+            last++;
+
+        render_queue_bind(queue, draw);
+        batch_renderer_draw_indirect(batch, draw->vao, cull->visible, command, last - command);
+
+        command = last;
+    }
+}
+
+/**
+ * Sort and submit everything queued this frame.
+ * Instances are written in sorted order, so every run of compatible
+ * draws is contiguous and becomes a single instanced call.
+ *
+ * @param render_queue_T* queue
+ */
+void render_queue_flush(render_queue_T* queue)
+{
+    render_queue_sort(queue);
+
+    batch_renderer_T* batch = queue->batch;
+    batch_renderer_begin(batch);
+
+    for (size_t i = 0; i < queue->count; i++)
+    {
+        render_command_T* command = &queue->commands[queue->items[i].index];
+        batch_instance_T* instance = batch_renderer_push(batch, command->instance.model,
+                                                         command->instance.uv_rect);
+        if (instance == NULL)
+            break;
+
+        instance->layer = command->instance.layer;
+    }
+
+    if (queue->cull)
+        render_queue_draw_culled(queue);
+    else
+        render_queue_draw_instanced(queue);
+
+    batch_renderer_end(batch);
+    queue->count = 0;
+}
+
+/**
+ * Cull & draw on the GPU from now on, NULL draws instanced again.
+ * The cull pass must be able to hold the batch's capacity.
+ *
+ * @param render_queue_T* queue
+ * @param gpu_cull_T* cull, not owned by the queue.
+ */
+void render_queue_set_cull(render_queue_T* queue, gpu_cull_T* cull)
+{
+    queue->cull = cull;
+}
+
+/**
+ * Free a render queue, the batch & state are not owned by it.
+ *
+ * @param render_queue_T* queue
+ */
+void render_queue_free(render_queue_T* queue)
+{
+    free(queue->commands);
+    free(queue->items);
+    free(queue->scratch);
+    free(queue);
+}
@@ -0,0 +1,246 @@
+#include "include/render_state.h"
+#include <stdlib.h>
+
+
+/**
+ * Create a state tracker, nothing is known about the context yet.
+ *
+ * @return render_state_T*
+ */
+render_state_T* init_render_state(void)
+{
+    render_state_T* state = calloc(1, sizeof(struct RENDER_STATE_STRUCT));
+    render_state_invalidate(state);
+
+    return state;
+}
+
+/**
+ * Count a call that was either issued or dropped.
+ *
+ * @param render_state_T* state
+ * @param int redundant
+ * @return int 1 if the call has to be made.
+ */
+static int render_state_changed(render_state_T* state, int redundant)
+{
+    if (redundant)
+    {
+        state->skipped++;
+        return 0;
+    }
+
+    state->calls++;
+    return 1;
+}
+
+/**
+ * @param render_state_T* state
+ * @param GLuint program
+ */
+void render_state_use_program(render_state_T* state, GLuint program)
+{
+    if (render_state_changed(state, state->program == program))
+    {
+        glUseProgram(program);
+        state->program = program;
+    }
+}
+
+/**
+ * @param render_state_T* state
+ * @param GLuint vertex_array
+ */
+void render_state_bind_vertex_array(render_state_T* state, GLuint vertex_array)
+{
+    if (render_state_changed(state, state->vertex_array == vertex_array))
+    {
+        glBindVertexArray(vertex_array);
+        state->vertex_array = vertex_array;
+    }
+}
+
+/**
+ * Bind a framebuffer for both drawing & reading.
+ *
+ * @param render_state_T* state
+ * @param GLuint framebuffer
+ */
+void render_state_bind_framebuffer(render_state_T* state, GLuint framebuffer)
+{
+    if (render_state_changed(state, state->framebuffer == framebuffer))
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        state->framebuffer = framebuffer;
+    }
+}
+
+/**
+ * Bind a sampler object to a unit, 0 samples with the parameters of
+ * the texture itself. Samplers do not need the unit to be active.
+ *
+ * @param render_state_T* state
+ * @param GLuint unit, below RENDER_STATE_TEXTURE_UNITS.
+ * @param GLuint sampler
+ */
+void render_state_bind_sampler(render_state_T* state, GLuint unit, GLuint sampler)
+{
+    if (unit >= RENDER_STATE_TEXTURE_UNITS)
+        return;
+
+    if (!render_state_changed(state, state->samplers[unit] == sampler))
+        return;
+
+    glBindSampler(unit, sampler);
+    state->samplers[unit] = sampler;
+}
+
+/**
+ * Bind a texture to a unit, only switching the active unit when
+ * the binding actually changes.
+ *
+ * @param render_state_T* state
+ * @param GLuint unit, below RENDER_STATE_TEXTURE_UNITS.
+ * @param GLenum target
+ * @param GLuint texture
+ */
+void render_state_bind_texture(render_state_T* state, GLuint unit, GLenum target, GLuint texture)
+{
+    if (unit >= RENDER_STATE_TEXTURE_UNITS)
+        return;
+
+    if (!render_state_changed(state, state->textures[unit] == texture &&
+                                     state->texture_targets[unit] == target))
+        return;
+
+    if (state->active_texture != unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        state->active_texture = unit;
+        state->calls++;
+    }
+
+    glBindTexture(target, texture);
+    state->textures[unit] = texture;
+    state->texture_targets[unit] = target;
+}
+
+/**
+ * @param render_state_T* state
+ * @param GLint x
+ * @param GLint y
+ * @param GLint width
+ * @param GLint height
+ */
+void render_state_viewport(render_state_T* state, GLint x, GLint y, GLint width, GLint height)
+{
+    GLint* v = state->viewport;
+
+    if (render_state_changed(state, v[0] == x && v[1] == y && v[2] == width && v[3] == height))
+    {
+        glViewport(x, y, width, height);
+        v[0] = x;
+        v[1] = y;
+        v[2] = width;
+        v[3] = height;
+    }
+}
+
+/**
+ * Turn blending on or off, the blend function only matters
+ * while it is on.
+ *
+ * @param render_state_T* state
+ * @param int enabled
+ * @param GLenum src
+ * @param GLenum dst
+ */
+void render_state_blend(render_state_T* state, int enabled, GLenum src, GLenum dst)
+{
+    GLuint blend = enabled ? 1 : 0;
+
+    if (render_state_changed(state, state->blend == blend))
+    {
+        if (enabled)
+            glEnable(GL_BLEND);
+        else
+            glDisable(GL_BLEND);
+
+        state->blend = blend;
+    }
+
+    if (enabled && render_state_changed(state, state->blend_src == src && state->blend_dst == dst))
+    {
+        glBlendFunc(src, dst);
+        state->blend_src = src;
+        state->blend_dst = dst;
+    }
+}
+
+/**
+ * Forget the texture bindings, for example after uploads that
+ * bound textures directly on the active unit.
+ *
+ * @param render_state_T* state
+ */
+void render_state_invalidate_textures(render_state_T* state)
+{
+    for (size_t i = 0; i < RENDER_STATE_TEXTURE_UNITS; i++)
+    {
+        state->textures[i] = RENDER_STATE_UNKNOWN;
+        state->texture_targets[i] = RENDER_STATE_UNKNOWN;
+    }
+}
+
+/**
+ * Forget the framebuffer binding, for example after blits that
+ * bound the read & draw framebuffers separately.
+ *
+ * @param render_state_T* state
+ */
+void render_state_invalidate_framebuffer(render_state_T* state)
+{
+    state->framebuffer = RENDER_STATE_UNKNOWN;
+}
+
+/**
+ * Forget everything.
+ *
+ * @param render_state_T* state
+ */
+void render_state_invalidate(render_state_T* state)
+{
+    state->program = RENDER_STATE_UNKNOWN;
+    state->vertex_array = RENDER_STATE_UNKNOWN;
+    state->framebuffer = RENDER_STATE_UNKNOWN;
+    state->blend = RENDER_STATE_UNKNOWN;
+    state->blend_src = RENDER_STATE_UNKNOWN;
+    state->blend_dst = RENDER_STATE_UNKNOWN;
+
+    state->active_texture = RENDER_STATE_UNKNOWN;
+
+    for (size_t i = 0; i < 4; i++)
+        state->viewport[i] = -1;
+
+    for (size_t i = 0; i < RENDER_STATE_TEXTURE_UNITS; i++)
+        state->samplers[i] = RENDER_STATE_UNKNOWN;
+
+    render_state_invalidate_textures(state);
+}
+
+/**
+ * @param render_state_T* state
+ */
+void render_state_reset_counters(render_state_T* state)
+{
+    state->calls = 0;
+    state->skipped = 0;
+}
+
+/**
+ * @param render_state_T* state
+ */
+void render_state_free(render_state_T* state)
+{
+    free(state);
+}
@@ -0,0 +1,154 @@
+#include "include/sampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+
+static const char* preset_names[SAMPLER_PRESET_COUNT] =
+{
+    "nearest",
+    "bilinear",
+    "trilinear",
+    "aniso"
+};
+
+
+/**
+ * Create the sampler objects of every preset.
+ * Must be called with a current GL context.
+ *
+ * @param GLenum wrap, e.g GL_REPEAT or GL_CLAMP_TO_EDGE.
+ * @param sampler_preset_T preset, the one to start with.
+ * @param float anisotropy, for SAMPLER_ANISOTROPIC.
+ * @return sampler_T*
+ */
+sampler_T* init_sampler(GLenum wrap, sampler_preset_T preset, float anisotropy)
+{
+    sampler_T* sampler = calloc(1, sizeof(struct SAMPLER_STRUCT));
+    sampler->preset = preset;
+    sampler->anisotropy = 1.0f;
+
+    /**
+     * Core in 4.6, an extension everywhere else worth mentioning
+     */
+    if (GLEW_ARB_texture_filter_anisotropic || GLEW_EXT_texture_filter_anisotropic)
+    {
+        float max_anisotropy = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &max_anisotropy);
+        sampler->anisotropy = anisotropy < max_anisotropy ? anisotropy : max_anisotropy;
+        if (sampler->anisotropy < 1.0f)
+            sampler->anisotropy = 1.0f;
+    }
+    else if (preset == SAMPLER_ANISOTROPIC)
+    {
+        fprintf(stderr, "Anisotropic filtering is not supported by this driver, using trilinear\n");
+    }
+
+    glGenSamplers(SAMPLER_PRESET_COUNT, sampler->samplers);
+
+    for (size_t i = 0; i < SAMPLER_PRESET_COUNT; i++)
+    {
+        GLuint id = sampler->samplers[i];
+        GLenum min_filter = GL_LINEAR_MIPMAP_LINEAR;
+        GLenum mag_filter = GL_LINEAR;
+
+        if (i == SAMPLER_NEAREST)
+        {
+            min_filter = GL_NEAREST;
+            mag_filter = GL_NEAREST;
+        }
+        else if (i == SAMPLER_BILINEAR)
+        {
+            min_filter = GL_LINEAR_MIPMAP_NEAREST;
+        }
+
+        glSamplerParameteri(id, GL_TEXTURE_WRAP_S, wrap);
+        glSamplerParameteri(id, GL_TEXTURE_WRAP_T, wrap);
+        glSamplerParameteri(id, GL_TEXTURE_MIN_FILTER, min_filter);
+        glSamplerParameteri(id, GL_TEXTURE_MAG_FILTER, mag_filter);
+
+        if (i == SAMPLER_ANISOTROPIC && sampler->anisotropy > 1.0f)
+            glSamplerParameterf(id, GL_TEXTURE_MAX_ANISOTROPY, sampler->anisotropy);
+    }
+
+    return sampler;
+}
+
+/**
+ * Parse a preset name: nearest, bilinear, trilinear or anisoN,
+ * where N is the amount of anisotropy, e.g aniso16.
+ *
+ * @param const char* name
+ * @param sampler_preset_T* preset
+ * @param float* anisotropy, only written for anisoN.
+ * @return int 0 for an unknown name.
+ */
+int sampler_parse_preset(const char* name, sampler_preset_T* preset, float* anisotropy)
+{
+    size_t length = strlen(preset_names[SAMPLER_ANISOTROPIC]);
+
+    if (strncmp(name, preset_names[SAMPLER_ANISOTROPIC], length) == 0)
+    {
+        float value = SAMPLER_ANISOTROPY_DEFAULT;
+        if (name[length] && (sscanf(name + length, "%f", &value) != 1 || value < 1.0f))
+            return 0;
+
+        *preset = SAMPLER_ANISOTROPIC;
+        *anisotropy = value;
+        return 1;
+    }
+
+    for (size_t i = 0; i < SAMPLER_ANISOTROPIC; i++)
+    {
+        if (strcmp(name, preset_names[i]) == 0)
+        {
+            *preset = i;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @param sampler_preset_T preset
+ * @return const char*
+ */
+const char* sampler_preset_name(sampler_preset_T preset)
+{
+    return preset < SAMPLER_PRESET_COUNT ? preset_names[preset] : "unknown";
+}
+
+/**
+ * Switch the preset that sampler_current hands out.
+ *
+ * @param sampler_T* sampler
+ * @param sampler_preset_T preset
+ */
+void sampler_set_preset(sampler_T* sampler, sampler_preset_T preset)
+{
+    if (preset < SAMPLER_PRESET_COUNT)
+        sampler->preset = preset;
+}
+
+/**
+ * @param sampler_T* sampler
+ * @return GLuint sampler object of the current preset.
+ */
+GLuint sampler_current(sampler_T* sampler)
+{
+    return sampler->samplers[sampler->preset];
+}
+
+/**
+ * @param sampler_T* sampler
+ */
+void sampler_free(sampler_T* sampler)
+{
+    glDeleteSamplers(SAMPLER_PRESET_COUNT, sampler->samplers);
+    free(sampler);
+}
@@ -0,0 +1,431 @@
+#include "include/scene_file.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/**
+ * @param uint64_t offset
+ * @param uint64_t count
+ * @param uint64_t element_size
+ * @param size_t size, of the whole file.
+ * @return int 1 if the section is aligned & inside the file.
+ */
+static int scene_file_section_valid(uint64_t offset, uint64_t count, uint64_t element_size, size_t size)
+{
+    return offset % SCENE_FILE_ALIGNMENT == 0 && offset <= size && count * element_size <= size - offset;
+}
+
+/**
+ * Check that every index & range in the file stays inside it,
+ * so nothing needs checking while drawing.
+ *
+ * @param scene_file_T* scene
+ * @return int 0 if the file is broken.
+ */
+static int scene_file_validate(scene_file_T* scene)
+{
+    const scene_file_header_T* header = scene->header;
+    size_t size = scene->mapping_size;
+
+    int valid = memcmp(header->magic, SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC)) == 0 &&
+                header->version == SCENE_FILE_VERSION &&
+                header->mesh_count > 0 && header->texture_count > 0 && header->instance_count > 0 &&
+                scene_file_section_valid(header->meshes, header->mesh_count, sizeof(scene_file_mesh_T), size) &&
+                scene_file_section_valid(header->textures, header->texture_count, sizeof(scene_file_texture_T), size) &&
+                scene_file_section_valid(header->vertices, header->vertex_count, sizeof(packed_vertex_T), size) &&
+                scene_file_section_valid(header->strings, header->strings_size, 1, size);
+
+    for (int i = 0; valid && i < SCENE_FILE_ARRAY_COUNT; i++)
+        valid = scene_file_section_valid(header->arrays[i], header->instance_count, sizeof(uint32_t), size);
+
+    if (!valid)
+        return 0;
+
+    const char* base = scene->mapping;
+    scene->meshes = (const scene_file_mesh_T*) (base + header->meshes);
+    scene->textures = (const scene_file_texture_T*) (base + header->textures);
+    scene->vertices = (const packed_vertex_T*) (base + header->vertices);
+    scene->strings = base + header->strings;
+
+    for (int i = 0; i < SCENE_FILE_MESH; i++)
+        scene->transforms[i] = (const float*) (base + header->arrays[i]);
+
+    scene->instance_meshes = (const uint32_t*) (base + header->arrays[SCENE_FILE_MESH]);
+    scene->instance_textures = (const uint32_t*) (base + header->arrays[SCENE_FILE_TEXTURE]);
+
+    for (uint32_t i = 0; i < header->mesh_count; i++)
+    {
+        const scene_file_mesh_T* mesh = &scene->meshes[i];
+        if (mesh->vertex_count == 0 || (uint64_t) mesh->first_vertex + mesh->vertex_count > header->vertex_count)
+            return 0;
+    }
+
+    for (uint32_t i = 0; i < header->texture_count; i++)
+    {
+        const scene_file_texture_T* texture = &scene->textures[i];
+        if (texture->path >= header->strings_size || texture->length >= header->strings_size - texture->path ||
+            scene->strings[texture->path + texture->length] != 0)
+            return 0;
+    }
+
+    for (uint32_t i = 0; i < header->instance_count; i++)
+    {
+        if (scene->instance_meshes[i] >= header->mesh_count ||
+            scene->instance_textures[i] >= header->texture_count)
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Map a scene file into memory and validate it.
+ *
+ * @param const char* path
+ * @return scene_file_T* or NULL, the error has been printed.
+ */
+scene_file_T* scene_file_open(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Could not open scene `%s`\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(scene_file_header_T))
+    {
+        fprintf(stderr, "Invalid scene `%s`\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "Could not map scene `%s`\n", path);
+        return NULL;
+    }
+
+    scene_file_T* scene = calloc(1, sizeof(struct SCENE_FILE_STRUCT));
+    scene->mapping = mapping;
+    scene->mapping_size = st.st_size;
+    scene->header = mapping;
+
+    if (!scene_file_validate(scene))
+    {
+        fprintf(stderr, "Invalid scene `%s`\n", path);
+        scene_file_close(scene);
+        return NULL;
+    }
+
+    return scene;
+}
+
+/**
+ * @param scene_file_T* scene
+ * @param size_t texture
+ * @return const char*, inside the mapping.
+ */
+const char* scene_file_texture_path(scene_file_T* scene, size_t texture)
+{
+    return scene->strings + scene->textures[texture].path;
+}
+
+/**
+ * @param scene_file_T* scene
+ * @return float radius enclosing every mesh.
+ */
+float scene_file_radius(scene_file_T* scene)
+{
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < scene->header->mesh_count; i++)
+        radius = fmaxf(radius, scene->meshes[i].radius);
+
+    return radius;
+}
+
+/**
+ * Copy the instance transforms out of the mapping, one memcpy per
+ * field since both sides are laid out as structure of arrays.
+ *
+ * @param scene_file_T* scene
+ * @param transform_soa_T* transforms, at least instance_count large.
+ */
+void scene_file_load_transforms(scene_file_T* scene, transform_soa_T* transforms)
+{
+    float* fields[SCENE_FILE_MESH] = {
+        transforms->x, transforms->y, transforms->z,
+        transforms->rotation, transforms->scale_x, transforms->scale_y
+    };
+
+    for (int i = 0; i < SCENE_FILE_MESH; i++)
+        memcpy(fields[i], scene->transforms[i], scene->header->instance_count * sizeof(float));
+}
+
+/**
+ * Unmap a scene file.
+ *
+ * @param scene_file_T* scene
+ */
+void scene_file_close(scene_file_T* scene)
+{
+    munmap(scene->mapping, scene->mapping_size);
+    free(scene);
+}
+
+/**
+ * Reserve an aligned section.
+ *
+ * @param uint64_t* end, of the file so far.
+ * @param uint64_t size
+ * @return uint64_t offset of the section.
+ */
+static uint64_t scene_file_reserve(uint64_t* end, uint64_t size)
+{
+    uint64_t offset = (*end + SCENE_FILE_ALIGNMENT - 1) & ~(uint64_t) (SCENE_FILE_ALIGNMENT - 1);
+    *end = offset + size;
+    return offset;
+}
+
+/**
+ * Pad the file up to `offset` & write a section there.
+ *
+ * @param FILE* fp
+ * @param uint64_t offset
+ * @param const void* data
+ * @param size_t size
+ * @return int 0 on failure.
+ */
+static int scene_file_put(FILE* fp, uint64_t offset, const void* data, size_t size)
+{
+    static const char padding[SCENE_FILE_ALIGNMENT];
+
+    long pad = (long) offset - ftell(fp);
+    return pad >= 0 && fwrite(padding, 1, pad, fp) == (size_t) pad && fwrite(data, 1, size, fp) == size;
+}
+
+/**
+ * Write a scene file. The counts & window size are taken from `header`,
+ * the rest of it is filled in here.
+ *
+ * @param const char* path
+ * @param scene_file_header_T* header
+ * @param const scene_file_mesh_T* meshes
+ * @param const packed_vertex_T* vertices
+ * @param const char* const* texture_paths
+ * @param const transform_soa_T* transforms
+ * @param const uint32_t* instance_meshes
+ * @param const uint32_t* instance_textures
+ * @return int 0 on failure, the error has been printed.
+ */
+int scene_file_write(const char* path, scene_file_header_T* header, const scene_file_mesh_T* meshes,
+                     const packed_vertex_T* vertices, const char* const* texture_paths,
+                     const transform_soa_T* transforms, const uint32_t* instance_meshes,
+                     const uint32_t* instance_textures)
+{
+    scene_file_texture_T* textures = calloc(header->texture_count, sizeof(scene_file_texture_T));
+    uint64_t strings_size = 0;
+
+    for (uint32_t i = 0; i < header->texture_count; i++)
+    {
+        textures[i].path = strings_size;
+        textures[i].length = strlen(texture_paths[i]);
+        strings_size += textures[i].length + 1;
+    }
+
+    memcpy(header->magic, SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC));
+    header->version = SCENE_FILE_VERSION;
+    header->strings_size = strings_size;
+
+    uint64_t end = sizeof(*header);
+    uint64_t instances = (uint64_t) header->instance_count * sizeof(uint32_t);
+    header->meshes = scene_file_reserve(&end, header->mesh_count * sizeof(scene_file_mesh_T));
+    header->textures = scene_file_reserve(&end, header->texture_count * sizeof(scene_file_texture_T));
+    header->vertices = scene_file_reserve(&end, header->vertex_count * sizeof(packed_vertex_T));
+    header->strings = scene_file_reserve(&end, strings_size);
+
+    for (int i = 0; i < SCENE_FILE_ARRAY_COUNT; i++)
+        header->arrays[i] = scene_file_reserve(&end, instances);
+
+    const void* arrays[SCENE_FILE_ARRAY_COUNT] = {
+        transforms->x, transforms->y, transforms->z, transforms->rotation,
+        transforms->scale_x, transforms->scale_y, instance_meshes, instance_textures
+    };
+
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Could not open `%s` for writing\n", path);
+        free(textures);
+        return 0;
+    }
+
+    int ok = scene_file_put(fp, 0, header, sizeof(*header)) &&
+             scene_file_put(fp, header->meshes, meshes, header->mesh_count * sizeof(scene_file_mesh_T)) &&
+             scene_file_put(fp, header->textures, textures, header->texture_count * sizeof(scene_file_texture_T)) &&
+             scene_file_put(fp, header->vertices, vertices, header->vertex_count * sizeof(packed_vertex_T));
+
+    for (uint32_t i = 0; ok && i < header->texture_count; i++)
+        ok = scene_file_put(fp, header->strings + textures[i].path, texture_paths[i], textures[i].length + 1);
+
+    for (int i = 0; ok && i < SCENE_FILE_ARRAY_COUNT; i++)
+        ok = scene_file_put(fp, header->arrays[i], arrays[i], instances);
+
+    if (fclose(fp) != 0)
+        ok = 0;
+
+    if (!ok)
+        fprintf(stderr, "Could not write `%s`\n", path);
+
+    free(textures);
+    return ok;
+}
+
+/**
+ * @param uint32_t* state, xorshift state, never 0.
+ * @return float in [0, 1)
+ */
+static float scene_file_random(uint32_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+
+    return (*state >> 8) / 16777216.0f;
+}
+
+/**
+ * Write a stress test scene: `mesh_count` polygons, a triangle, a
+ * square and so on, scattered `instance_count` times over the view
+ * with random rotations, meshes & textures. The same seed always
+ * gives the same scene.
+ *
+ * @param const char* path
+ * @param size_t instance_count
+ * @param size_t mesh_count
+ * @param const char* const* texture_paths
+ * @param size_t texture_count
+ * @param uint32_t width, of the window, 0 for the default.
+ * @param uint32_t height
+ * @param uint32_t seed
+ * @return int 0 on failure, the error has been printed.
+ */
+int scene_file_generate(const char* path, size_t instance_count, size_t mesh_count,
+                        const char* const* texture_paths, size_t texture_count,
+                        uint32_t width, uint32_t height, uint32_t seed)
+{
+    static const float polygon_radius = 0.6f;
+    static const float colors[3][3] = { { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, 0.f, 1.f } };
+
+    if (instance_count == 0 || instance_count > UINT32_MAX || mesh_count == 0 || texture_count == 0)
+    {
+        fprintf(stderr, "A scene needs at least one instance, mesh & texture\n");
+        return 0;
+    }
+
+    if (mesh_count > SCENE_FILE_MAX_MESHES)
+    {
+        fprintf(stderr, "A scene has at most %d meshes\n", SCENE_FILE_MAX_MESHES);
+        return 0;
+    }
+
+    /**
+     * A polygon with n sides is a fan of n - 2 triangles
+     */
+    size_t vertex_count = 0;
+    for (size_t i = 0; i < mesh_count; i++)
+        vertex_count += (i + 1) * 3;
+
+    scene_file_mesh_T* meshes = calloc(mesh_count, sizeof(scene_file_mesh_T));
+    packed_vertex_T* vertices = calloc(vertex_count, sizeof(packed_vertex_T));
+    packed_vertex_T* vertex = vertices;
+
+    transform_soa_T* transforms = init_transform_soa(instance_count);
+    uint32_t* instance_meshes = malloc(instance_count * sizeof(uint32_t));
+    uint32_t* instance_textures = malloc(instance_count * sizeof(uint32_t));
+
+    if (!meshes || !vertices || !transforms || !instance_meshes || !instance_textures)
+    {
+        fprintf(stderr, "Not enough memory for a scene of %zu instances\n", instance_count);
+        free(instance_textures);
+        free(instance_meshes);
+        if (transforms)
+            transform_soa_free(transforms);
+        free(vertices);
+        free(meshes);
+        return 0;
+    }
+
+    for (size_t i = 0; i < mesh_count; i++)
+    {
+        size_t sides = i + 3;
+        meshes[i].first_vertex = vertex - vertices;
+        meshes[i].vertex_count = (sides - 2) * 3;
+        meshes[i].radius = polygon_radius;
+
+        for (size_t triangle = 0; triangle < sides - 2; triangle++)
+        {
+            size_t corners[3] = { 0, triangle + 1, triangle + 2 };
+
+            for (int c = 0; c < 3; c++)
+            {
+                float angle = (float) (M_PI / 2 + corners[c] * 2 * M_PI / sides);
+                float position[2] = { cosf(angle) * polygon_radius, sinf(angle) * polygon_radius };
+                float texcoord[2] = { 0.5f + 0.5f * cosf(angle), 0.5f + 0.5f * sinf(angle) };
+                vertex_pack(vertex++, position, texcoord, colors[corners[c] % 3]);
+            }
+        }
+    }
+
+    /**
+     * Sized like the benchmark grid, so a scene covers the view
+     * about as densely
+     */
+    float cell = 2.0f / ceil(sqrt((double) instance_count));
+    uint32_t state = seed ? seed : 1;
+
+    for (size_t i = 0; i < instance_count; i++)
+    {
+        transforms->x[i] = scene_file_random(&state) * 2.0f - 1.0f;
+        transforms->y[i] = scene_file_random(&state) * 2.0f - 1.0f;
+        transforms->z[i] = 0.0f;
+        transforms->rotation[i] = scene_file_random(&state) * 2.0f * M_PI;
+        transforms->scale_x[i] = cell * 0.5f;
+        transforms->scale_y[i] = cell * 0.5f;
+        instance_meshes[i] = scene_file_random(&state) * mesh_count;
+        instance_textures[i] = scene_file_random(&state) * texture_count;
+    }
+
+    scene_file_header_T header = {};
+    header.width = width;
+    header.height = height;
+    header.mesh_count = mesh_count;
+    header.texture_count = texture_count;
+    header.vertex_count = vertex_count;
+    header.instance_count = instance_count;
+
+    int ok = scene_file_write(path, &header, meshes, vertices, texture_paths, transforms,
+                              instance_meshes, instance_textures);
+
+    if (ok)
+        printf("Wrote `%s` (%zu instances, %zu meshes, %zu textures)\n",
+               path, instance_count, mesh_count, texture_count);
+
+    free(instance_textures);
+    free(instance_meshes);
+    transform_soa_free(transforms);
+    free(vertices);
+    free(meshes);
+
+    return ok;
+}
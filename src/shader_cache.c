@@ -0,0 +1,248 @@
+#include "include/shader_cache.h"
+#include "include/hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/**
+ * Create a program cache, needs a current GL context.
+ *
+ * @param const char* directory, created if it does not exist.
+ * @return shader_cache_T*
+ */
+shader_cache_T* init_shader_cache(const char* directory)
+{
+    shader_cache_T* cache = calloc(1, sizeof(struct SHADER_CACHE_STRUCT));
+    cache->directory = strdup(directory);
+
+    /**
+     * Some drivers expose the extension with zero formats, which means
+     * they will never give us anything back.
+     */
+    GLint formats = 0;
+    if (GLEW_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+    cache->supported = formats > 0;
+
+    const char* strings[] = {
+        (const char*) glGetString(GL_VENDOR),
+        (const char*) glGetString(GL_RENDERER),
+        (const char*) glGetString(GL_VERSION)
+    };
+
+    uint64_t hash = HASH_FNV1A64_SEED;
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++)
+    {
+        if (strings[i])
+            hash = hash_fnv1a64(strings[i], strlen(strings[i]) + 1, hash);
+    }
+
+    cache->driver_hash = hash;
+
+    if (cache->supported && mkdir(directory, 0755) != 0)
+    {
+        struct stat st;
+        if (stat(directory, &st) != 0 || !S_ISDIR(st.st_mode))
+        {
+            fprintf(stderr, "Could not create shader cache `%s`\n", directory);
+            cache->supported = 0;
+        }
+    }
+
+    return cache;
+}
+
+/**
+ * Key of a program built from these sources on this driver.
+ *
+ * @param shader_cache_T* cache
+ * @param const char* const* vertex_sources
+ * @param size_t vertex_count
+ * @param const char* const* fragment_sources
+ * @param size_t fragment_count
+ * @return uint64_t
+ */
+uint64_t shader_cache_key(shader_cache_T* cache,
+                          const char* const* vertex_sources, size_t vertex_count,
+                          const char* const* fragment_sources, size_t fragment_count)
+{
+    uint64_t hash = cache->driver_hash;
+
+    for (size_t i = 0; i < vertex_count; i++)
+        hash = hash_fnv1a64(vertex_sources[i], strlen(vertex_sources[i]), hash);
+
+    /**
+     * Separator, so moving text from one stage to the other changes the key
+     */
+    hash = hash_fnv1a64("\0", 1, hash);
+
+    for (size_t i = 0; i < fragment_count; i++)
+        hash = hash_fnv1a64(fragment_sources[i], strlen(fragment_sources[i]), hash);
+
+    return hash;
+}
+
+/**
+ * Path of the file holding a key, caller frees.
+ *
+ * @param shader_cache_T* cache
+ * @param uint64_t key
+ * @return char*
+ */
+static char* shader_cache_path(shader_cache_T* cache, uint64_t key)
+{
+    size_t len = strlen(cache->directory) + 32;
+    char* path = malloc(len);
+    snprintf(path, len, "%s/%016llx.bin", cache->directory, (unsigned long long) key);
+
+    return path;
+}
+
+/**
+ * Create a program from a cached binary.
+ * Anything wrong with the file or a driver that rejects the binary
+ * is a miss, the caller then compiles as usual.
+ *
+ * @param shader_cache_T* cache
+ * @param uint64_t key
+ * @return GLuint linked program, 0 on a miss.
+ */
+GLuint shader_cache_load(shader_cache_T* cache, uint64_t key)
+{
+    if (!cache->supported)
+        return 0;
+
+    char* path = shader_cache_path(cache, key);
+    FILE* fp = fopen(path, "rb");
+    free(path);
+
+    shader_cache_header_T header;
+    void* binary = NULL;
+    int ok = fp != NULL &&
+             fread(&header, sizeof(header), 1, fp) == 1 &&
+             memcmp(header.magic, SHADER_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+             header.version == SHADER_CACHE_VERSION &&
+             header.key == key &&
+             header.size > 0 && header.size < (1u << 30) &&
+             (binary = malloc(header.size)) != NULL &&
+             fread(binary, 1, header.size, fp) == header.size;
+
+    if (fp)
+        fclose(fp);
+
+    GLuint program = 0;
+
+    if (ok)
+    {
+        program = glCreateProgram();
+        glProgramBinary(program, header.format, binary, header.size);
+
+        GLint status = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+        if (!status)
+        {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    free(binary);
+
+    if (program)
+        cache->hits++;
+    else
+        cache->misses++;
+
+    return program;
+}
+
+/**
+ * Call before linking a program that should be stored, lets the
+ * driver know we will ask for the binary.
+ *
+ * @param shader_cache_T* cache
+ * @param GLuint program
+ */
+void shader_cache_prepare(shader_cache_T* cache, GLuint program)
+{
+    if (cache->supported)
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+/**
+ * Save a linked program.
+ * Written to a temporary file first so a crash never leaves half
+ * a binary behind.
+ *
+ * @param shader_cache_T* cache
+ * @param uint64_t key
+ * @param GLuint program
+ * @return int 0 on failure.
+ */
+int shader_cache_store(shader_cache_T* cache, uint64_t key, GLuint program)
+{
+    if (!cache->supported)
+        return 0;
+
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0)
+        return 0;
+
+    shader_cache_header_T header = {};
+    memcpy(header.magic, SHADER_CACHE_MAGIC, sizeof(header.magic));
+    header.version = SHADER_CACHE_VERSION;
+    header.key = key;
+
+    void* binary = malloc(size);
+    GLsizei length = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, size, &length, &format, binary);
+
+    header.format = format;
+    header.size = length;
+
+    char* path = shader_cache_path(cache, key);
+    size_t len = strlen(path) + 5;
+    char* tmp = malloc(len);
+    snprintf(tmp, len, "%s.tmp", path);
+
+    FILE* fp = fopen(tmp, "wb");
+    int ok = fp != NULL && length > 0 &&
+             fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(binary, 1, length, fp) == (size_t) length;
+
+    if (fp && fclose(fp) != 0)
+        ok = 0;
+
+    if (ok)
+        ok = rename(tmp, path) == 0;
+
+    if (!ok && fp)
+        unlink(tmp);
+
+    if (!ok)
+        fprintf(stderr, "Could not write shader cache `%s`\n", path);
+
+    free(tmp);
+    free(path);
+    free(binary);
+
+    return ok;
+}
+
+/**
+ * Free a shader cache, cached files stay on disk.
+ *
+ * @param shader_cache_T* cache
+ */
+void shader_cache_free(shader_cache_T* cache)
+{
+    free(cache->directory);
+    free(cache);
+}
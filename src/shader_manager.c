@@ -0,0 +1,354 @@
+#include "include/shader_manager.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Create a shader manager, needs a current GL context.
+ *
+ * @param shader_cache_T* cache, linked programs are loaded from & saved to it.
+ * @return shader_manager_T*
+ */
+shader_manager_T* init_shader_manager(shader_cache_T* cache)
+{
+    shader_manager_T* manager = calloc(1, sizeof(struct SHADER_MANAGER_STRUCT));
+    manager->cache = cache;
+
+    /**
+     * 0xFFFFFFFF lets the driver pick how many threads to use
+     */
+    if (GLEW_KHR_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        manager->parallel = 1;
+    }
+    else if (GLEW_ARB_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        manager->parallel = 1;
+    }
+
+    return manager;
+}
+
+/**
+ * Start compiling a shader, the status is checked later.
+ *
+ * @param GLenum type
+ * @param const char* const* sources
+ * @param size_t count
+ * @return GLuint
+ */
+static GLuint shader_submit(GLenum type, const char* const* sources, size_t count)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, count, sources, NULL);
+    glCompileShader(shader);
+
+    return shader;
+}
+
+/**
+ * Queue a program.
+ * A cached binary makes it ready right away, otherwise both stages
+ * start compiling and shader_manager_update takes care of the rest.
+ *
+ * @param shader_manager_T* manager
+ * @param const char* name, used in error messages.
+ * @param const char* const* vertex_sources
+ * @param size_t vertex_count
+ * @param const char* const* fragment_sources
+ * @param size_t fragment_count
+ * @return shader_program_T*
+ */
+shader_program_T* shader_manager_add(shader_manager_T* manager, const char* name,
+                                     const char* const* vertex_sources, size_t vertex_count,
+                                     const char* const* fragment_sources, size_t fragment_count)
+{
+    shader_program_T* program = calloc(1, sizeof(struct SHADER_PROGRAM_STRUCT));
+    program->name = strdup(name);
+    program->key = shader_cache_key(manager->cache, vertex_sources, vertex_count,
+                                    fragment_sources, fragment_count);
+
+    manager->programs = realloc(manager->programs, (manager->program_count + 1) * sizeof(shader_program_T*));
+    manager->programs[manager->program_count++] = program;
+
+    program->program = shader_cache_load(manager->cache, program->key);
+    if (program->program)
+    {
+        program->state = SHADER_PROGRAM_READY;
+        program->generation++;
+        return program;
+    }
+
+    program->vertex_shader = shader_submit(GL_VERTEX_SHADER, vertex_sources, vertex_count);
+    program->fragment_shader = shader_submit(GL_FRAGMENT_SHADER, fragment_sources, fragment_count);
+    program->state = SHADER_PROGRAM_COMPILING;
+
+    return program;
+}
+
+/**
+ * Without the extension any status query waits for the compiler,
+ * so everything simply counts as done.
+ *
+ * @param shader_manager_T* manager
+ * @param GLuint object
+ * @param int is_program
+ * @return int
+ */
+static int shader_manager_done(shader_manager_T* manager, GLuint object, int is_program)
+{
+    if (!manager->parallel)
+        return 1;
+
+    GLint done = 0;
+    if (is_program)
+        glGetProgramiv(object, GL_COMPLETION_STATUS_KHR, &done);
+    else
+        glGetShaderiv(object, GL_COMPLETION_STATUS_KHR, &done);
+
+    return done;
+}
+
+/**
+ * Check a shader for errors.
+ *
+ * @param shader_program_T* program
+ * @param GLuint shader
+ * @param const char* stage
+ * @return int 0 if it failed to compile.
+ */
+static int shader_check(shader_program_T* program, GLuint shader, const char* stage)
+{
+    GLint success = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+
+    if (!success)
+    {
+        char info_log[512];
+        glGetShaderInfoLog(shader, sizeof(info_log), NULL, info_log);
+        fprintf(stderr, "%s %s shader error: %s\n", program->name, stage, info_log);
+    }
+
+    return success;
+}
+
+/**
+ * Done with the stages, the program keeps what it needs.
+ *
+ * @param shader_program_T* program
+ */
+static void shader_program_release_shaders(shader_program_T* program)
+{
+    if (program->linking)
+    {
+        glDetachShader(program->linking, program->vertex_shader);
+        glDetachShader(program->linking, program->fragment_shader);
+    }
+
+    glDeleteShader(program->vertex_shader);
+    glDeleteShader(program->fragment_shader);
+    program->vertex_shader = 0;
+    program->fragment_shader = 0;
+}
+
+/**
+ * Give a rebuilt program the attribute locations of the one it
+ * replaces, so vertex arrays set up for the old one keep working.
+ *
+ * @param GLuint from
+ * @param GLuint to, not linked yet.
+ */
+static void shader_program_copy_attributes(GLuint from, GLuint to)
+{
+    GLint count = 0;
+    glGetProgramiv(from, GL_ACTIVE_ATTRIBUTES, &count);
+
+    for (GLint i = 0; i < count; i++)
+    {
+        char name[256];
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(from, i, sizeof(name), NULL, &size, &type, name);
+
+        GLint location = glGetAttribLocation(from, name);
+        if (location >= 0 && strncmp(name, "gl_", 3) != 0)
+            glBindAttribLocation(to, location, name);
+    }
+}
+
+/**
+ * Move a program along as far as it can go without waiting.
+ *
+ * @param shader_manager_T* manager
+ * @param shader_program_T* program
+ */
+static void shader_program_update(shader_manager_T* manager, shader_program_T* program)
+{
+    if (program->state == SHADER_PROGRAM_COMPILING)
+    {
+        if (!shader_manager_done(manager, program->vertex_shader, 0) ||
+            !shader_manager_done(manager, program->fragment_shader, 0))
+            return;
+
+        int ok = shader_check(program, program->vertex_shader, "vertex");
+        ok = shader_check(program, program->fragment_shader, "fragment") && ok;
+
+        if (!ok)
+        {
+            shader_program_release_shaders(program);
+            program->state = program->program ? SHADER_PROGRAM_READY : SHADER_PROGRAM_FAILED;
+            return;
+        }
+
+        program->linking = glCreateProgram();
+        shader_cache_prepare(manager->cache, program->linking);
+
+        if (program->program)
+            shader_program_copy_attributes(program->program, program->linking);
+
+        glAttachShader(program->linking, program->vertex_shader);
+        glAttachShader(program->linking, program->fragment_shader);
+        glLinkProgram(program->linking);
+        program->state = SHADER_PROGRAM_LINKING;
+    }
+
+    if (program->state == SHADER_PROGRAM_LINKING)
+    {
+        if (!shader_manager_done(manager, program->linking, 1))
+            return;
+
+        GLint success = 0;
+        glGetProgramiv(program->linking, GL_LINK_STATUS, &success);
+
+        if (!success)
+        {
+            char info_log[512];
+            glGetProgramInfoLog(program->linking, sizeof(info_log), NULL, info_log);
+            fprintf(stderr, "%s link error: %s\n", program->name, info_log);
+        }
+
+        shader_program_release_shaders(program);
+
+        if (success)
+        {
+            shader_cache_store(manager->cache, program->key, program->linking);
+
+            if (program->program)
+                glDeleteProgram(program->program);
+
+            program->program = program->linking;
+            program->generation++;
+        }
+        else
+        {
+            glDeleteProgram(program->linking);
+        }
+
+        program->linking = 0;
+        program->state = program->program ? SHADER_PROGRAM_READY : SHADER_PROGRAM_FAILED;
+    }
+}
+
+/**
+ * Rebuild a program from new sources in the background.
+ * The current program stays in use until the new one has linked,
+ * and is kept when it fails to build. Reloads never come from the
+ * shader cache since the attribute locations have to be carried over.
+ *
+ * @param shader_manager_T* manager
+ * @param shader_program_T* program
+ * @param const char* const* vertex_sources
+ * @param size_t vertex_count
+ * @param const char* const* fragment_sources
+ * @param size_t fragment_count
+ */
+void shader_manager_reload(shader_manager_T* manager, shader_program_T* program,
+                           const char* const* vertex_sources, size_t vertex_count,
+                           const char* const* fragment_sources, size_t fragment_count)
+{
+    /**
+     * Drop a build that is still in flight
+     */
+    if (program->vertex_shader || program->fragment_shader)
+        shader_program_release_shaders(program);
+
+    if (program->linking)
+    {
+        glDeleteProgram(program->linking);
+        program->linking = 0;
+    }
+
+    program->key = shader_cache_key(manager->cache, vertex_sources, vertex_count,
+                                    fragment_sources, fragment_count);
+    program->vertex_shader = shader_submit(GL_VERTEX_SHADER, vertex_sources, vertex_count);
+    program->fragment_shader = shader_submit(GL_FRAGMENT_SHADER, fragment_sources, fragment_count);
+    program->state = SHADER_PROGRAM_COMPILING;
+}
+
+/**
+ * Check on every program still being built, call once per frame.
+ *
+ * @param shader_manager_T* manager
+ * @return size_t amount of programs that are not done yet.
+ */
+size_t shader_manager_update(shader_manager_T* manager)
+{
+    size_t pending = 0;
+
+    for (size_t i = 0; i < manager->program_count; i++)
+    {
+        shader_program_T* program = manager->programs[i];
+        shader_program_update(manager, program);
+
+        if (program->state == SHADER_PROGRAM_COMPILING || program->state == SHADER_PROGRAM_LINKING)
+            pending++;
+    }
+
+    return pending;
+}
+
+/**
+ * Block until every program is ready or has failed.
+ *
+ * @param shader_manager_T* manager
+ */
+void shader_manager_finish(shader_manager_T* manager)
+{
+    int parallel = manager->parallel;
+
+    /**
+     * Querying without COMPLETION_STATUS simply waits on the driver
+     */
+    manager->parallel = 0;
+    shader_manager_update(manager);
+    manager->parallel = parallel;
+}
+
+/**
+ * Free the manager and all of its programs.
+ *
+ * @param shader_manager_T* manager
+ */
+void shader_manager_free(shader_manager_T* manager)
+{
+    for (size_t i = 0; i < manager->program_count; i++)
+    {
+        shader_program_T* program = manager->programs[i];
+
+        if (program->vertex_shader || program->fragment_shader)
+            shader_program_release_shaders(program);
+
+        if (program->linking)
+            glDeleteProgram(program->linking);
+
+        glDeleteProgram(program->program);
+        free(program->name);
+        free(program);
+    }
+
+    free(manager->programs);
+    free(manager);
+}
@@ -0,0 +1,315 @@
+#include "include/staging_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Create a staging pool. Must be called with a current GL context,
+ * the upload buffer is only created when it can stay mapped.
+ *
+ * @param size_t size, bytes of the upload buffer, 0 for heap blocks only.
+ * @return staging_pool_T*
+ */
+staging_pool_T* init_staging_pool(size_t size)
+{
+    staging_pool_T* pool = calloc(1, sizeof(struct STAGING_POOL_STRUCT));
+    pthread_mutex_init(&pool->lock, NULL);
+
+    if (size == 0 || !GLEW_ARB_buffer_storage)
+        return pool;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &pool->buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pool->buffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+    pool->mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (pool->mapped == NULL)
+    {
+        fprintf(stderr, "Could not map the staging buffer, decoding to the heap\n");
+        glDeleteBuffers(1, &pool->buffer);
+        pool->buffer = 0;
+        return pool;
+    }
+
+    pool->size = size;
+    pool->ranges = calloc(1, sizeof(struct STAGING_RANGE_STRUCT));
+    pool->ranges->size = size;
+
+    return pool;
+}
+
+/**
+ * Size class of a heap block.
+ *
+ * @param size_t size
+ * @return size_t
+ */
+static size_t staging_class(size_t size)
+{
+    size_t class = STAGING_POOL_MIN_CLASS;
+    while (class < STAGING_POOL_CLASSES - 1 && ((size_t) 1 << class) < size)
+        class++;
+
+    return class;
+}
+
+/**
+ * Carve `size` bytes out of the upload buffer, first fit.
+ * Expects the lock to be held.
+ *
+ * @param staging_pool_T* pool
+ * @param size_t size
+ * @param staging_block_T* block
+ * @return int 0 if no range is large enough.
+ */
+static int staging_pool_alloc_mapped(staging_pool_T* pool, size_t size, staging_block_T* block)
+{
+    size = (size + STAGING_POOL_ALIGNMENT - 1) & ~(size_t) (STAGING_POOL_ALIGNMENT - 1);
+
+    for (staging_range_T** link = &pool->ranges; *link; link = &(*link)->next)
+    {
+        staging_range_T* range = *link;
+        if (range->size < size)
+            continue;
+
+        block->offset = range->offset;
+        block->size = size;
+        block->data = pool->mapped + range->offset;
+        block->mapped = 1;
+
+        range->offset += size;
+        range->size -= size;
+
+        if (range->size == 0)
+        {
+            *link = range->next;
+            free(range);
+        }
+
+        pool->mapped_allocs++;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Give a range of the upload buffer back, merging it with its
+ * neighbours. Expects the lock to be held.
+ *
+ * @param staging_pool_T* pool
+ * @param size_t offset
+ * @param size_t size
+ */
+static void staging_pool_free_range(staging_pool_T* pool, size_t offset, size_t size)
+{
+    staging_range_T* prev = NULL;
+    staging_range_T* next = pool->ranges;
+
+    while (next && next->offset < offset)
+    {
+        prev = next;
+        next = next->next;
+    }
+
+    if (prev && prev->offset + prev->size == offset)
+    {
+        prev->size += size;
+
+        if (next && prev->offset + prev->size == next->offset)
+        {
+            prev->size += next->size;
+            prev->next = next->next;
+            free(next);
+        }
+
+        return;
+    }
+
+    if (next && offset + size == next->offset)
+    {
+        next->offset = offset;
+        next->size += size;
+        return;
+    }
+
+    staging_range_T* range = calloc(1, sizeof(struct STAGING_RANGE_STRUCT));
+    range->offset = offset;
+    range->size = size;
+    range->next = next;
+
+    if (prev)
+        prev->next = range;
+    else
+        pool->ranges = range;
+}
+
+/**
+ * Get memory to decode an image into, safe to call from any thread.
+ *
+ * @param staging_pool_T* pool
+ * @param size_t size
+ * @param int mapped, prefer the upload buffer. Only ask for it when
+ *        the CPU will not read the pixels back, mapped memory is
+ *        write combined.
+ * @param staging_block_T* block
+ * @return int 0 if out of memory.
+ */
+int staging_pool_alloc(staging_pool_T* pool, size_t size, int mapped, staging_block_T* block)
+{
+    memset(block, 0, sizeof(staging_block_T));
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (mapped && pool->mapped && staging_pool_alloc_mapped(pool, size, block))
+    {
+        pthread_mutex_unlock(&pool->lock);
+        return 1;
+    }
+
+    size_t class = staging_class(size);
+    block->size = (size_t) 1 << class;
+
+    if (block->size >= size && pool->cached_count[class] > 0)
+    {
+        block->data = pool->cached[class][--pool->cached_count[class]];
+        pool->heap_reuses++;
+        pthread_mutex_unlock(&pool->lock);
+        return 1;
+    }
+
+    pool->heap_allocs++;
+    pthread_mutex_unlock(&pool->lock);
+
+    /**
+     * Larger than the largest class, not worth keeping around
+     */
+    if (block->size < size)
+        block->size = size;
+
+    block->data = malloc(block->size);
+    return block->data != NULL;
+}
+
+/**
+ * Give a block back right away, the GPU must not be reading from it.
+ * Safe to call from any thread.
+ *
+ * @param staging_pool_T* pool
+ * @param staging_block_T* block
+ */
+void staging_pool_release(staging_pool_T* pool, staging_block_T* block)
+{
+    if (block->data == NULL)
+        return;
+
+    void* unused = NULL;
+    size_t class = staging_class(block->size);
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (block->mapped)
+        staging_pool_free_range(pool, block->offset, block->size);
+    else if (((size_t) 1 << class) == block->size && pool->cached_count[class] < STAGING_POOL_CACHED)
+        pool->cached[class][pool->cached_count[class]++] = block->data;
+    else
+        unused = block->data;
+
+    pthread_mutex_unlock(&pool->lock);
+
+    free(unused);
+    memset(block, 0, sizeof(staging_block_T));
+}
+
+/**
+ * Give a block back once the GPU has finished the uploads issued
+ * from it so far. GL thread only.
+ *
+ * @param staging_pool_T* pool
+ * @param staging_block_T* block
+ */
+void staging_pool_retire(staging_pool_T* pool, staging_block_T* block)
+{
+    if (!block->mapped)
+    {
+        staging_pool_release(pool, block);
+        return;
+    }
+
+    staging_retired_T* retired = calloc(1, sizeof(struct STAGING_RETIRED_STRUCT));
+    retired->block = *block;
+    retired->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    if (pool->retired_tail)
+        pool->retired_tail->next = retired;
+    else
+        pool->retired = retired;
+    pool->retired_tail = retired;
+
+    memset(block, 0, sizeof(staging_block_T));
+}
+
+/**
+ * Recycle retired blocks the GPU is done with, never waits.
+ * GL thread only, call once per frame.
+ *
+ * @param staging_pool_T* pool
+ */
+void staging_pool_update(staging_pool_T* pool)
+{
+    while (pool->retired)
+    {
+        staging_retired_T* retired = pool->retired;
+
+        GLenum status = glClientWaitSync(retired->fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return;
+
+        glDeleteSync(retired->fence);
+        staging_pool_release(pool, &retired->block);
+
+        pool->retired = retired->next;
+        if (pool->retired == NULL)
+            pool->retired_tail = NULL;
+        free(retired);
+    }
+}
+
+/**
+ * Free the pool, no block may be in use anymore.
+ *
+ * @param staging_pool_T* pool
+ */
+void staging_pool_free(staging_pool_T* pool)
+{
+    while (pool->retired)
+    {
+        staging_retired_T* retired = pool->retired;
+        pool->retired = retired->next;
+        glDeleteSync(retired->fence);
+        free(retired);
+    }
+
+    while (pool->ranges)
+    {
+        staging_range_T* range = pool->ranges;
+        pool->ranges = range->next;
+        free(range);
+    }
+
+    for (size_t i = 0; i < STAGING_POOL_CLASSES; i++)
+    {
+        for (size_t j = 0; j < pool->cached_count[i]; j++)
+            free(pool->cached[i][j]);
+    }
+
+    if (pool->buffer)
+        glDeleteBuffers(1, &pool->buffer);
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
@@ -0,0 +1,159 @@
+#include "include/stream_buffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/**
+ * Create a stream buffer with STREAM_BUFFER_REGIONS regions of
+ * `region_size` bytes each.
+ *
+ * @param GLenum target, for example GL_ARRAY_BUFFER.
+ * @param size_t region_size
+ * @return stream_buffer_T*
+ */
+stream_buffer_T* init_stream_buffer(GLenum target, size_t region_size)
+{
+    stream_buffer_T* stream = calloc(1, sizeof(struct STREAM_BUFFER_STRUCT));
+    stream->target = target;
+    stream->region_size = region_size;
+    stream->region = STREAM_BUFFER_REGIONS - 1;
+    stream->persistent = GLEW_ARB_buffer_storage;
+
+    size_t size = region_size * STREAM_BUFFER_REGIONS;
+
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(target, stream->buffer);
+
+    if (stream->persistent)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, size, NULL, flags);
+        stream->mapped = glMapBufferRange(target, 0, size, flags);
+    }
+    else
+    {
+        glBufferData(target, size, NULL, GL_STREAM_DRAW);
+    }
+
+    return stream;
+}
+
+/**
+ * Move on to the next region, waiting only if the GPU is still
+ * reading it from three frames ago.
+ *
+ * @param stream_buffer_T* stream
+ */
+void stream_buffer_begin_frame(stream_buffer_T* stream)
+{
+    stream->region = (stream->region + 1) % STREAM_BUFFER_REGIONS;
+    stream->offset = 0;
+
+    GLsync fence = stream->fences[stream->region];
+    if (fence)
+    {
+        GLenum status = glClientWaitSync(fence, 0, 0);
+
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            stream->stalls++;
+
+            do
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            while (status == GL_TIMEOUT_EXPIRED);
+        }
+
+        glDeleteSync(fence);
+        stream->fences[stream->region] = NULL;
+    }
+
+    if (!stream->persistent)
+    {
+        /**
+         * The fence already guarantees the GPU is done with this region,
+         * so the driver does not need to synchronize the mapping.
+         */
+        glBindBuffer(stream->target, stream->buffer);
+        stream->mapped = glMapBufferRange(stream->target,
+                                          stream->region * stream->region_size,
+                                          stream->region_size,
+                                          GL_MAP_WRITE_BIT |
+                                          GL_MAP_INVALIDATE_RANGE_BIT |
+                                          GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+}
+
+/**
+ * Reserve `size` bytes in the current region.
+ *
+ * @param stream_buffer_T* stream
+ * @param size_t size
+ * @param size_t alignment, a power of two.
+ * @param size_t* offset, set to the offset of the memory inside the buffer.
+ * @return void* to write to, NULL when the region is full.
+ */
+void* stream_buffer_alloc(stream_buffer_T* stream, size_t size, size_t alignment, size_t* offset)
+{
+    size_t start = (stream->offset + alignment - 1) & ~(alignment - 1);
+
+    if (start + size > stream->region_size || stream->mapped == NULL)
+        return NULL;
+
+    stream->offset = start + size;
+
+    size_t region_start = stream->region * stream->region_size;
+    *offset = region_start + start;
+
+    /**
+     * A persistent mapping covers the whole buffer, the fallback
+     * only maps the current region.
+     */
+    if (stream->persistent)
+        return (char*) stream->mapped + region_start + start;
+
+    return (char*) stream->mapped + start;
+}
+
+/**
+ * Done writing this frame, call before drawing from the memory.
+ * Only the fallback path has anything to do here.
+ *
+ * @param stream_buffer_T* stream
+ */
+void stream_buffer_commit(stream_buffer_T* stream)
+{
+    if (stream->persistent || stream->mapped == NULL)
+        return;
+
+    glBindBuffer(stream->target, stream->buffer);
+    glUnmapBuffer(stream->target);
+    stream->mapped = NULL;
+}
+
+/**
+ * Fence the region once the draws reading it have been submitted.
+ *
+ * @param stream_buffer_T* stream
+ */
+void stream_buffer_end_frame(stream_buffer_T* stream)
+{
+    stream_buffer_commit(stream);
+    stream->fences[stream->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/**
+ * Free a stream buffer.
+ *
+ * @param stream_buffer_T* stream
+ */
+void stream_buffer_free(stream_buffer_T* stream)
+{
+    for (size_t i = 0; i < STREAM_BUFFER_REGIONS; i++)
+    {
+        if (stream->fences[i])
+            glDeleteSync(stream->fences[i]);
+    }
+
+    glDeleteBuffers(1, &stream->buffer);
+    free(stream);
+}
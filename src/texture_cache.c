@@ -0,0 +1,863 @@
+#include "include/texture_cache.h"
+#include "include/hash.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEXTURE_CACHE_INITIAL_CAPACITY 64
+
+#define SLOT_EMPTY 0
+#define SLOT_USED 1
+#define SLOT_DELETED 2
+
+
+/**
+ * Find the slot holding `hash` & `key` / `image`.
+ * Linear probing, the capacity is always a power of two.
+ *
+ * @param texture_cache_slot_T* slots
+ * @param size_t capacity
+ * @param uint64_t hash
+ * @param const char* key, compared when not NULL.
+ * @param texture_image_T* image, compared when not NULL.
+ * @return texture_cache_slot_T* or NULL
+ */
+static texture_cache_slot_T* slots_find(texture_cache_slot_T* slots, size_t capacity,
+                                        uint64_t hash, const char* key, texture_image_T* image)
+{
+    size_t mask = capacity - 1;
+
+    for (size_t i = hash & mask, n = 0; n < capacity; i = (i + 1) & mask, n++)
+    {
+        texture_cache_slot_T* slot = &slots[i];
+
+        if (slot->state == SLOT_EMPTY)
+            return NULL;
+
+        if (slot->state != SLOT_USED || slot->hash != hash)
+            continue;
+
+        if (key && strcmp(slot->key, key) != 0)
+            continue;
+
+        if (image && slot->image != image)
+            continue;
+
+        return slot;
+    }
+
+    return NULL;
+}
+
+/**
+ * Put an entry in the first free slot, no duplicate check.
+ *
+ * @param texture_cache_slot_T* slots
+ * @param size_t capacity
+ * @param uint64_t hash
+ * @param char* key
+ * @param texture_T* texture
+ * @param texture_image_T* image
+ * @return int 1 if a previously empty slot was used, 0 for a tombstone.
+ */
+static int slots_insert(texture_cache_slot_T* slots, size_t capacity,
+                        uint64_t hash, char* key, texture_T* texture, texture_image_T* image)
+{
+    size_t mask = capacity - 1;
+    size_t i = hash & mask;
+
+    while (slots[i].state == SLOT_USED)
+        i = (i + 1) & mask;
+
+    int was_empty = slots[i].state == SLOT_EMPTY;
+    slots[i].hash = hash;
+    slots[i].key = key;
+    slots[i].texture = texture;
+    slots[i].image = image;
+    slots[i].state = SLOT_USED;
+
+    return was_empty;
+}
+
+/**
+ * Make room for one more entry, rehashing when over 70% full.
+ * Tombstones count as full since they lengthen probe sequences,
+ * and are dropped by the rehash.
+ *
+ * @param texture_cache_slot_T** slots
+ * @param size_t* capacity
+ * @param size_t* used
+ */
+static void slots_reserve(texture_cache_slot_T** slots, size_t* capacity, size_t* used)
+{
+    if ((*used + 1) * 10 <= *capacity * 7)
+        return;
+
+    size_t live = 0;
+    for (size_t i = 0; i < *capacity; i++)
+        live += (*slots)[i].state == SLOT_USED;
+
+    size_t new_capacity = *capacity;
+    while ((live + 1) * 10 > new_capacity * 5)
+        new_capacity *= 2;
+
+    texture_cache_slot_T* new_slots = calloc(new_capacity, sizeof(struct TEXTURE_CACHE_SLOT_STRUCT));
+
+    for (size_t i = 0; i < *capacity; i++)
+    {
+        texture_cache_slot_T* slot = &(*slots)[i];
+        if (slot->state == SLOT_USED)
+            slots_insert(new_slots, new_capacity, slot->hash, slot->key, slot->texture, slot->image);
+    }
+
+    free(*slots);
+    *slots = new_slots;
+    *capacity = new_capacity;
+    *used = live;
+}
+
+/**
+ * Create a new texture cache on top of a texture loader.
+ *
+ * @param texture_loader_T* loader
+ * @param gpu_memory_T* memory, textures are counted against its budget, may be NULL.
+ * @return texture_cache_T*
+ */
+texture_cache_T* init_texture_cache(texture_loader_T* loader, gpu_memory_T* memory)
+{
+    texture_cache_T* cache = calloc(1, sizeof(struct TEXTURE_CACHE_STRUCT));
+    cache->loader = loader;
+    cache->memory = memory;
+
+    cache->paths_capacity = TEXTURE_CACHE_INITIAL_CAPACITY;
+    cache->paths = calloc(cache->paths_capacity, sizeof(struct TEXTURE_CACHE_SLOT_STRUCT));
+
+    cache->contents_capacity = TEXTURE_CACHE_INITIAL_CAPACITY;
+    cache->contents = calloc(cache->contents_capacity, sizeof(struct TEXTURE_CACHE_SLOT_STRUCT));
+
+    cache->ids_capacity = TEXTURE_CACHE_INITIAL_CAPACITY;
+    cache->ids = calloc(cache->ids_capacity, sizeof(struct TEXTURE_CACHE_SLOT_STRUCT));
+
+    return cache;
+}
+
+/**
+ * Unlink a texture from the LRU list.
+ *
+ * @param texture_cache_T* cache
+ * @param texture_image_T* image
+ */
+static void texture_cache_unlink(texture_cache_T* cache, texture_image_T* image)
+{
+    if (image->prev)
+        image->prev->next = image->next;
+    else
+        cache->lru_head = image->next;
+
+    if (image->next)
+        image->next->prev = image->prev;
+    else
+        cache->lru_tail = image->prev;
+
+    image->prev = NULL;
+    image->next = NULL;
+}
+
+/**
+ * Put a texture at the front of the LRU list.
+ *
+ * @param texture_cache_T* cache
+ * @param texture_image_T* image
+ */
+static void texture_cache_link(texture_cache_T* cache, texture_image_T* image)
+{
+    image->prev = NULL;
+    image->next = cache->lru_head;
+
+    if (cache->lru_head)
+        cache->lru_head->prev = image;
+    else
+        cache->lru_tail = image;
+
+    cache->lru_head = image;
+}
+
+/**
+ * Change the size a texture is counted with.
+ *
+ * @param texture_cache_T* cache
+ * @param texture_image_T* image
+ * @param size_t bytes
+ */
+static void texture_cache_account(texture_cache_T* cache, texture_image_T* image, size_t bytes)
+{
+    if (cache->memory)
+    {
+        gpu_memory_remove(cache->memory, GPU_MEMORY_TEXTURE, image->bytes);
+        gpu_memory_add(cache->memory, GPU_MEMORY_TEXTURE, bytes);
+    }
+
+    image->bytes = bytes;
+}
+
+/**
+ * Measure a texture after its storage changed.
+ * Binds it on the active unit.
+ *
+ * @param texture_cache_T* cache
+ * @param texture_image_T* image
+ */
+static void texture_cache_measure(texture_cache_T* cache, texture_image_T* image)
+{
+    texture_cache_account(cache, image, gpu_memory_texture_size(GL_TEXTURE_2D, image->id));
+
+    if (!image->resident)
+        return;
+
+    GLint width = 0, height = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+    image->width = (unsigned int) width << image->lod;
+    image->height = (unsigned int) height << image->lod;
+
+    if (image->lod == 0)
+        image->full_bytes = image->bytes;
+}
+
+/**
+ * Remember `path` as pointing to `texture`.
+ *
+ * @param texture_cache_T* cache
+ * @param uint64_t hash
+ * @param const char* path
+ * @param texture_T* texture
+ */
+static void texture_cache_insert_path(texture_cache_T* cache, uint64_t hash,
+                                      const char* path, texture_T* texture)
+{
+    slots_reserve(&cache->paths, &cache->paths_capacity, &cache->paths_used);
+    cache->paths_used += slots_insert(cache->paths, cache->paths_capacity,
+                                      hash, strdup(path), texture, NULL);
+}
+
+/**
+ * Resolve a path the way it is keyed in the path table.
+ *
+ * @param const char* path
+ * @param char* canonical, PATH_MAX bytes.
+ */
+static void texture_cache_canonical(const char* path, char* canonical)
+{
+    if (realpath(path, canonical) == NULL)
+        snprintf(canonical, PATH_MAX, "%s", path);
+}
+
+/**
+ * Check two files hold the same bytes.
+ *
+ * @param const char* a
+ * @param const char* b
+ * @return int 1 if both could be read and are equal.
+ */
+static int texture_cache_files_equal(const char* a, const char* b)
+{
+    FILE* fa = fopen(a, "rb");
+    FILE* fb = fopen(b, "rb");
+    int equal = fa != NULL && fb != NULL;
+
+    unsigned char buffer_a[16384];
+    unsigned char buffer_b[16384];
+
+    while (equal)
+    {
+        size_t n = fread(buffer_a, 1, sizeof(buffer_a), fa);
+        size_t m = fread(buffer_b, 1, sizeof(buffer_b), fb);
+
+        if (n != m || memcmp(buffer_a, buffer_b, n) != 0 || ferror(fa) || ferror(fb))
+            equal = 0;
+
+        if (n == 0)
+            break;
+    }
+
+    if (fa)
+        fclose(fa);
+    if (fb)
+        fclose(fb);
+
+    return equal;
+}
+
+/**
+ * Find a texture with the same contents as the file at `canonical`.
+ * The hash only narrows it down, a texture is shared only when its
+ * file has the same size and bytes.
+ *
+ * @param texture_cache_T* cache
+ * @param uint64_t hash
+ * @param size_t size
+ * @param const char* canonical
+ * @return texture_image_T* or NULL
+ */
+static texture_image_T* texture_cache_find_content(texture_cache_T* cache, uint64_t hash,
+                                                   size_t size, const char* canonical)
+{
+    size_t mask = cache->contents_capacity - 1;
+
+    for (size_t i = hash & mask, n = 0; n < cache->contents_capacity; i = (i + 1) & mask, n++)
+    {
+        texture_cache_slot_T* slot = &cache->contents[i];
+
+        if (slot->state == SLOT_EMPTY)
+            return NULL;
+
+        if (slot->state != SLOT_USED || slot->hash != hash)
+            continue;
+
+        texture_image_T* image = slot->image;
+        if (image->content_size == size && texture_cache_files_equal(image->path, canonical))
+            return image;
+    }
+
+    return NULL;
+}
+
+/**
+ * Start loading the file at `canonical` into a new GL texture.
+ *
+ * @param texture_cache_T* cache
+ * @param const char* canonical
+ * @param int hashed, 0 if the file could not be read, it is then never shared by contents.
+ * @param uint64_t content_hash
+ * @param size_t content_size
+ * @return texture_image_T*
+ */
+static texture_image_T* texture_cache_load_image(texture_cache_T* cache, const char* canonical,
+                                                 int hashed, uint64_t content_hash, size_t content_size)
+{
+    texture_image_T* image = calloc(1, sizeof(struct TEXTURE_IMAGE_STRUCT));
+    image->id = texture_loader_get_texture(cache->loader, canonical);
+    image->content_hash = content_hash;
+    image->content_size = content_size;
+    image->refs = 1;
+    image->path = strdup(canonical);
+    image->resident = 1;
+    image->loading = 1;
+    image->last_used = cache->frame;
+    texture_cache_link(cache, image);
+
+    slots_reserve(&cache->ids, &cache->ids_capacity, &cache->ids_used);
+    cache->ids_used += slots_insert(cache->ids, cache->ids_capacity, image->id, NULL, NULL, image);
+
+    if (hashed)
+    {
+        slots_reserve(&cache->contents, &cache->contents_capacity, &cache->contents_used);
+        cache->contents_used += slots_insert(cache->contents, cache->contents_capacity,
+                                             content_hash, NULL, NULL, image);
+    }
+
+    return image;
+}
+
+/**
+ * Drop the reference one path held on an image. The GL texture is
+ * deleted with the last one, otherwise the image is decoded from one
+ * of the paths still using it from now on.
+ * The path must already point elsewhere or be out of the path table.
+ *
+ * @param texture_cache_T* cache
+ * @param texture_image_T* image
+ * @param const char* path
+ */
+static void texture_cache_drop_image(texture_cache_T* cache, texture_image_T* image, const char* path)
+{
+    if (--image->refs > 0)
+    {
+        if (strcmp(image->path, path) != 0)
+            return;
+
+        for (size_t i = 0; i < cache->paths_capacity; i++)
+        {
+            texture_cache_slot_T* slot = &cache->paths[i];
+            if (slot->state != SLOT_USED || slot->texture->image != image)
+                continue;
+
+            free(image->path);
+            image->path = strdup(slot->key);
+            return;
+        }
+
+        return;
+    }
+
+    texture_cache_slot_T* slot = slots_find(cache->contents, cache->contents_capacity,
+                                            image->content_hash, NULL, image);
+    if (slot)
+        slot->state = SLOT_DELETED;
+
+    slot = slots_find(cache->ids, cache->ids_capacity, image->id, NULL, image);
+    if (slot)
+        slot->state = SLOT_DELETED;
+
+    texture_cache_unlink(cache, image);
+    texture_cache_account(cache, image, 0);
+
+    texture_loader_cancel(cache->loader, image->id);
+    glDeleteTextures(1, &image->id);
+    free(image->path);
+    free(image);
+}
+
+/**
+ * Get a shared texture for `path`, loading it on first use.
+ * The same file gives back the same texture with its reference count
+ * increased, another file with identical contents gets its own texture
+ * sharing the same image.
+ *
+ * @param texture_cache_T* cache
+ * @param const char* path
+ * @return texture_T*
+ */
+texture_T* texture_cache_get(texture_cache_T* cache, const char* path)
+{
+    char canonical[PATH_MAX];
+    texture_cache_canonical(path, canonical);
+
+    uint64_t path_hash = hash_string(canonical);
+
+    texture_cache_slot_T* slot = slots_find(cache->paths, cache->paths_capacity,
+                                            path_hash, canonical, NULL);
+    if (slot)
+    {
+        cache->hits++;
+        slot->texture->refs++;
+        return slot->texture;
+    }
+
+    /**
+     * Unknown path, the contents might still be something we have,
+     * this costs reading the file but no decode and no GPU memory.
+     */
+    uint64_t content_hash = 0;
+    size_t content_size = 0;
+    int hashed = hash_file(canonical, &content_hash, &content_size);
+
+    texture_image_T* image = NULL;
+    if (hashed)
+        image = texture_cache_find_content(cache, content_hash, content_size, canonical);
+
+    if (image)
+    {
+        cache->content_hits++;
+        image->refs++;
+    }
+    else
+    {
+        cache->misses++;
+        image = texture_cache_load_image(cache, canonical, hashed, content_hash, content_size);
+    }
+
+    texture_T* texture = calloc(1, sizeof(struct TEXTURE_STRUCT));
+    texture->id = image->id;
+    texture->refs = 1;
+    texture->path = strdup(canonical);
+    texture->image = image;
+
+    texture_cache_insert_path(cache, path_hash, canonical, texture);
+
+    return texture;
+}
+
+/**
+ * The file behind a texture changed, decode it again.
+ * When it is the only path using its image the new contents are swapped
+ * into the same GL texture once ready. Otherwise the other paths keep
+ * the old contents and this one moves to an image of its own, shared
+ * with any file that already has the new contents.
+ *
+ * @param texture_cache_T* cache
+ * @param const char* path
+ * @return int 0 if no texture was loaded from `path` or it cannot be read.
+ */
+int texture_cache_reload(texture_cache_T* cache, const char* path)
+{
+    char canonical[PATH_MAX];
+    texture_cache_canonical(path, canonical);
+
+    texture_cache_slot_T* slot = slots_find(cache->paths, cache->paths_capacity,
+                                            hash_string(canonical), canonical, NULL);
+    if (slot == NULL)
+        return 0;
+
+    texture_T* texture = slot->texture;
+    texture_image_T* image = texture->image;
+
+    uint64_t content_hash = 0;
+    size_t content_size = 0;
+    if (!hash_file(canonical, &content_hash, &content_size))
+        return 0;
+
+    /**
+     * Saved without changes
+     */
+    if (content_hash == image->content_hash && content_size == image->content_size)
+        return 1;
+
+    cache->reloads++;
+
+    if (image->refs > 1)
+    {
+        texture_image_T* shared = texture_cache_find_content(cache, content_hash, content_size, canonical);
+
+        if (shared)
+            shared->refs++;
+        else
+            shared = texture_cache_load_image(cache, canonical, 1, content_hash, content_size);
+
+        texture->image = shared;
+        texture->id = shared->id;
+        texture_cache_drop_image(cache, image, canonical);
+
+        return 1;
+    }
+
+    slot = slots_find(cache->contents, cache->contents_capacity, image->content_hash, NULL, image);
+    if (slot)
+        slot->state = SLOT_DELETED;
+
+    image->content_hash = content_hash;
+    image->content_size = content_size;
+    slots_reserve(&cache->contents, &cache->contents_capacity, &cache->contents_used);
+    cache->contents_used += slots_insert(cache->contents, cache->contents_capacity,
+                                         content_hash, NULL, NULL, image);
+
+    /**
+     * An evicted texture decodes the new file once it is used again
+     */
+    image->failed = 0;
+
+    if (!image->resident)
+        return 1;
+
+    if (image->lod > 0)
+        texture_loader_resize(cache->loader, image->id, canonical, image->lod);
+    else
+        texture_loader_reload(cache->loader, image->id, canonical);
+
+    image->loading++;
+
+    return 1;
+}
+
+/**
+ * Mark a texture as used this frame. A texture that was shrunk or
+ * evicted is loaded again at the largest size that fits the budget.
+ *
+ * @param texture_cache_T* cache
+ * @param texture_T* texture
+ */
+void texture_cache_touch(texture_cache_T* cache, texture_T* texture)
+{
+    texture_image_T* image = texture->image;
+    image->last_used = cache->frame;
+
+    if (cache->lru_head != image)
+    {
+        texture_cache_unlink(cache, image);
+        texture_cache_link(cache, image);
+    }
+
+    if (image->loading || image->failed || (image->resident && image->lod == 0))
+        return;
+
+    size_t headroom = cache->memory ? gpu_memory_headroom(cache->memory) : SIZE_MAX;
+    size_t current = image->resident ? image->lod : MIPMAP_MAX_LEVELS;
+    size_t lod = 0;
+
+    /**
+     * Never loaded at full size, so its size is unknown
+     */
+    if (image->full_bytes)
+    {
+        while (lod < current && (image->full_bytes >> (2 * lod)) > image->bytes &&
+               (image->full_bytes >> (2 * lod)) - image->bytes > headroom)
+            lod++;
+
+        if (lod >= current)
+            return;
+    }
+
+    /**
+     * The bytes are counted right away so the budget holds while it
+     * loads, texture_cache_update measures what it really takes.
+     */
+    image->loading++;
+    texture_cache_account(cache, image, image->full_bytes >> (2 * lod));
+    texture_loader_resize(cache->loader, image->id, image->path, lod);
+    cache->restores++;
+}
+
+/**
+ * Free memory from the least recently used textures until back within
+ * budget. Each is shrunk by as many mip levels as needed, down to
+ * TEXTURE_CACHE_MIN_SIZE, and evicted when that is not enough.
+ * Binds textures on the active unit.
+ *
+ * @param texture_cache_T* cache
+ */
+static void texture_cache_evict(texture_cache_T* cache)
+{
+    size_t over = gpu_memory_over_budget(cache->memory);
+
+    for (texture_image_T* image = cache->lru_tail; image && over > 0; image = image->prev)
+    {
+        if (image->last_used + TEXTURE_CACHE_IDLE_FRAMES > cache->frame)
+            break;
+
+        if (image->loading || !image->resident || image->bytes == 0)
+            continue;
+
+        size_t before = image->bytes;
+        size_t lod = image->lod;
+        size_t estimate = before;
+
+        while (estimate > 0 && before - estimate < over &&
+               (image->width >> (lod + 1)) >= TEXTURE_CACHE_MIN_SIZE &&
+               (image->height >> (lod + 1)) >= TEXTURE_CACHE_MIN_SIZE)
+        {
+            lod++;
+            estimate /= 4;
+        }
+
+        if (lod > image->lod && before - estimate >= over)
+        {
+            image->loading++;
+            texture_cache_account(cache, image, estimate);
+            texture_loader_resize(cache->loader, image->id, image->path, lod);
+            cache->shrinks++;
+        }
+        else
+        {
+            texture_loader_evict(cache->loader, image->id);
+            image->resident = 0;
+            texture_cache_measure(cache, image);
+            cache->evictions++;
+        }
+
+        over -= before - image->bytes < over ? before - image->bytes : over;
+    }
+}
+
+/**
+ * Upload what the loader finished, measure what changed & keep to the
+ * memory budget. Call this once per frame from the GL thread, it binds
+ * textures on the active unit.
+ *
+ * @param texture_cache_T* cache
+ * @return size_t amount of textures whose storage changed.
+ */
+size_t texture_cache_update(texture_cache_T* cache)
+{
+    texture_loader_T* loader = cache->loader;
+    texture_loader_update(loader);
+    size_t changed = loader->upload_count;
+
+    for (size_t i = 0; i < loader->upload_count; i++)
+    {
+        texture_upload_T* upload = &loader->uploads[i];
+        texture_cache_slot_T* slot = slots_find(cache->ids, cache->ids_capacity,
+                                                upload->texture, NULL, NULL);
+        if (slot == NULL)
+            continue;
+
+        texture_image_T* image = slot->image;
+        if (image->loading)
+            image->loading--;
+
+        /**
+         * A failed job left the texture as it was
+         */
+        if (!upload->failed)
+        {
+            image->lod = upload->lod;
+            image->resident = 1;
+        }
+        else if (!image->resident)
+        {
+            image->failed = 1;
+        }
+
+        texture_cache_measure(cache, image);
+    }
+
+    loader->upload_count = 0;
+
+    if (cache->memory)
+    {
+        size_t evictions = cache->evictions;
+        texture_cache_evict(cache);
+        changed += cache->evictions - evictions;
+    }
+
+    cache->frame++;
+
+    return changed;
+}
+
+/**
+ * Take another reference to a texture.
+ *
+ * @param texture_T* texture
+ */
+void texture_cache_retain(texture_T* texture)
+{
+    texture->refs++;
+}
+
+/**
+ * Drop a reference, the GL texture is deleted with the last one of
+ * every path sharing it.
+ *
+ * @param texture_cache_T* cache
+ * @param texture_T* texture
+ */
+void texture_cache_release(texture_cache_T* cache, texture_T* texture)
+{
+    if (--texture->refs > 0)
+        return;
+
+    texture_cache_slot_T* slot = slots_find(cache->paths, cache->paths_capacity,
+                                            hash_string(texture->path), texture->path, NULL);
+    if (slot)
+    {
+        free(slot->key);
+        slot->key = NULL;
+        slot->state = SLOT_DELETED;
+    }
+
+    texture_cache_drop_image(cache, texture->image, texture->path);
+    free(texture->path);
+    free(texture);
+}
+
+/**
+ * Request a whole list of textures at once. They are all queued before
+ * the first one is uploaded, so they decode in parallel on every loader
+ * worker and get uploaded over the next frames, smallest first.
+ * Duplicates share a texture like with texture_cache_get.
+ *
+ * @param texture_cache_T* cache
+ * @param const char* const* paths
+ * @param size_t count
+ * @return texture_batch_T*, free with texture_batch_free.
+ */
+texture_batch_T* texture_cache_load_batch(texture_cache_T* cache, const char* const* paths, size_t count)
+{
+    texture_batch_T* batch = calloc(1, sizeof(struct TEXTURE_BATCH_STRUCT));
+    batch->textures = calloc(count ? count : 1, sizeof(texture_T*));
+    batch->count = count;
+
+    for (size_t i = 0; i < count; i++)
+        batch->textures[i] = texture_cache_get(cache, paths[i]);
+
+    return batch;
+}
+
+/**
+ * Count how much of a batch has been uploaded, call after
+ * texture_cache_update.
+ *
+ * @param texture_batch_T* batch
+ * @return int 1 once every texture has finished loading.
+ */
+int texture_batch_update(texture_batch_T* batch)
+{
+    batch->loaded = 0;
+    batch->bytes = 0;
+
+    for (size_t i = 0; i < batch->count; i++)
+    {
+        texture_image_T* image = batch->textures[i]->image;
+        if (image->loading)
+            continue;
+
+        batch->loaded++;
+        batch->bytes += image->bytes;
+    }
+
+    return batch->loaded == batch->count;
+}
+
+/**
+ * Release every texture of a batch.
+ *
+ * @param texture_cache_T* cache
+ * @param texture_batch_T* batch
+ */
+void texture_batch_free(texture_cache_T* cache, texture_batch_T* batch)
+{
+    for (size_t i = 0; i < batch->count; i++)
+        texture_cache_release(cache, batch->textures[i]);
+
+    free(batch->textures);
+    free(batch);
+}
+
+/**
+ * Print hit / miss counters.
+ *
+ * @param texture_cache_T* cache
+ * @param FILE* out
+ */
+void texture_cache_print_stats(texture_cache_T* cache, FILE* out)
+{
+    fprintf(out, "Texture cache: %zu hits, %zu content hits, %zu misses, %zu reloads\n",
+            cache->hits, cache->content_hits, cache->misses, cache->reloads);
+
+    if (cache->memory)
+        fprintf(out, "Texture budget: %zu shrinks, %zu evictions, %zu restores\n",
+                cache->shrinks, cache->evictions, cache->restores);
+}
+
+/**
+ * Free the cache and every texture still in it.
+ *
+ * @param texture_cache_T* cache
+ */
+void texture_cache_free(texture_cache_T* cache)
+{
+    for (size_t i = 0; i < cache->paths_capacity; i++)
+    {
+        texture_cache_slot_T* slot = &cache->paths[i];
+        if (slot->state != SLOT_USED)
+            continue;
+
+        free(slot->key);
+        free(slot->texture->path);
+        free(slot->texture);
+    }
+
+    /**
+     * Every image is in the id table exactly once, however many
+     * paths share it.
+     */
+    for (size_t i = 0; i < cache->ids_capacity; i++)
+    {
+        texture_cache_slot_T* slot = &cache->ids[i];
+        if (slot->state != SLOT_USED)
+            continue;
+
+        texture_image_T* image = slot->image;
+        texture_cache_account(cache, image, 0);
+        glDeleteTextures(1, &image->id);
+        free(image->path);
+        free(image);
+    }
+
+    free(cache->paths);
+    free(cache->contents);
+    free(cache->ids);
+    free(cache);
+}
@@ -0,0 +1,337 @@
+#include "include/texture_compress.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+/**
+ * Check if the driver can sample the formats we encode.
+ * Needs a current GL context.
+ *
+ * @return int
+ */
+int texture_compress_supported(void)
+{
+    return GLEW_EXT_texture_compression_s3tc;
+}
+
+/**
+ * BC1 for fully opaque images, BC3 when there is any alpha.
+ *
+ * @param const image_T* image
+ * @return GLenum
+ */
+GLenum texture_compress_choose_format(const image_T* image)
+{
+    const unsigned char* px = (const unsigned char*) image->pixels;
+    size_t count = (size_t) image->width * image->height;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (px[i * 4 + 3] != 255)
+            return TEXTURE_COMPRESS_BC3;
+    }
+
+    return TEXTURE_COMPRESS_BC1;
+}
+
+/**
+ * Amount of bytes needed for an image of the given size.
+ *
+ * @param GLenum format
+ * @param unsigned int width
+ * @param unsigned int height
+ * @return size_t
+ */
+size_t texture_compress_size(GLenum format, unsigned int width, unsigned int height)
+{
+    size_t blocks = (size_t) ((width + 3) / 4) * ((height + 3) / 4);
+    return blocks * (format == TEXTURE_COMPRESS_BC1 ? 8 : 16);
+}
+
+/**
+ * Per channel min & max of a 4x4 block of RGBA8 pixels.
+ *
+ * @param const unsigned char* block, 64 bytes.
+ * @param unsigned char* lo, 4 bytes.
+ * @param unsigned char* hi, 4 bytes.
+ */
+static void block_bounds(const unsigned char* block, unsigned char* lo, unsigned char* hi)
+{
+#if defined(__SSE2__)
+    __m128i r0 = _mm_loadu_si128((const __m128i*) (block + 0));
+    __m128i r1 = _mm_loadu_si128((const __m128i*) (block + 16));
+    __m128i r2 = _mm_loadu_si128((const __m128i*) (block + 32));
+    __m128i r3 = _mm_loadu_si128((const __m128i*) (block + 48));
+
+    __m128i mn = _mm_min_epu8(_mm_min_epu8(r0, r1), _mm_min_epu8(r2, r3));
+    __m128i mx = _mm_max_epu8(_mm_max_epu8(r0, r1), _mm_max_epu8(r2, r3));
+
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+
+    uint32_t l = (uint32_t) _mm_cvtsi128_si32(mn);
+    uint32_t h = (uint32_t) _mm_cvtsi128_si32(mx);
+    memcpy(lo, &l, 4);
+    memcpy(hi, &h, 4);
+#elif defined(__ARM_NEON)
+    uint8x16_t r0 = vld1q_u8(block + 0);
+    uint8x16_t r1 = vld1q_u8(block + 16);
+    uint8x16_t r2 = vld1q_u8(block + 32);
+    uint8x16_t r3 = vld1q_u8(block + 48);
+
+    uint8x16_t mn = vminq_u8(vminq_u8(r0, r1), vminq_u8(r2, r3));
+    uint8x16_t mx = vmaxq_u8(vmaxq_u8(r0, r1), vmaxq_u8(r2, r3));
+
+    uint8x8_t mn8 = vmin_u8(vget_low_u8(mn), vget_high_u8(mn));
+    uint8x8_t mx8 = vmax_u8(vget_low_u8(mx), vget_high_u8(mx));
+    mn8 = vmin_u8(mn8, vext_u8(mn8, mn8, 4));
+    mx8 = vmax_u8(mx8, vext_u8(mx8, mx8, 4));
+
+    uint32_t l = vget_lane_u32(vreinterpret_u32_u8(mn8), 0);
+    uint32_t h = vget_lane_u32(vreinterpret_u32_u8(mx8), 0);
+    memcpy(lo, &l, 4);
+    memcpy(hi, &h, 4);
+#else
+    memcpy(lo, block, 4);
+    memcpy(hi, block, 4);
+
+    for (int i = 1; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            unsigned char v = block[i * 4 + c];
+            if (v < lo[c]) lo[c] = v;
+            if (v > hi[c]) hi[c] = v;
+        }
+    }
+#endif
+}
+
+/**
+ * Pack an 8 bit color into 5:6:5.
+ *
+ * @param const unsigned char* c
+ * @return uint16_t
+ */
+static uint16_t pack_565(const unsigned char* c)
+{
+    return (uint16_t) (((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+/**
+ * Expand 5:6:5 back to 8 bit the way the hardware does.
+ *
+ * @param uint16_t v
+ * @param int* c
+ */
+static void unpack_565(uint16_t v, int* c)
+{
+    int r = (v >> 11) & 31;
+    int g = (v >> 5) & 63;
+    int b = v & 31;
+
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+/**
+ * Encode the color part of a block, always in 4 color mode.
+ *
+ * @param const unsigned char* block
+ * @param const unsigned char* lo
+ * @param const unsigned char* hi
+ * @param unsigned char* out, 8 bytes.
+ */
+static void encode_color_block(const unsigned char* block, const unsigned char* lo,
+                               const unsigned char* hi, unsigned char* out)
+{
+    /**
+     * Pull the endpoints in a little, the bounding box corners are
+     * rarely the best fit and this trims the average error.
+     */
+    unsigned char a[3], b[3];
+    for (int c = 0; c < 3; c++)
+    {
+        int inset = (hi[c] - lo[c]) >> 4;
+        a[c] = hi[c] - inset;
+        b[c] = lo[c] + inset;
+    }
+
+    uint16_t c0 = pack_565(a);
+    uint16_t c1 = pack_565(b);
+    uint32_t indices = 0;
+
+    if (c0 < c1)
+    {
+        uint16_t tmp = c0;
+        c0 = c1;
+        c1 = tmp;
+    }
+
+    if (c0 != c1)
+    {
+        int palette[4][3];
+        unpack_565(c0, palette[0]);
+        unpack_565(c1, palette[1]);
+
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+            const unsigned char* p = block + i * 4;
+            int best = 0;
+            int best_dist = 1 << 30;
+
+            for (int j = 0; j < 4; j++)
+            {
+                int dr = p[0] - palette[j][0];
+                int dg = p[1] - palette[j][1];
+                int db = p[2] - palette[j][2];
+                int dist = dr * dr + dg * dg + db * db;
+
+                if (dist < best_dist)
+                {
+                    best_dist = dist;
+                    best = j;
+                }
+            }
+
+            indices |= (uint32_t) best << (i * 2);
+        }
+    }
+
+    out[0] = c0 & 0xFF;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF;
+    out[3] = c1 >> 8;
+    out[4] = indices & 0xFF;
+    out[5] = (indices >> 8) & 0xFF;
+    out[6] = (indices >> 16) & 0xFF;
+    out[7] = indices >> 24;
+}
+
+/**
+ * Encode the alpha part of a BC3 block, in 8 alpha mode.
+ *
+ * @param const unsigned char* block
+ * @param unsigned char lo
+ * @param unsigned char hi
+ * @param unsigned char* out, 8 bytes.
+ */
+static void encode_alpha_block(const unsigned char* block, unsigned char lo,
+                               unsigned char hi, unsigned char* out)
+{
+    out[0] = hi;
+    out[1] = lo;
+
+    uint64_t indices = 0;
+
+    if (hi != lo)
+    {
+        int palette[8];
+        palette[0] = hi;
+        palette[1] = lo;
+
+        for (int j = 1; j < 7; j++)
+            palette[j + 1] = ((7 - j) * hi + j * lo) / 7;
+
+        for (int i = 0; i < 16; i++)
+        {
+            int a = block[i * 4 + 3];
+            int best = 0;
+            int best_dist = 256;
+
+            for (int j = 0; j < 8; j++)
+            {
+                int dist = abs(a - palette[j]);
+                if (dist < best_dist)
+                {
+                    best_dist = dist;
+                    best = j;
+                }
+            }
+
+            indices |= (uint64_t) best << (i * 3);
+        }
+    }
+
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+/**
+ * Copy a 4x4 block out of an image, edges are clamped.
+ *
+ * @param const image_T* image
+ * @param unsigned int bx
+ * @param unsigned int by
+ * @param unsigned char* block, 64 bytes.
+ */
+static void fetch_block(const image_T* image, unsigned int bx, unsigned int by, unsigned char* block)
+{
+    for (unsigned int y = 0; y < 4; y++)
+    {
+        unsigned int sy = by + y < image->height ? by + y : image->height - 1;
+
+        for (unsigned int x = 0; x < 4; x++)
+        {
+            unsigned int sx = bx + x < image->width ? bx + x : image->width - 1;
+            memcpy(block + (y * 4 + x) * 4, &image->pixels[sy * image->width + sx], 4);
+        }
+    }
+}
+
+/**
+ * Encode an RGBA8 image into BC1 or BC3.
+ *
+ * @param const image_T* image
+ * @param GLenum format, TEXTURE_COMPRESS_BC1 or TEXTURE_COMPRESS_BC3.
+ * @param size_t* size, set to the amount of bytes returned.
+ * @return void* to be freed by the caller.
+ */
+void* texture_compress_image(const image_T* image, GLenum format, size_t* size)
+{
+    *size = texture_compress_size(format, image->width, image->height);
+
+    unsigned char* out = malloc(*size);
+    if (out == NULL)
+        return NULL;
+
+    unsigned char* dst = out;
+    unsigned char block[64];
+    unsigned char lo[4], hi[4];
+
+    for (unsigned int by = 0; by < image->height; by += 4)
+    {
+        for (unsigned int bx = 0; bx < image->width; bx += 4)
+        {
+            fetch_block(image, bx, by, block);
+            block_bounds(block, lo, hi);
+
+            if (format == TEXTURE_COMPRESS_BC3)
+            {
+                encode_alpha_block(block, lo[3], hi[3], dst);
+                dst += 8;
+            }
+
+            encode_color_block(block, lo, hi, dst);
+            dst += 8;
+        }
+    }
+
+    return out;
+}
@@ -0,0 +1,1070 @@
+#include "include/texture_loader.h"
+#include "include/baked_texture.h"
+#include "include/texture_compress.h"
+#include "include/profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/**
+ * Pixel shown until the real image has been uploaded.
+ */
+static const uint32_t placeholder_pixel = 0xFFFF00FF;
+
+/**
+ * Shift the mip chain of a job up by `lod` levels, never past its
+ * last level. Without a mip filter only the new base level is kept
+ * and the driver builds the rest as usual.
+ *
+ * @param texture_loader_T* loader
+ * @param texture_job_T* job
+ */
+static void texture_job_drop_levels(texture_loader_T* loader, texture_job_T* job)
+{
+    mipmap_filter_T filter = loader->mipmap_filter;
+
+    if (filter == MIPMAP_FILTER_NONE)
+        job->level_count = mipmap_generate(job->levels, job->lod + 1, MIPMAP_FILTER_BOX);
+
+    if (job->lod >= job->level_count)
+        job->lod = job->level_count - 1;
+
+    for (size_t i = 0; i < job->lod; i++)
+    {
+        if (job->levels[i].pixels == job->staging.data)
+            staging_pool_release(loader->staging, &job->staging);
+        else
+            image_release(&job->levels[i]);
+    }
+
+    memmove(&job->levels[0], &job->levels[job->lod], (job->level_count - job->lod) * sizeof(image_T));
+    job->level_count -= job->lod;
+    memset(&job->levels[job->level_count], 0, job->lod * sizeof(image_T));
+
+    if (filter == MIPMAP_FILTER_NONE)
+    {
+        mipmap_release(job->levels, job->level_count);
+        job->level_count = 1;
+    }
+}
+
+/**
+ * Allocator for the base level of a job, see texture_job_process.
+ *
+ * @param size_t size
+ * @param void* data, the texture_job_T.
+ * @return void*
+ */
+static void* texture_job_alloc(size_t size, void* data)
+{
+    texture_job_T* job = data;
+    return staging_pool_alloc(job->loader->staging, size, job->direct, &job->staging) ? job->staging.data : NULL;
+}
+
+/**
+ * Decode a job, generate its mip chain and block compress it when
+ * those are enabled.
+ * An image that is uploaded as it was decoded goes straight into
+ * mapped upload memory, everything the CPU reads back again into
+ * pooled heap memory instead.
+ * This runs on a worker thread, so no GL calls in here.
+ *
+ * @param texture_loader_T* loader
+ * @param texture_job_T* job
+ */
+static void texture_job_process(texture_loader_T* loader, texture_job_T* job)
+{
+    job->format = GL_RGBA8;
+    job->direct = loader->mipmap_filter == MIPMAP_FILTER_NONE && !loader->compress && job->lod == 0;
+
+    if (!image_load_into(&job->levels[0], job->path, texture_job_alloc, job))
+    {
+        job->failed = 1;
+        return;
+    }
+
+    job->level_count = mipmap_generate(job->levels, MIPMAP_MAX_LEVELS, loader->mipmap_filter);
+
+    if (job->lod > 0)
+        texture_job_drop_levels(loader, job);
+
+    if (!loader->compress)
+        return;
+
+    GLenum format = texture_compress_choose_format(&job->levels[0]);
+    size_t total = 0;
+
+    for (size_t i = 0; i < job->level_count; i++)
+    {
+        job->compressed_sizes[i] = texture_compress_size(format, job->levels[i].width, job->levels[i].height);
+        total += job->compressed_sizes[i];
+    }
+
+    job->compressed = malloc(total);
+    if (job->compressed == NULL)
+        return;
+
+    unsigned char* dst = job->compressed;
+
+    for (size_t i = 0; i < job->level_count; i++)
+    {
+        size_t size = 0;
+        void* level = texture_compress_image(&job->levels[i], format, &size);
+
+        /**
+         * Upload it uncompressed instead, the levels are still there
+         */
+        if (level == NULL || size != job->compressed_sizes[i])
+        {
+            fprintf(stderr, "Could not compress `%s`, uploading it uncompressed\n", job->path);
+            free(level);
+            free(job->compressed);
+            job->compressed = NULL;
+            return;
+        }
+
+        memcpy(dst, level, size);
+        free(level);
+        dst += size;
+    }
+
+    job->format = format;
+}
+
+/**
+ * Size of a mip level as uploaded.
+ *
+ * @param texture_job_T* job
+ * @param size_t level
+ * @return size_t
+ */
+static size_t texture_job_level_size(texture_job_T* job, size_t level)
+{
+    if (job->compressed)
+        return job->compressed_sizes[level];
+
+    return (size_t) job->levels[level].width * job->levels[level].height * sizeof(uint32_t);
+}
+
+/**
+ * A reload with the same size, format & amount of levels can write
+ * into the storage the texture already has instead of reallocating it.
+ * Expects the texture to be bound.
+ *
+ * @param texture_job_T* job
+ * @return int
+ */
+static int texture_job_fits(texture_job_T* job)
+{
+    if (!job->reload)
+        return 0;
+
+    size_t last = job->level_count - 1;
+    GLint width = 0, height = 0, format = 0, last_width = 0, last_height = 0;
+
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, last, GL_TEXTURE_WIDTH, &last_width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, last, GL_TEXTURE_HEIGHT, &last_height);
+
+    int same_format = job->compressed
+        ? (GLenum) format == job->format
+        : format == GL_RGBA8 || format == GL_RGBA;
+
+    return same_format &&
+           (unsigned int) width == job->levels[0].width &&
+           (unsigned int) height == job->levels[0].height &&
+           (unsigned int) last_width == job->levels[last].width &&
+           (unsigned int) last_height == job->levels[last].height;
+}
+
+/**
+ * Release the storage of every level from `first` on, left behind
+ * when a texture is respecified with a shorter mip chain.
+ * Expects the texture to be bound.
+ *
+ * @param size_t first
+ */
+static void texture_clear_levels(size_t first)
+{
+    for (size_t i = first; i < MIPMAP_MAX_LEVELS; i++)
+    {
+        GLint width = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, i, GL_TEXTURE_WIDTH, &width);
+        if (width == 0)
+            break;
+
+        glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+}
+
+/**
+ * Free everything a job owns.
+ *
+ * @param texture_job_T* job
+ */
+static void texture_job_free(texture_job_T* job)
+{
+    mipmap_release(job->levels, job->level_count);
+    if (job->levels[0].pixels != job->staging.data)
+        image_release(&job->levels[0]);
+    staging_pool_release(job->loader->staging, &job->staging);
+    free(job->compressed);
+    free(job->path);
+    free(job);
+}
+
+/**
+ * Worker thread, pops queued jobs, decodes them and moves them
+ * over to the decoded list.
+ *
+ * @param void* ptr
+ * @return void*
+ */
+static void* texture_loader_worker(void* ptr)
+{
+    texture_loader_T* loader = (texture_loader_T*) ptr;
+
+    pthread_mutex_lock(&loader->lock);
+    while (1)
+    {
+        while (loader->running && loader->queued == NULL)
+            pthread_cond_wait(&loader->cond, &loader->lock);
+
+        if (!loader->running)
+            break;
+
+        texture_job_T* job = loader->queued;
+        loader->queued = job->next;
+        if (loader->queued == NULL)
+            loader->queued_tail = NULL;
+
+        /**
+         * Jobs being decoded are kept in `processing` so they can
+         * still be cancelled, a cancelled one is not decoded at all.
+         */
+        if (!job->cancelled)
+        {
+            job->next = loader->processing;
+            loader->processing = job;
+
+            pthread_mutex_unlock(&loader->lock);
+            texture_job_process(loader, job);
+            pthread_mutex_lock(&loader->lock);
+
+            texture_job_T** link = &loader->processing;
+            while (*link != job)
+                link = &(*link)->next;
+            *link = job->next;
+        }
+
+        job->next = NULL;
+
+        if (loader->decoded_tail)
+            loader->decoded_tail->next = job;
+        else
+            loader->decoded = job;
+        loader->decoded_tail = job;
+    }
+    pthread_mutex_unlock(&loader->lock);
+
+    return NULL;
+}
+
+/**
+ * Create a new texture loader with a pool of decode workers.
+ * Must be called with a current GL context.
+ *
+ * @param size_t worker_count, 0 means one per core, minus the GL thread.
+ * @return texture_loader_T*
+ */
+texture_loader_T* init_texture_loader(size_t worker_count)
+{
+    texture_loader_T* loader = calloc(1, sizeof(struct TEXTURE_LOADER_STRUCT));
+
+    if (worker_count == 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_count = cores > 1 ? (size_t) cores - 1 : 1;
+    }
+
+    /**
+     * Persistent mapping lets us keep the staging buffers mapped
+     * forever instead of mapping / unmapping on every upload.
+     */
+    loader->persistent = GLEW_ARB_buffer_storage;
+    loader->staging = init_staging_pool(TEXTURE_LOADER_STAGING_SIZE);
+    loader->upload_budget = TEXTURE_LOADER_UPLOAD_BUDGET;
+
+    for (size_t i = 0; i < TEXTURE_LOADER_TIMERS; i++)
+        glGenQueries(1, &loader->timers[i].query);
+
+    pthread_mutex_init(&loader->lock, NULL);
+    pthread_cond_init(&loader->cond, NULL);
+    loader->running = 1;
+
+    loader->workers = calloc(worker_count, sizeof(pthread_t));
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        if (pthread_create(&loader->workers[i], NULL, texture_loader_worker, loader) != 0)
+        {
+            fprintf(stderr, "Could not create texture loader thread\n");
+            break;
+        }
+        loader->worker_count++;
+    }
+
+    return loader;
+}
+
+/**
+ * Note that the storage of `texture` changed.
+ *
+ * @param texture_loader_T* loader
+ * @param unsigned int texture
+ * @param size_t lod
+ * @param int failed
+ */
+static void texture_loader_record(texture_loader_T* loader, unsigned int texture, size_t lod, int failed)
+{
+    if (loader->upload_count == loader->upload_capacity)
+    {
+        loader->upload_capacity = loader->upload_capacity ? loader->upload_capacity * 2 : 16;
+        loader->uploads = realloc(loader->uploads, loader->upload_capacity * sizeof(texture_upload_T));
+    }
+
+    texture_upload_T* upload = &loader->uploads[loader->upload_count++];
+    upload->texture = texture;
+    upload->lod = lod;
+    upload->failed = failed;
+}
+
+/**
+ * Hand a texture over to the decode workers.
+ *
+ * @param texture_loader_T* loader
+ * @param unsigned int texture
+ * @param const char* path
+ * @param int reload, replace the image of a texture that was already uploaded.
+ * @param int resize, the reload only frees or regains memory.
+ * @param size_t lod, mip levels to leave out.
+ */
+static void texture_loader_queue(texture_loader_T* loader, unsigned int texture, const char* path,
+                                 int reload, int resize, size_t lod)
+{
+    texture_job_T* job = calloc(1, sizeof(struct TEXTURE_JOB_STRUCT));
+    job->loader = loader;
+    job->texture = texture;
+    job->path = strdup(path);
+    job->reload = reload;
+    job->resize = resize;
+    job->lod = lod;
+
+    pthread_mutex_lock(&loader->lock);
+    if (loader->queued_tail)
+        loader->queued_tail->next = job;
+    else
+        loader->queued = job;
+    loader->queued_tail = job;
+    loader->in_flight++;
+    pthread_cond_signal(&loader->cond);
+    pthread_mutex_unlock(&loader->lock);
+}
+
+/**
+ * Upload the baked version of `path` straight from its mapping, when
+ * there is one that is not older than `path` and can be uploaded.
+ * Binds the texture on the active unit.
+ *
+ * @param texture_loader_T* loader
+ * @param unsigned int texture
+ * @param const char* path
+ * @param size_t lod, mip levels to leave out.
+ * @return int 0 if `path` has to be decoded instead.
+ */
+static int texture_loader_upload_baked(texture_loader_T* loader, unsigned int texture, const char* path, size_t lod)
+{
+    char* baked_path = baked_texture_path(path);
+    baked_texture_T* baked = NULL;
+
+    if (baked_texture_stale(baked_path, path))
+        fprintf(stderr, "Baked texture for `%s` is older than the image, decoding it instead\n", path);
+    else
+        baked = baked_texture_open(baked_path);
+    free(baked_path);
+
+    if (baked && (baked->header->flags & BAKED_TEXTURE_FLAG_COMPRESSED) && !texture_compress_supported())
+    {
+        fprintf(stderr, "Baked texture for `%s` is compressed in an unsupported format\n", path);
+        baked_texture_close(baked);
+        baked = NULL;
+    }
+
+    if (baked == NULL)
+        return 0;
+
+    if (lod >= baked->header->level_count)
+        lod = baked->header->level_count - 1;
+
+    baked_texture_upload(baked, texture, lod);
+    texture_clear_levels(baked->header->level_count - lod);
+    baked_texture_close(baked);
+    texture_loader_record(loader, texture, lod, 0);
+
+    return 1;
+}
+
+/**
+ * Get a texture as an unsigned integer.
+ * The returned texture is usable right away, it shows a placeholder
+ * until the decoded image has been uploaded by texture_loader_update.
+ * Baked textures next to the .png are uploaded immediately instead.
+ *
+ * @param texture_loader_T* loader
+ * @param const char* path
+ * @return unsigned int
+ */
+unsigned int texture_loader_get_texture(texture_loader_T* loader, const char* path)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    /**
+     * This is texture parameters,
+     * you can see them as "effects" that are applied to the
+     * loaded texture.
+     */
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    /**
+     * A baked texture is GPU ready, only fall back to decoding the
+     * .png when there is none.
+     */
+    if (texture_loader_upload_baked(loader, texture, path, 0))
+        return texture;
+
+    /**
+     * A single level keeps the placeholder complete under mipmap filters
+     */
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &placeholder_pixel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    texture_loader_queue(loader, texture, path, 0, 0, 0);
+
+    return texture;
+}
+
+/**
+ * Decode `path` again in the background and swap it into an existing
+ * texture during texture_loader_update. The old image stays visible
+ * until then. A baked version is uploaded right away instead, which
+ * binds the texture on the active unit.
+ *
+ * @param texture_loader_T* loader
+ * @param unsigned int texture
+ * @param const char* path
+ */
+void texture_loader_reload(texture_loader_T* loader, unsigned int texture, const char* path)
+{
+    if (!texture_loader_upload_baked(loader, texture, path, 0))
+        texture_loader_queue(loader, texture, path, 1, 0, 0);
+}
+
+/**
+ * Decode `path` again with the top `lod` mip levels left out, to shrink
+ * a texture that is over budget or grow it back with a lod of 0.
+ * Like texture_loader_reload a baked version is uploaded right away.
+ *
+ * @param texture_loader_T* loader
+ * @param unsigned int texture
+ * @param const char* path
+ * @param size_t lod
+ */
+void texture_loader_resize(texture_loader_T* loader, unsigned int texture, const char* path, size_t lod)
+{
+    if (!texture_loader_upload_baked(loader, texture, path, lod))
+        texture_loader_queue(loader, texture, path, 1, 1, lod);
+}
+
+/**
+ * Free every level of a texture right away, it shows the placeholder
+ * until it is reloaded. Binds the texture on the active unit.
+ *
+ * @param texture_loader_T* loader
+ * @param unsigned int texture
+ */
+void texture_loader_evict(texture_loader_T* loader, unsigned int texture)
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &placeholder_pixel);
+    texture_clear_levels(1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+}
+
+/**
+ * Mark every job of a list that belongs to `texture` as cancelled.
+ *
+ * @param texture_job_T* job
+ * @param unsigned int texture
+ */
+static void texture_job_cancel_list(texture_job_T* job, unsigned int texture)
+{
+    for (; job; job = job->next)
+    {
+        if (job->texture == texture)
+            job->cancelled = 1;
+    }
+}
+
+/**
+ * Drop every pending job of a texture, call right before deleting it.
+ * GL reuses the names of deleted textures, so a job that was not
+ * cancelled would upload into whatever texture gets the name next.
+ *
+ * @param texture_loader_T* loader
+ * @param unsigned int texture
+ */
+void texture_loader_cancel(texture_loader_T* loader, unsigned int texture)
+{
+    pthread_mutex_lock(&loader->lock);
+    texture_job_cancel_list(loader->queued, texture);
+    texture_job_cancel_list(loader->processing, texture);
+    texture_job_cancel_list(loader->decoded, texture);
+    pthread_mutex_unlock(&loader->lock);
+
+    for (size_t i = 0; i < loader->ready_count; i++)
+    {
+        if (loader->ready[i]->texture == texture)
+            loader->ready[i]->cancelled = 1;
+    }
+}
+
+/**
+ * Block compress textures on the workers before uploading them,
+ * when the driver supports it. Call before loading any textures.
+ *
+ * @param texture_loader_T* loader
+ * @param int enabled
+ * @return int 0 if compression is not available.
+ */
+int texture_loader_set_compression(texture_loader_T* loader, int enabled)
+{
+    loader->compress = enabled && texture_compress_supported();
+    return loader->compress == enabled;
+}
+
+/**
+ * Generate mip chains on the workers with the given filter,
+ * MIPMAP_FILTER_NONE leaves it to glGenerateMipmap.
+ * Call before loading any textures.
+ *
+ * @param texture_loader_T* loader
+ * @param mipmap_filter_T filter
+ */
+void texture_loader_set_mipmap_filter(texture_loader_T* loader, mipmap_filter_T filter)
+{
+    loader->mipmap_filter = filter;
+}
+
+/**
+ * Spend at most `budget` nanoseconds a frame uploading textures,
+ * 0 uploads everything that is ready at once.
+ *
+ * @param texture_loader_T* loader
+ * @param uint64_t budget
+ */
+void texture_loader_set_upload_budget(texture_loader_T* loader, uint64_t budget)
+{
+    loader->upload_budget = budget;
+}
+
+/**
+ * Make sure a staging buffer is at least `size` bytes large.
+ *
+ * @param texture_loader_T* loader
+ * @param texture_pbo_T* pbo
+ * @param size_t size
+ */
+static void texture_pbo_reserve(texture_loader_T* loader, texture_pbo_T* pbo, size_t size)
+{
+    if (pbo->buffer && pbo->size >= size)
+        return;
+
+    /**
+     * Immutable storage cannot be resized, so just start over.
+     */
+    if (pbo->buffer)
+        glDeleteBuffers(1, &pbo->buffer);
+
+    glGenBuffers(1, &pbo->buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo->buffer);
+    pbo->size = size;
+    pbo->mapped = NULL;
+
+    if (loader->persistent)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+        pbo->mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+    }
+    else
+    {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    }
+}
+
+/**
+ * Done filling the current pixel buffer object for this frame, fence
+ * it and move on to the next one.
+ *
+ * @param texture_loader_T* loader
+ */
+static void texture_loader_next_pbo(texture_loader_T* loader)
+{
+    texture_pbo_T* pbo = &loader->pbos[loader->pbo_index];
+
+    if (pbo->used == 0)
+        return;
+
+    pbo->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pbo->used = 0;
+    loader->pbo_index = (loader->pbo_index + 1) % TEXTURE_LOADER_PBO_COUNT;
+}
+
+/**
+ * Copy a job into the current pixel buffer object after whatever this
+ * frame already put in there, moving on to the next one when it is
+ * full, & leave it bound.
+ *
+ * @param texture_loader_T* loader
+ * @param texture_job_T* job
+ * @param size_t* offset, where the job starts in the buffer.
+ * @return texture_pbo_T* or NULL if no staging buffer was free this frame.
+ */
+static texture_pbo_T* texture_loader_stage(texture_loader_T* loader, texture_job_T* job, size_t* offset)
+{
+    size_t size = 0;
+
+    for (size_t i = 0; i < job->level_count; i++)
+        size += texture_job_level_size(job, i);
+
+    texture_pbo_T* pbo = &loader->pbos[loader->pbo_index];
+    size_t start = (pbo->used + TEXTURE_LOADER_PBO_ALIGNMENT - 1) & ~(size_t) (TEXTURE_LOADER_PBO_ALIGNMENT - 1);
+
+    if (pbo->used > 0 && start + size > pbo->size)
+    {
+        texture_loader_next_pbo(loader);
+        pbo = &loader->pbos[loader->pbo_index];
+        start = 0;
+    }
+
+    /**
+     * Never wait on the GPU, if it still reads from this buffer
+     * we try again next frame.
+     */
+    if (pbo->fence)
+    {
+        GLenum status = glClientWaitSync(pbo->fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return NULL;
+
+        glDeleteSync(pbo->fence);
+        pbo->fence = NULL;
+    }
+
+    if (start == 0)
+        texture_pbo_reserve(loader, pbo, size > TEXTURE_LOADER_PBO_SIZE ? size : TEXTURE_LOADER_PBO_SIZE);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo->buffer);
+
+    /**
+     * Earlier uploads of this frame still read the rest of the buffer,
+     * the ranges never overlap so there is nothing to synchronize.
+     */
+    unsigned char* dst = loader->persistent
+        ? (unsigned char*) pbo->mapped + start
+        : glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, start, size,
+                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+
+    if (job->compressed)
+    {
+        memcpy(dst, job->compressed, size);
+    }
+    else
+    {
+        size_t level_offset = 0;
+        for (size_t i = 0; i < job->level_count; i++)
+        {
+            memcpy(dst + level_offset, job->levels[i].pixels, texture_job_level_size(job, i));
+            level_offset += texture_job_level_size(job, i);
+        }
+    }
+
+    if (!loader->persistent)
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    pbo->used = start + size;
+    *offset = start;
+
+    return pbo;
+}
+
+/**
+ * Upload a decoded job, straight from the mapped memory it was
+ * decoded into or else through the next free pixel buffer object.
+ *
+ * @param texture_loader_T* loader
+ * @param texture_job_T* job
+ * @return int 0 if no staging buffer was free this frame.
+ */
+static int texture_loader_upload(texture_loader_T* loader, texture_job_T* job)
+{
+    texture_pbo_T* pbo = NULL;
+    size_t offset = 0;
+
+    if (job->staging.mapped)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, loader->staging->buffer);
+        offset = job->staging.offset;
+    }
+    else if ((pbo = texture_loader_stage(loader, job, &offset)) == NULL)
+    {
+        return 0;
+    }
+
+    int compressed = job->compressed != NULL;
+
+    glBindTexture(GL_TEXTURE_2D, job->texture);
+
+    int in_place = texture_job_fits(job);
+
+    for (size_t i = 0; i < job->level_count; i++)
+    {
+        image_T* level = &job->levels[i];
+        size_t level_size = texture_job_level_size(job, i);
+
+        if (compressed && in_place)
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level->width, level->height,
+                                      job->format, level_size, (void*) offset);
+        else if (compressed)
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, job->format, level->width, level->height,
+                                   0, level_size, (void*) offset);
+        else if (in_place)
+            glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level->width, level->height,
+                            GL_RGBA, GL_UNSIGNED_BYTE, (void*) offset);
+        else
+            glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, level->width, level->height,
+                         0, GL_RGBA, GL_UNSIGNED_BYTE, (void*) offset);
+
+        offset += level_size;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    /**
+     * Without a CPU mip chain the driver builds one, except for
+     * compressed textures where glGenerateMipmap cannot be used.
+     */
+    if (job->level_count > 1 || compressed)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, job->level_count - 1);
+        if (!in_place)
+            texture_clear_levels(job->level_count);
+    }
+    else
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, TEXTURE_LOADER_MAX_LEVEL_DEFAULT);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    if (job->reload && !job->resize)
+        printf("Reloaded `%s`%s\n", job->path, in_place ? " in place" : "");
+
+    if (pbo == NULL)
+    {
+        staging_pool_retire(loader->staging, &job->staging);
+        job->levels[0].pixels = NULL;
+    }
+
+    return 1;
+}
+
+/**
+ * Order for the ready jobs, largest first so the smallest is popped
+ * off the end.
+ *
+ * @param const void* a
+ * @param const void* b
+ * @return int
+ */
+static int texture_job_compare_size(const void* a, const void* b)
+{
+    const texture_job_T* job_a = *(texture_job_T* const*) a;
+    const texture_job_T* job_b = *(texture_job_T* const*) b;
+
+    return (job_a->upload_size < job_b->upload_size) - (job_a->upload_size > job_b->upload_size);
+}
+
+/**
+ * Move every decoded job over to the ready jobs & sort those by size.
+ *
+ * @param texture_loader_T* loader
+ */
+static void texture_loader_collect(texture_loader_T* loader)
+{
+    pthread_mutex_lock(&loader->lock);
+    texture_job_T* job = loader->decoded;
+    loader->decoded = NULL;
+    loader->decoded_tail = NULL;
+    pthread_mutex_unlock(&loader->lock);
+
+    if (job == NULL)
+        return;
+
+    for (; job; job = job->next)
+    {
+        if (loader->ready_count == loader->ready_capacity)
+        {
+            loader->ready_capacity = loader->ready_capacity ? loader->ready_capacity * 2 : 16;
+            loader->ready = realloc(loader->ready, loader->ready_capacity * sizeof(texture_job_T*));
+        }
+
+        for (size_t i = 0; !job->failed && i < job->level_count; i++)
+            job->upload_size += texture_job_level_size(job, i);
+
+        job->ready_frame = loader->frame;
+
+        loader->ready[loader->ready_count++] = job;
+    }
+
+    qsort(loader->ready, loader->ready_count, sizeof(texture_job_T*), texture_job_compare_size);
+}
+
+/**
+ * Move the job that has been waiting the longest to the end of the
+ * ready jobs, when it waited long enough to go first.
+ *
+ * @param texture_loader_T* loader
+ */
+static void texture_loader_age(texture_loader_T* loader)
+{
+    size_t oldest = 0;
+
+    for (size_t i = 1; i < loader->ready_count; i++)
+    {
+        if (loader->ready[i]->ready_frame < loader->ready[oldest]->ready_frame)
+            oldest = i;
+    }
+
+    if (loader->ready_count == 0 || loader->frame - loader->ready[oldest]->ready_frame < TEXTURE_LOADER_MAX_WAIT)
+        return;
+
+    texture_job_T* job = loader->ready[oldest];
+    memmove(&loader->ready[oldest], &loader->ready[oldest + 1],
+            (loader->ready_count - oldest - 1) * sizeof(texture_job_T*));
+    loader->ready[loader->ready_count - 1] = job;
+}
+
+/**
+ * Add up the upload timers the GPU has finished.
+ *
+ * @param texture_loader_T* loader
+ * @param int wait, block until every timer is available.
+ */
+static void texture_loader_read_timers(texture_loader_T* loader, int wait)
+{
+    for (size_t i = 0; i < TEXTURE_LOADER_TIMERS; i++)
+    {
+        texture_upload_timer_T* timer = &loader->timers[i];
+        if (!timer->pending)
+            continue;
+
+        GLint available = wait;
+        if (!wait)
+            glGetQueryObjectiv(timer->query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+        if (!available)
+            continue;
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(timer->query, GL_QUERY_RESULT, &elapsed);
+
+        loader->upload_time += elapsed;
+        loader->timed_bytes += timer->bytes;
+        timer->pending = 0;
+    }
+}
+
+/**
+ * Upload whatever the workers have finished decoding, smallest first,
+ * until the upload budget for this frame is spent.
+ * Call this once per frame from the GL thread.
+ * Uploading binds textures on the active unit.
+ *
+ * @param texture_loader_T* loader
+ * @return size_t amount of textures uploaded.
+ */
+size_t texture_loader_update(texture_loader_T* loader)
+{
+    size_t uploaded = 0;
+    uint64_t begin = profiler_now();
+
+    staging_pool_update(loader->staging);
+    texture_loader_collect(loader);
+    texture_loader_age(loader);
+    texture_loader_read_timers(loader, 0);
+
+    /**
+     * The GPU side of the uploads is timed, the calls themselves
+     * return long before the copies are done. When every timer is
+     * still in flight this frame goes untimed.
+     */
+    texture_upload_timer_T* timer = &loader->timers[loader->timer_index];
+    size_t bytes = 0;
+
+    if (loader->ready_count == 0 || timer->pending)
+        timer = NULL;
+    else
+        glBeginQuery(GL_TIME_ELAPSED, timer->query);
+
+    while (loader->ready_count > 0)
+    {
+        if (uploaded > 0 && loader->upload_budget && profiler_now() - begin >= loader->upload_budget)
+            break;
+
+        texture_job_T* job = loader->ready[loader->ready_count - 1];
+        int upload = !job->cancelled && !job->failed;
+
+        if (upload && !texture_loader_upload(loader, job))
+            break;
+
+        if (upload)
+            bytes += job->upload_size;
+
+        /**
+         * The name of a cancelled job may already belong to another
+         * texture, so nothing is recorded for it.
+         */
+        uploaded += upload;
+        if (!job->cancelled)
+            texture_loader_record(loader, job->texture, job->lod, job->failed);
+        loader->ready_count--;
+
+        pthread_mutex_lock(&loader->lock);
+        loader->in_flight--;
+        pthread_mutex_unlock(&loader->lock);
+
+        texture_job_free(job);
+    }
+
+    if (timer)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        timer->bytes = bytes;
+        timer->pending = 1;
+        loader->timer_index = (loader->timer_index + 1) % TEXTURE_LOADER_TIMERS;
+    }
+
+    loader->uploaded_bytes += bytes;
+
+    texture_loader_next_pbo(loader);
+    loader->frame++;
+
+    return uploaded;
+}
+
+/**
+ * Amount of textures not yet uploaded.
+ *
+ * @param texture_loader_T* loader
+ * @return size_t
+ */
+size_t texture_loader_pending(texture_loader_T* loader)
+{
+    pthread_mutex_lock(&loader->lock);
+    size_t pending = loader->in_flight;
+    pthread_mutex_unlock(&loader->lock);
+
+    return pending;
+}
+
+/**
+ * Throughput of the uploads timed on the GPU so far, waits for the
+ * timers still in flight.
+ *
+ * @param texture_loader_T* loader
+ * @return double MB/s, 0 if nothing was timed.
+ */
+double texture_loader_upload_throughput(texture_loader_T* loader)
+{
+    texture_loader_read_timers(loader, 1);
+
+    if (loader->upload_time == 0 || loader->timed_bytes == 0)
+        return 0;
+
+    return loader->timed_bytes / (1024.0 * 1024.0) / (loader->upload_time / 1e9);
+}
+
+/**
+ * Free a list of jobs.
+ *
+ * @param texture_job_T* job
+ */
+static void texture_job_free_list(texture_job_T* job)
+{
+    while (job)
+    {
+        texture_job_T* next = job->next;
+        texture_job_free(job);
+        job = next;
+    }
+}
+
+/**
+ * Stop the workers and release all staging buffers.
+ *
+ * @param texture_loader_T* loader
+ */
+void texture_loader_free(texture_loader_T* loader)
+{
+    pthread_mutex_lock(&loader->lock);
+    loader->running = 0;
+    pthread_cond_broadcast(&loader->cond);
+    pthread_mutex_unlock(&loader->lock);
+
+    for (size_t i = 0; i < loader->worker_count; i++)
+        pthread_join(loader->workers[i], NULL);
+
+    texture_job_free_list(loader->queued);
+    texture_job_free_list(loader->decoded);
+
+    for (size_t i = 0; i < loader->ready_count; i++)
+        texture_job_free(loader->ready[i]);
+
+    for (size_t i = 0; i < TEXTURE_LOADER_TIMERS; i++)
+        glDeleteQueries(1, &loader->timers[i].query);
+
+    for (size_t i = 0; i < TEXTURE_LOADER_PBO_COUNT; i++)
+    {
+        texture_pbo_T* pbo = &loader->pbos[i];
+        if (pbo->fence)
+            glDeleteSync(pbo->fence);
+        if (pbo->buffer)
+            glDeleteBuffers(1, &pbo->buffer);
+    }
+
+    staging_pool_free(loader->staging);
+    pthread_mutex_destroy(&loader->lock);
+    pthread_cond_destroy(&loader->cond);
+    free(loader->uploads);
+    free(loader->ready);
+    free(loader->workers);
+    free(loader);
+}
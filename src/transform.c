@@ -0,0 +1,282 @@
+#include "include/transform.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * Four floats at a time, one object per lane.
+ */
+#if defined(__SSE2__)
+typedef __m128 lane_T;
+#define lane_load(p) _mm_loadu_ps(p)
+#define lane_store(p, v) _mm_storeu_ps(p, v)
+#define lane_set1(s) _mm_set1_ps(s)
+#define lane_add(a, b) _mm_add_ps(a, b)
+#define lane_sub(a, b) _mm_sub_ps(a, b)
+#define lane_mul(a, b) _mm_mul_ps(a, b)
+#define lane_round(a) _mm_cvtepi32_ps(_mm_cvtps_epi32(a))
+static inline void lane_transpose(lane_T* a, lane_T* b, lane_T* c, lane_T* d) { _MM_TRANSPOSE4_PS(*a, *b, *c, *d); }
+#elif defined(__ARM_NEON)
+typedef float32x4_t lane_T;
+#define lane_load(p) vld1q_f32(p)
+#define lane_store(p, v) vst1q_f32(p, v)
+#define lane_set1(s) vdupq_n_f32(s)
+#define lane_add(a, b) vaddq_f32(a, b)
+#define lane_sub(a, b) vsubq_f32(a, b)
+#define lane_mul(a, b) vmulq_f32(a, b)
+#define lane_round(a) vcvtq_f32_s32(vcvtnq_s32_f32(a))
+static inline void lane_transpose(lane_T* a, lane_T* b, lane_T* c, lane_T* d)
+{
+    float32x4x2_t ab = vtrnq_f32(*a, *b);
+    float32x4x2_t cd = vtrnq_f32(*c, *d);
+    *a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    *b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    *c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    *d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+#else
+typedef struct { float v[4]; } lane_T;
+static inline lane_T lane_load(const float* p) { lane_T r = {{ p[0], p[1], p[2], p[3] }}; return r; }
+static inline void lane_store(float* p, lane_T a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline lane_T lane_set1(float s) { lane_T r = {{ s, s, s, s }}; return r; }
+static inline lane_T lane_add(lane_T a, lane_T b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+static inline lane_T lane_sub(lane_T a, lane_T b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+static inline lane_T lane_mul(lane_T a, lane_T b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+static inline lane_T lane_round(lane_T a) { for (int i = 0; i < 4; i++) a.v[i] = (float) (int) (a.v[i] + (a.v[i] < 0 ? -0.5f : 0.5f)); return a; }
+static inline void lane_transpose(lane_T* a, lane_T* b, lane_T* c, lane_T* d)
+{
+    lane_T r[4] = { *a, *b, *c, *d };
+    for (int i = 0; i < 4; i++)
+    {
+        a->v[i] = r[i].v[0];
+        b->v[i] = r[i].v[1];
+        c->v[i] = r[i].v[2];
+        d->v[i] = r[i].v[3];
+    }
+}
+#endif
+
+#define TRANSFORM_TWO_PI 6.28318530717958647692f
+
+/**
+ * sin & cos of four angles.
+ * The angle is wrapped to [-pi, pi], then sin & cos come from their
+ * Taylor series up to x^15 / x^14, good to about 5e-6 over the range.
+ * No table lookups or branches, so it vectorizes as is.
+ *
+ * @param lane_T x
+ * @param lane_T* s
+ * @param lane_T* c
+ */
+static inline void lane_sincos(lane_T x, lane_T* s, lane_T* c)
+{
+    lane_T turns = lane_round(lane_mul(x, lane_set1(1.0f / TRANSFORM_TWO_PI)));
+    x = lane_sub(x, lane_mul(turns, lane_set1(TRANSFORM_TWO_PI)));
+
+    lane_T x2 = lane_mul(x, x);
+
+    lane_T ps = lane_set1(-1.0f / 1307674368000.0f);
+    ps = lane_add(lane_mul(ps, x2), lane_set1(1.0f / 6227020800.0f));
+    ps = lane_add(lane_mul(ps, x2), lane_set1(-1.0f / 39916800.0f));
+    ps = lane_add(lane_mul(ps, x2), lane_set1(1.0f / 362880.0f));
+    ps = lane_add(lane_mul(ps, x2), lane_set1(-1.0f / 5040.0f));
+    ps = lane_add(lane_mul(ps, x2), lane_set1(1.0f / 120.0f));
+    ps = lane_add(lane_mul(ps, x2), lane_set1(-1.0f / 6.0f));
+    ps = lane_add(lane_mul(ps, x2), lane_set1(1.0f));
+    *s = lane_mul(ps, x);
+
+    lane_T pc = lane_set1(-1.0f / 87178291200.0f);
+    pc = lane_add(lane_mul(pc, x2), lane_set1(1.0f / 479001600.0f));
+    pc = lane_add(lane_mul(pc, x2), lane_set1(-1.0f / 3628800.0f));
+    pc = lane_add(lane_mul(pc, x2), lane_set1(1.0f / 40320.0f));
+    pc = lane_add(lane_mul(pc, x2), lane_set1(-1.0f / 720.0f));
+    pc = lane_add(lane_mul(pc, x2), lane_set1(1.0f / 24.0f));
+    pc = lane_add(lane_mul(pc, x2), lane_set1(-1.0f / 2.0f));
+    *c = lane_add(lane_mul(pc, x2), lane_set1(1.0f));
+}
+
+/**
+ * Allocate a zeroed & aligned array, with at least three floats
+ * of padding so a vector load at any index stays inside.
+ *
+ * @param size_t count
+ * @return float*
+ */
+static float* transform_array(size_t count)
+{
+    size_t size = ((count + 3 + 3) & ~(size_t) 3) * sizeof(float);
+    float* array = aligned_alloc(16, size);
+
+    if (array)
+        memset(array, 0, size);
+
+    return array;
+}
+
+/**
+ * Create transforms for `count` objects, all at the origin with
+ * a scale of one.
+ *
+ * @param size_t count
+ * @return transform_soa_T* or NULL when out of memory.
+ */
+transform_soa_T* init_transform_soa(size_t count)
+{
+    transform_soa_T* soa = calloc(1, sizeof(struct TRANSFORM_SOA_STRUCT));
+    if (soa == NULL)
+        return NULL;
+
+    soa->count = count;
+    soa->x = transform_array(count);
+    soa->y = transform_array(count);
+    soa->z = transform_array(count);
+    soa->rotation = transform_array(count);
+    soa->scale_x = transform_array(count);
+    soa->scale_y = transform_array(count);
+
+    if (!soa->x || !soa->y || !soa->z || !soa->rotation || !soa->scale_x || !soa->scale_y)
+    {
+        transform_soa_free(soa);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        soa->scale_x[i] = 1.0f;
+        soa->scale_y[i] = 1.0f;
+    }
+
+    return soa;
+}
+
+/**
+ * sin & cos of many angles.
+ *
+ * @param const float* angles
+ * @param float* sin_out, may be NULL.
+ * @param float* cos_out, may be NULL.
+ * @param size_t count
+ */
+void transform_sincos(const float* angles, float* sin_out, float* cos_out, size_t count)
+{
+    size_t i = 0;
+    lane_T s, c;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        lane_sincos(lane_load(angles + i), &s, &c);
+
+        if (sin_out)
+            lane_store(sin_out + i, s);
+        if (cos_out)
+            lane_store(cos_out + i, c);
+    }
+
+    if (i == count)
+        return;
+
+    /**
+     * Tail through a padded copy, same math as the full vectors
+     */
+    float in[4] = { 0, 0, 0, 0 };
+    float out_s[4], out_c[4];
+    memcpy(in, angles + i, (count - i) * sizeof(float));
+
+    lane_sincos(lane_load(in), &s, &c);
+    lane_store(out_s, s);
+    lane_store(out_c, c);
+
+    if (sin_out)
+        memcpy(sin_out + i, out_s, (count - i) * sizeof(float));
+    if (cos_out)
+        memcpy(cos_out + i, out_c, (count - i) * sizeof(float));
+}
+
+/**
+ * Build column major model matrices, translate * rotate * scale,
+ * for objects [first, first + count).
+ * Matrices are written `stride` bytes apart, so they can go straight
+ * into an array of instance structs or a mapped instance buffer.
+ *
+ * @param const transform_soa_T* soa
+ * @param size_t first
+ * @param size_t count
+ * @param float* out, first matrix, 16 floats.
+ * @param size_t stride
+ */
+void transform_soa_models(const transform_soa_T* soa, size_t first, size_t count, float* out, size_t stride)
+{
+    lane_T zero = lane_set1(0.0f);
+    lane_T one = lane_set1(1.0f);
+    static const float column2[4] = { 0, 0, 1, 0 };
+
+    for (size_t j = 0; j < count; j += 4)
+    {
+        size_t i = first + j;
+        lane_T s, c;
+
+        /**
+         * Padding makes reading past the last object safe, only
+         * the writes stop at `count`.
+         */
+        lane_sincos(lane_load(soa->rotation + i), &s, &c);
+
+        lane_T sx = lane_load(soa->scale_x + i);
+        lane_T sy = lane_load(soa->scale_y + i);
+
+        lane_T c0x = lane_mul(c, sx);
+        lane_T c0y = lane_mul(s, sx);
+        lane_T c0z = zero;
+        lane_T c0w = zero;
+        lane_T c1x = lane_sub(zero, lane_mul(s, sy));
+        lane_T c1y = lane_mul(c, sy);
+        lane_T c1z = zero;
+        lane_T c1w = zero;
+        lane_T c3x = lane_load(soa->x + i);
+        lane_T c3y = lane_load(soa->y + i);
+        lane_T c3z = lane_load(soa->z + i);
+        lane_T c3w = one;
+
+        /**
+         * From one object per lane to one column per vector
+         */
+        lane_transpose(&c0x, &c0y, &c0z, &c0w);
+        lane_transpose(&c1x, &c1y, &c1z, &c1w);
+        lane_transpose(&c3x, &c3y, &c3z, &c3w);
+
+        lane_T col0[4] = { c0x, c0y, c0z, c0w };
+        lane_T col1[4] = { c1x, c1y, c1z, c1w };
+        lane_T col3[4] = { c3x, c3y, c3z, c3w };
+        size_t n = count - j < 4 ? count - j : 4;
+
+        for (size_t k = 0; k < n; k++)
+        {
+            float* m = (float*) ((char*) out + (j + k) * stride);
+            lane_store(m + 0, col0[k]);
+            lane_store(m + 4, col1[k]);
+            memcpy(m + 8, column2, sizeof(column2));
+            lane_store(m + 12, col3[k]);
+        }
+    }
+}
+
+/**
+ * Free the transforms.
+ *
+ * @param transform_soa_T* soa
+ */
+void transform_soa_free(transform_soa_T* soa)
+{
+    free(soa->x);
+    free(soa->y);
+    free(soa->z);
+    free(soa->rotation);
+    free(soa->scale_x);
+    free(soa->scale_y);
+    free(soa);
+}
@@ -0,0 +1,221 @@
+#include "include/vertex_layout.h"
+#include <string.h>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+#define VERTEX_LAYOUT_ENTRY(field, name, ctype, size, type, normalized, inputs) \
+    { name, size, type, normalized, offsetof(packed_vertex_T, field) },
+
+#define VERTEX_LAYOUT_COUNT(field, name, ctype, size, type, normalized, inputs) + 1
+
+#define VERTEX_LAYOUT_CHECK(field, name, ctype, size, type, normalized, inputs) \
+    _Static_assert(sizeof(ctype) == VERTEX_LAYOUT_TYPE_SIZE(type), \
+                   "`" #field "` is stored as " #ctype ", which does not hold a " #type); \
+    _Static_assert(inputs <= size, "`" #field "` reads more inputs than it has components");
+
+#define VERTEX_LAYOUT_PACK(field, name, ctype, size, type, normalized, inputs) \
+    vertex_pack_attribute(vertex->field, size, type, normalized, field, inputs);
+
+PACKED_VERTEX_ATTRIBUTES(VERTEX_LAYOUT_CHECK)
+
+/**
+ * Attribute table generated from PACKED_VERTEX_ATTRIBUTES.
+ */
+const vertex_layout_T packed_vertex_layout =
+{
+    sizeof(packed_vertex_T),
+    0 PACKED_VERTEX_ATTRIBUTES(VERTEX_LAYOUT_COUNT),
+    { PACKED_VERTEX_ATTRIBUTES(VERTEX_LAYOUT_ENTRY) }
+};
+
+
+/**
+ * Tell OpenGL where every attribute of the layout lives in the
+ * currently bound GL_ARRAY_BUFFER. Attributes the program does
+ * not use are skipped.
+ *
+ * @param const vertex_layout_T* layout
+ * @param GLuint program
+ * @param size_t base_offset, offset of the first vertex in the buffer.
+ */
+void vertex_layout_apply(const vertex_layout_T* layout, GLuint program, size_t base_offset)
+{
+    for (size_t i = 0; i < layout->attribute_count; i++)
+    {
+        const vertex_attribute_T* attribute = &layout->attributes[i];
+        GLint location = glGetAttribLocation(program, attribute->name);
+
+        if (location < 0)
+            continue;
+
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, attribute->size, attribute->type, attribute->normalized,
+                              layout->stride, (void*) (base_offset + attribute->offset));
+    }
+}
+
+/**
+ * Convert a float to IEEE half precision, rounding to nearest even.
+ *
+ * @param float v
+ * @return uint16_t
+ */
+uint16_t vertex_pack_half(float v)
+{
+#if defined(__F16C__)
+    return _cvtss_sh(v, 0);
+#else
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t) ((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    /**
+     * Infinity & NaN
+     */
+    if (((bits >> 23) & 0xFF) == 0xFF)
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+
+    if (exponent >= 31)
+        return sign | 0x7C00;
+
+    /**
+     * Too small for a normal half, becomes subnormal or zero.
+     */
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return sign;
+
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+
+        return sign | half;
+    }
+
+    uint32_t half = sign | ((uint32_t) exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+
+    /**
+     * A carry out of the mantissa correctly bumps the exponent.
+     */
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+
+    return half;
+#endif
+}
+
+/**
+ * Convert [0, 1] to a normalized unsigned short.
+ *
+ * @param float v
+ * @return uint16_t
+ */
+uint16_t vertex_pack_unorm16(float v)
+{
+    v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    return (uint16_t) (v * 65535.0f + 0.5f);
+}
+
+/**
+ * Convert [0, 1] to a normalized unsigned byte.
+ *
+ * @param float v
+ * @return uint8_t
+ */
+uint8_t vertex_pack_unorm8(float v)
+{
+    v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    return (uint8_t) (v * 255.0f + 0.5f);
+}
+
+/**
+ * Convert [-1, 1] to a normalized signed integer with `max` as 1.
+ *
+ * @param float v
+ * @param float max
+ * @return int32_t
+ */
+static int32_t vertex_pack_snorm(float v, float max)
+{
+    v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+    v *= max;
+    return (int32_t) (v < 0.0f ? v - 0.5f : v + 0.5f);
+}
+
+/**
+ * Convert the floats of one attribute to its GL type.
+ *
+ * @param void* dst, `size` components of VERTEX_LAYOUT_TYPE_SIZE(type) bytes.
+ * @param GLint size
+ * @param GLenum type
+ * @param GLboolean normalized, integer types map [0, 1] or [-1, 1] onto their range.
+ * @param const float* src, `inputs` floats.
+ * @param size_t inputs, missing components become 0, the fourth 1.
+ */
+void vertex_pack_attribute(void* dst, GLint size, GLenum type, GLboolean normalized,
+                           const float* src, size_t inputs)
+{
+    unsigned char* out = dst;
+
+    for (GLint i = 0; i < size; i++)
+    {
+        float v = (size_t) i < inputs ? src[i] : (i == 3 ? 1.0f : 0.0f);
+        uint16_t u16;
+        int16_t i16;
+        int8_t i8;
+
+        switch (type)
+        {
+            case GL_FLOAT:
+                memcpy(out, &v, sizeof(v));
+                break;
+            case GL_HALF_FLOAT:
+                u16 = vertex_pack_half(v);
+                memcpy(out, &u16, sizeof(u16));
+                break;
+            case GL_UNSIGNED_SHORT:
+                u16 = normalized ? vertex_pack_unorm16(v) : (uint16_t) v;
+                memcpy(out, &u16, sizeof(u16));
+                break;
+            case GL_SHORT:
+                i16 = normalized ? (int16_t) vertex_pack_snorm(v, 32767.0f) : (int16_t) v;
+                memcpy(out, &i16, sizeof(i16));
+                break;
+            case GL_UNSIGNED_BYTE:
+                *out = normalized ? vertex_pack_unorm8(v) : (uint8_t) v;
+                break;
+            case GL_BYTE:
+                i8 = normalized ? (int8_t) vertex_pack_snorm(v, 127.0f) : (int8_t) v;
+                memcpy(out, &i8, sizeof(i8));
+                break;
+        }
+
+        out += VERTEX_LAYOUT_TYPE_SIZE(type);
+    }
+}
+
+/**
+ * Pack one vertex from its float attributes, converted as described
+ * by PACKED_VERTEX_ATTRIBUTES.
+ *
+ * @param packed_vertex_T* vertex
+ * @param const float* position, 2 floats.
+ * @param const float* texcoord, 2 floats in [0, 1].
+ * @param const float* color, 3 floats in [0, 1], alpha is set to 1.
+ */
+void vertex_pack(packed_vertex_T* vertex, const float* position, const float* texcoord, const float* color)
+{
+    PACKED_VERTEX_ATTRIBUTES(VERTEX_LAYOUT_PACK)
+}
@@ -0,0 +1,1140 @@
+#include "include/virtual_texture.h"
+#include "include/image.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/**
+ * Samples the virtual texture through the page table, and writes the
+ * page it wanted into `feedback` for the next residency update.
+ * VirtualInfo is (pages per side of level 0, page size, border, top level).
+ */
+static const char* virtual_texture_source =
+    "uniform sampler2D PageTable;\n"
+    "uniform vec4 VirtualInfo;\n"
+    "vec4 virtual_texture(sampler2D cache, vec2 uv, out uvec4 feedback)\n"
+    "{\n"
+    "    float pages = VirtualInfo.x;\n"
+    "    float page_size = VirtualInfo.y;\n"
+    "    float border = VirtualInfo.z;\n"
+    "    vec2 texel = uv * pages * page_size;\n"
+    "    vec2 dx = dFdx(texel);\n"
+    "    vec2 dy = dFdy(texel);\n"
+    "    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));\n"
+    "    float level = floor(clamp(lod, 0.0, VirtualInfo.w));\n"
+    "    uv = clamp(uv, 0.0, 1.0 - 0.5 / (pages * page_size));\n"
+    "    feedback = uvec4(uvec2(uv * pages / exp2(level)), uint(level), 1u);\n"
+    "    vec4 entry = floor(textureLod(PageTable, uv, level) * 255.0 + 0.5);\n"
+    "    vec2 in_page = fract(uv * pages / exp2(entry.b));\n"
+    "    vec2 cached = entry.rg * (page_size + 2.0 * border) + border + in_page * page_size;\n"
+    "    return textureLod(cache, cached / vec2(textureSize(cache, 0)), 0.0);\n"
+    "}\n";
+
+/**
+ * GLSL defining `vec4 virtual_texture(sampler2D cache, vec2 uv, out uvec4 feedback)`,
+ * to be added in front of a fragment shader. The feedback goes to
+ * color attachment 1.
+ *
+ * @return const char*
+ */
+const char* virtual_texture_glsl(void)
+{
+    return virtual_texture_source;
+}
+
+/**
+ * @param virtual_texture_T* vt
+ * @param uint32_t level
+ * @param uint32_t x
+ * @param uint32_t y
+ * @return int32_t index of the page in `offsets`, `page_slots` & `table`.
+ */
+static int32_t virtual_texture_page(virtual_texture_T* vt, uint32_t level, uint32_t x, uint32_t y)
+{
+    return vt->level_first[level] + y * (vt->header.pages >> level) + x;
+}
+
+/**
+ * Inverse of virtual_texture_page.
+ *
+ * @param virtual_texture_T* vt
+ * @param int32_t page
+ * @param uint32_t* level
+ * @param uint32_t* x
+ * @param uint32_t* y
+ */
+static void virtual_texture_page_coords(virtual_texture_T* vt, int32_t page,
+                                        uint32_t* level, uint32_t* x, uint32_t* y)
+{
+    uint32_t l = 0;
+    while (l + 1 < vt->header.level_count && (uint32_t) page >= vt->level_first[l + 1])
+        l++;
+
+    uint32_t n = vt->header.pages >> l;
+    uint32_t i = page - vt->level_first[l];
+
+    *level = l;
+    *x = i % n;
+    *y = i / n;
+}
+
+/**
+ * A page table entry, RGBA8 with the slot in red & green and the
+ * level of the page it maps in blue.
+ *
+ * @param virtual_texture_T* vt
+ * @param int32_t slot
+ * @param uint32_t level
+ * @return uint32_t
+ */
+static uint32_t virtual_texture_entry(virtual_texture_T* vt, int32_t slot, uint32_t level)
+{
+    uint32_t sx = slot % vt->slots_per_side;
+    uint32_t sy = slot / vt->slots_per_side;
+
+    return sx | sy << 8 | level << 16 | 0xFFu << 24;
+}
+
+static uint32_t virtual_texture_entry_level(uint32_t entry)
+{
+    return (entry >> 16) & 0xFF;
+}
+
+/**
+ * Read a page from disk, safe to call from any thread.
+ *
+ * @param virtual_texture_T* vt
+ * @param int32_t page
+ * @return uint32_t* pixels to be freed by the caller, NULL on failure.
+ */
+static uint32_t* virtual_texture_read(virtual_texture_T* vt, int32_t page)
+{
+    uint32_t* pixels = malloc(vt->page_bytes);
+    if (pixels == NULL)
+        return NULL;
+
+    size_t done = 0;
+    while (done < vt->page_bytes)
+    {
+        ssize_t n = pread(vt->fd, (char*) pixels + done, vt->page_bytes - done, vt->offsets[page] + done);
+        if (n <= 0)
+        {
+            free(pixels);
+            return NULL;
+        }
+        done += n;
+    }
+
+    return pixels;
+}
+
+/**
+ * Streaming thread, reads requested pages and hands them over to
+ * the GL thread.
+ *
+ * @param void* ptr
+ * @return void*
+ */
+static void* virtual_texture_worker(void* ptr)
+{
+    virtual_texture_T* vt = (virtual_texture_T*) ptr;
+
+    pthread_mutex_lock(&vt->lock);
+    while (1)
+    {
+        while (vt->running && vt->request_count == 0)
+            pthread_cond_wait(&vt->cond, &vt->lock);
+
+        if (!vt->running)
+            break;
+
+        int32_t page = vt->requests[vt->request_head];
+        vt->request_head = (vt->request_head + 1) % VIRTUAL_TEXTURE_MAX_REQUESTS;
+        vt->request_count--;
+
+        pthread_mutex_unlock(&vt->lock);
+
+        virtual_texture_load_T* load = calloc(1, sizeof(struct VIRTUAL_TEXTURE_LOAD_STRUCT));
+        load->page = page;
+        load->pixels = virtual_texture_read(vt, page);
+
+        pthread_mutex_lock(&vt->lock);
+
+        if (vt->loaded_tail)
+            vt->loaded_tail->next = load;
+        else
+            vt->loaded = load;
+        vt->loaded_tail = load;
+    }
+    pthread_mutex_unlock(&vt->lock);
+
+    return NULL;
+}
+
+/**
+ * Unlink a slot from the LRU list.
+ *
+ * @param virtual_texture_T* vt
+ * @param int32_t s
+ */
+static void virtual_texture_unlink(virtual_texture_T* vt, int32_t s)
+{
+    virtual_texture_slot_T* slot = &vt->slots[s];
+
+    if (slot->prev >= 0)
+        vt->slots[slot->prev].next = slot->next;
+    else
+        vt->lru_head = slot->next;
+
+    if (slot->next >= 0)
+        vt->slots[slot->next].prev = slot->prev;
+    else
+        vt->lru_tail = slot->prev;
+
+    slot->prev = slot->next = -1;
+}
+
+/**
+ * Mark a slot as used this frame, moving it to the front of the LRU list.
+ *
+ * @param virtual_texture_T* vt
+ * @param int32_t s
+ */
+static void virtual_texture_touch(virtual_texture_T* vt, int32_t s)
+{
+    virtual_texture_slot_T* slot = &vt->slots[s];
+    slot->frame = vt->frame;
+
+    if (vt->lru_head == s)
+        return;
+
+    virtual_texture_unlink(vt, s);
+
+    slot->next = vt->lru_head;
+    if (vt->lru_head >= 0)
+        vt->slots[vt->lru_head].prev = s;
+    vt->lru_head = s;
+
+    if (vt->lru_tail < 0)
+        vt->lru_tail = s;
+}
+
+/**
+ * Point the entries covered by a page, on its own level and all
+ * finer ones, at `entry`.
+ *
+ * @param virtual_texture_T* vt
+ * @param int32_t page
+ * @param uint32_t entry
+ * @param int evict, replace entries mapping this page instead of coarser ones.
+ */
+static void virtual_texture_update_table(virtual_texture_T* vt, int32_t page, uint32_t entry, int evict)
+{
+    uint32_t level, x, y;
+    virtual_texture_page_coords(vt, page, &level, &x, &y);
+
+    for (uint32_t l = 0; l <= level; l++)
+    {
+        uint32_t shift = level - l;
+        uint32_t n = vt->header.pages >> l;
+        uint32_t* table = vt->table + vt->level_first[l];
+
+        for (uint32_t ty = y << shift; ty < (y + 1) << shift; ty++)
+        {
+            for (uint32_t tx = x << shift; tx < (x + 1) << shift; tx++)
+            {
+                uint32_t current = virtual_texture_entry_level(table[ty * n + tx]);
+
+                if (evict ? current == level : current > level)
+                    table[ty * n + tx] = entry;
+            }
+        }
+
+        vt->dirty_levels |= 1u << l;
+    }
+}
+
+/**
+ * Map a page into a slot, finer levels that fell back to a coarser
+ * page now sample this one.
+ *
+ * @param virtual_texture_T* vt
+ * @param int32_t page
+ * @param int32_t s
+ */
+static void virtual_texture_map(virtual_texture_T* vt, int32_t page, int32_t s)
+{
+    uint32_t level, x, y;
+    virtual_texture_page_coords(vt, page, &level, &x, &y);
+
+    vt->page_slots[page] = s;
+    vt->slots[s].page = page;
+    virtual_texture_update_table(vt, page, virtual_texture_entry(vt, s, level), 0);
+}
+
+/**
+ * Evict a page, everything sampling it falls back to what its
+ * parent samples. The top level page is never evicted.
+ *
+ * @param virtual_texture_T* vt
+ * @param int32_t page
+ */
+static void virtual_texture_unmap(virtual_texture_T* vt, int32_t page)
+{
+    uint32_t level, x, y;
+    virtual_texture_page_coords(vt, page, &level, &x, &y);
+
+    uint32_t parent = vt->table[virtual_texture_page(vt, level + 1, x >> 1, y >> 1)];
+    virtual_texture_update_table(vt, page, parent, 1);
+
+    vt->slots[vt->page_slots[page]].page = VIRTUAL_TEXTURE_PAGE_FREE;
+    vt->page_slots[page] = VIRTUAL_TEXTURE_PAGE_FREE;
+    vt->evictions++;
+}
+
+/**
+ * Take the least recently used slot, evicting its page.
+ *
+ * @param virtual_texture_T* vt
+ * @return int32_t slot or -1 when every page in the cache is still needed.
+ */
+static int32_t virtual_texture_acquire(virtual_texture_T* vt)
+{
+    int32_t s = vt->lru_tail;
+    if (s < 0)
+        return -1;
+
+    virtual_texture_slot_T* slot = &vt->slots[s];
+
+    if (slot->page >= 0)
+    {
+        if (slot->frame == vt->frame)
+        {
+            vt->thrashing++;
+            return -1;
+        }
+
+        virtual_texture_unmap(vt, slot->page);
+    }
+
+    return s;
+}
+
+/**
+ * Copy a page into a slot of the cache texture.
+ *
+ * @param virtual_texture_T* vt
+ * @param int32_t s
+ * @param const uint32_t* pixels
+ */
+static void virtual_texture_upload(virtual_texture_T* vt, int32_t s, const uint32_t* pixels)
+{
+    GLint stride = vt->header.page_size + vt->header.page_border * 2;
+    GLint x = (s % vt->slots_per_side) * stride;
+    GLint y = (s / vt->slots_per_side) * stride;
+
+    glBindTexture(GL_TEXTURE_2D, vt->cache);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, stride, stride, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    vt->uploads++;
+}
+
+/**
+ * Upload the levels of the page table that changed.
+ *
+ * @param virtual_texture_T* vt
+ */
+static void virtual_texture_upload_table(virtual_texture_T* vt)
+{
+    if (!vt->dirty_levels)
+        return;
+
+    glBindTexture(GL_TEXTURE_2D, vt->page_table);
+
+    for (uint32_t l = 0; l < vt->header.level_count; l++)
+    {
+        if (!(vt->dirty_levels & (1u << l)))
+            continue;
+
+        GLsizei n = vt->header.pages >> l;
+        glTexSubImage2D(GL_TEXTURE_2D, l, 0, 0, n, n, GL_RGBA, GL_UNSIGNED_BYTE,
+                        vt->table + vt->level_first[l]);
+    }
+
+    vt->dirty_levels = 0;
+}
+
+/**
+ * Open a virtual texture file and validate its header & page offsets.
+ *
+ * @param virtual_texture_T* vt
+ * @param const char* path
+ * @return int 0 on failure.
+ */
+static int virtual_texture_open(virtual_texture_T* vt, const char* path)
+{
+    vt->fd = open(path, O_RDONLY);
+    if (vt->fd < 0)
+    {
+        fprintf(stderr, "Could not open virtual texture `%s`\n", path);
+        return 0;
+    }
+
+    struct stat st;
+    virtual_texture_header_T* header = &vt->header;
+
+    int valid = fstat(vt->fd, &st) == 0 &&
+                pread(vt->fd, header, sizeof(*header), 0) == (ssize_t) sizeof(*header) &&
+                memcmp(header->magic, VIRTUAL_TEXTURE_MAGIC, sizeof(VIRTUAL_TEXTURE_MAGIC)) == 0 &&
+                header->version == VIRTUAL_TEXTURE_VERSION &&
+                header->page_size == VIRTUAL_TEXTURE_PAGE_SIZE &&
+                header->page_border == VIRTUAL_TEXTURE_PAGE_BORDER &&
+                header->level_count > 0 &&
+                header->level_count <= VIRTUAL_TEXTURE_MAX_LEVELS &&
+                header->pages == 1u << (header->level_count - 1);
+
+    if (valid)
+    {
+        for (uint32_t l = 0; l < header->level_count; l++)
+        {
+            vt->level_first[l] = vt->page_count;
+            vt->page_count += (size_t) (header->pages >> l) * (header->pages >> l);
+        }
+
+        size_t stride = header->page_size + header->page_border * 2;
+        vt->page_bytes = stride * stride * sizeof(uint32_t);
+        vt->offsets = malloc(vt->page_count * sizeof(uint64_t));
+
+        size_t table_size = vt->page_count * sizeof(uint64_t);
+        valid = pread(vt->fd, vt->offsets, table_size, sizeof(*header)) == (ssize_t) table_size;
+
+        for (size_t i = 0; valid && i < vt->page_count; i++)
+            valid = vt->offsets[i] <= (uint64_t) st.st_size &&
+                    vt->page_bytes <= (uint64_t) st.st_size - vt->offsets[i];
+
+        /**
+         * The top level page is what everything falls back to.
+         */
+        valid = valid && vt->offsets[vt->page_count - 1] != 0;
+    }
+
+    if (!valid)
+        fprintf(stderr, "Invalid virtual texture `%s`\n", path);
+
+    return valid;
+}
+
+/**
+ * Open a virtual texture, needs a current GL context.
+ * The cache texture never grows past `budget` bytes, the page table
+ * adds 4/3 * 4 bytes per level 0 page on top of that.
+ *
+ * @param const char* path, a file made with virtual_texture_bake.
+ * @param size_t budget, bytes of video memory for the page cache.
+ * @return virtual_texture_T* or NULL on failure.
+ */
+virtual_texture_T* init_virtual_texture(const char* path, size_t budget)
+{
+    virtual_texture_T* vt = calloc(1, sizeof(struct VIRTUAL_TEXTURE_STRUCT));
+    vt->fd = -1;
+    vt->lru_head = vt->lru_tail = -1;
+    pthread_mutex_init(&vt->lock, NULL);
+    pthread_cond_init(&vt->cond, NULL);
+
+    if (!virtual_texture_open(vt, path))
+    {
+        virtual_texture_free(vt);
+        return NULL;
+    }
+
+    /**
+     * Fit as many pages as the budget & the texture size limit allow.
+     */
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+
+    size_t stride = vt->header.page_size + vt->header.page_border * 2;
+    size_t side = (size_t) sqrt((double) (budget / vt->page_bytes));
+
+    if (side > VIRTUAL_TEXTURE_MAX_SLOTS_PER_SIDE)
+        side = VIRTUAL_TEXTURE_MAX_SLOTS_PER_SIDE;
+    if (side * stride > (size_t) max_size)
+        side = max_size / stride;
+    if (side < 2)
+    {
+        fprintf(stderr, "Virtual texture budget is too small, using 4 pages\n");
+        side = 2;
+    }
+
+    vt->slots_per_side = side;
+    vt->slot_count = side * side;
+    vt->slots = calloc(vt->slot_count, sizeof(struct VIRTUAL_TEXTURE_SLOT_STRUCT));
+
+    for (size_t i = 0; i < vt->slot_count; i++)
+    {
+        vt->slots[i].page = VIRTUAL_TEXTURE_PAGE_FREE;
+        vt->slots[i].prev = i > 0 ? (int32_t) i - 1 : -1;
+        vt->slots[i].next = i + 1 < vt->slot_count ? (int32_t) i + 1 : -1;
+    }
+
+    vt->lru_head = 0;
+    vt->lru_tail = vt->slot_count - 1;
+
+    vt->page_slots = malloc(vt->page_count * sizeof(int32_t));
+    vt->table = calloc(vt->page_count, sizeof(uint32_t));
+
+    for (size_t i = 0; i < vt->page_count; i++)
+        vt->page_slots[i] = vt->offsets[i] ? VIRTUAL_TEXTURE_PAGE_FREE : VIRTUAL_TEXTURE_PAGE_EMPTY;
+
+    glGenTextures(1, &vt->cache);
+    glBindTexture(GL_TEXTURE_2D, vt->cache);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, side * stride, side * stride, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    glGenTextures(1, &vt->page_table);
+    glBindTexture(GL_TEXTURE_2D, vt->page_table);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, vt->header.level_count - 1);
+
+    for (uint32_t l = 0; l < vt->header.level_count; l++)
+    {
+        GLsizei n = vt->header.pages >> l;
+        glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8, n, n, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    /**
+     * Load the top level page right away and pin it, taking it out
+     * of the LRU list, so there is always something to sample.
+     */
+    int32_t root = vt->page_count - 1;
+    uint32_t* pixels = virtual_texture_read(vt, root);
+    if (pixels == NULL)
+    {
+        fprintf(stderr, "Could not read virtual texture `%s`\n", path);
+        virtual_texture_free(vt);
+        return NULL;
+    }
+
+    int32_t s = virtual_texture_acquire(vt);
+    virtual_texture_unlink(vt, s);
+    virtual_texture_upload(vt, s, pixels);
+    free(pixels);
+
+    uint32_t entry = virtual_texture_entry(vt, s, vt->header.level_count - 1);
+    for (size_t i = 0; i < vt->page_count; i++)
+        vt->table[i] = entry;
+
+    vt->page_slots[root] = s;
+    vt->slots[s].page = root;
+    vt->dirty_levels = (1u << vt->header.level_count) - 1;
+    virtual_texture_upload_table(vt);
+
+    vt->running = 1;
+    if (pthread_create(&vt->thread, NULL, virtual_texture_worker, vt) != 0)
+    {
+        fprintf(stderr, "Could not create virtual texture thread\n");
+        virtual_texture_free(vt);
+        return NULL;
+    }
+    vt->thread_started = 1;
+
+    return vt;
+}
+
+/**
+ * Point a program using virtual_texture_glsl at the page table.
+ * Leaves the program in use.
+ *
+ * @param virtual_texture_T* vt
+ * @param GLuint program
+ * @param GLint table_unit, texture unit the page table is bound to.
+ * @return int 0 if the program does not sample a virtual texture.
+ */
+int virtual_texture_bind_program(virtual_texture_T* vt, GLuint program, GLint table_unit)
+{
+    GLint table = glGetUniformLocation(program, "PageTable");
+    GLint info = glGetUniformLocation(program, "VirtualInfo");
+
+    if (table < 0 || info < 0)
+        return 0;
+
+    glUseProgram(program);
+    glUniform1i(table, table_unit);
+    glUniform4f(info, vt->header.pages, vt->header.page_size, vt->header.page_border,
+                vt->header.level_count - 1);
+
+    return 1;
+}
+
+static int compare_pages(const void* a, const void* b)
+{
+    int32_t x = *(const int32_t*) a;
+    int32_t y = *(const int32_t*) b;
+
+    return (x < y) - (x > y);
+}
+
+/**
+ * Keep a page & its ancestors resident, queueing the ones that are not.
+ *
+ * @param virtual_texture_T* vt
+ * @param uint32_t level
+ * @param uint32_t x
+ * @param uint32_t y
+ * @param int32_t* wanted
+ * @param size_t* wanted_count
+ */
+static void virtual_texture_want(virtual_texture_T* vt, uint32_t level, uint32_t x, uint32_t y,
+                                 int32_t* wanted, size_t* wanted_count)
+{
+    for (uint32_t l = level; l + 1 < vt->header.level_count; l++)
+    {
+        int32_t page = virtual_texture_page(vt, l, x >> (l - level), y >> (l - level));
+        int32_t s = vt->page_slots[page];
+
+        if (s >= 0)
+        {
+            /**
+             * Its ancestors have been touched along with it.
+             */
+            if (vt->slots[s].frame == vt->frame)
+                return;
+
+            virtual_texture_touch(vt, s);
+        }
+        else if (s == VIRTUAL_TEXTURE_PAGE_FREE && *wanted_count < VIRTUAL_TEXTURE_MAX_REQUESTS)
+        {
+            wanted[(*wanted_count)++] = page;
+            vt->page_slots[page] = VIRTUAL_TEXTURE_PAGE_LOADING;
+        }
+    }
+}
+
+/**
+ * Process the oldest feedback readback, if the GPU is done with it.
+ *
+ * @param virtual_texture_T* vt
+ */
+static void virtual_texture_read_feedback(virtual_texture_T* vt)
+{
+    virtual_texture_feedback_T* feedback = &vt->feedback[vt->feedback_index];
+    if (!feedback->fence)
+        return;
+
+    GLenum status = glClientWaitSync(feedback->fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return;
+
+    glDeleteSync(feedback->fence);
+    feedback->fence = NULL;
+
+    size_t count = (size_t) feedback->width * feedback->height;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, feedback->buffer);
+    const uint16_t* texels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * 4 * sizeof(uint16_t),
+                                              GL_MAP_READ_BIT);
+
+    int32_t wanted[VIRTUAL_TEXTURE_MAX_REQUESTS];
+    size_t wanted_count = 0;
+    int32_t last = -1;
+
+    for (size_t i = 0; texels && i < count; i++)
+    {
+        const uint16_t* texel = &texels[i * 4];
+        if (!texel[3] || texel[2] >= vt->header.level_count)
+            continue;
+
+        uint32_t n = vt->header.pages >> texel[2];
+        if (texel[0] >= n || texel[1] >= n)
+            continue;
+
+        int32_t page = virtual_texture_page(vt, texel[2], texel[0], texel[1]);
+        if (page == last)
+            continue;
+
+        last = page;
+        virtual_texture_want(vt, texel[2], texel[0], texel[1], wanted, &wanted_count);
+    }
+
+    if (texels)
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (wanted_count == 0)
+        return;
+
+    /**
+     * Coarse levels have the higher indices, stream them first so
+     * something close shows up quickly.
+     */
+    qsort(wanted, wanted_count, sizeof(int32_t), compare_pages);
+
+    pthread_mutex_lock(&vt->lock);
+    for (size_t i = 0; i < wanted_count; i++)
+    {
+        if (vt->request_count == VIRTUAL_TEXTURE_MAX_REQUESTS)
+        {
+            vt->page_slots[wanted[i]] = VIRTUAL_TEXTURE_PAGE_FREE;
+            continue;
+        }
+
+        vt->requests[(vt->request_head + vt->request_count) % VIRTUAL_TEXTURE_MAX_REQUESTS] = wanted[i];
+        vt->request_count++;
+    }
+    pthread_cond_signal(&vt->cond);
+    pthread_mutex_unlock(&vt->lock);
+}
+
+/**
+ * Request the pages the last feedback asked for & upload the ones that
+ * finished streaming. Call once per frame from the GL thread.
+ * Uploading binds textures on the active unit.
+ *
+ * @param virtual_texture_T* vt
+ * @return size_t amount of pages uploaded.
+ */
+size_t virtual_texture_update(virtual_texture_T* vt)
+{
+    vt->frame++;
+    virtual_texture_read_feedback(vt);
+
+    size_t uploaded = 0;
+
+    while (uploaded < VIRTUAL_TEXTURE_UPLOADS_PER_FRAME)
+    {
+        pthread_mutex_lock(&vt->lock);
+        virtual_texture_load_T* load = vt->loaded;
+        pthread_mutex_unlock(&vt->lock);
+
+        if (load == NULL)
+            break;
+
+        if (load->pixels == NULL)
+        {
+            fprintf(stderr, "Could not read virtual texture page %d\n", load->page);
+            vt->page_slots[load->page] = VIRTUAL_TEXTURE_PAGE_EMPTY;
+        }
+        else
+        {
+            /**
+             * Everything in the cache is on screen, try again next
+             * frame instead of evicting visible pages.
+             */
+            int32_t s = virtual_texture_acquire(vt);
+            if (s < 0)
+                break;
+
+            virtual_texture_upload(vt, s, load->pixels);
+            virtual_texture_map(vt, load->page, s);
+            virtual_texture_touch(vt, s);
+            uploaded++;
+        }
+
+        pthread_mutex_lock(&vt->lock);
+        vt->loaded = load->next;
+        if (vt->loaded == NULL)
+            vt->loaded_tail = NULL;
+        pthread_mutex_unlock(&vt->lock);
+
+        free(load->pixels);
+        free(load);
+    }
+
+    virtual_texture_upload_table(vt);
+
+    return uploaded;
+}
+
+/**
+ * Free the render targets.
+ *
+ * @param virtual_texture_T* vt
+ */
+static void virtual_texture_release_targets(virtual_texture_T* vt)
+{
+    glDeleteFramebuffers(1, &vt->scene_fbo);
+    glDeleteFramebuffers(1, &vt->feedback_fbo);
+    glDeleteRenderbuffers(1, &vt->scene_color);
+    glDeleteRenderbuffers(1, &vt->scene_feedback);
+    glDeleteRenderbuffers(1, &vt->feedback_color);
+
+    for (size_t i = 0; i < VIRTUAL_TEXTURE_FEEDBACK_FRAMES; i++)
+    {
+        virtual_texture_feedback_T* feedback = &vt->feedback[i];
+        if (feedback->fence)
+            glDeleteSync(feedback->fence);
+        if (feedback->buffer)
+            glDeleteBuffers(1, &feedback->buffer);
+        memset(feedback, 0, sizeof(*feedback));
+    }
+
+    vt->scene_fbo = vt->feedback_fbo = 0;
+    vt->scene_color = vt->scene_feedback = vt->feedback_color = 0;
+}
+
+/**
+ * Create a renderbuffer.
+ *
+ * @param GLenum format
+ * @param int width
+ * @param int height
+ * @return GLuint
+ */
+static GLuint virtual_texture_renderbuffer(GLenum format, int width, int height)
+{
+    GLuint renderbuffer;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, format, width, height);
+
+    return renderbuffer;
+}
+
+/**
+ * (Re)create the scene & feedback targets for a viewport size.
+ *
+ * @param virtual_texture_T* vt
+ * @param int width
+ * @param int height
+ */
+static void virtual_texture_resize(virtual_texture_T* vt, int width, int height)
+{
+    virtual_texture_release_targets(vt);
+
+    vt->width = width;
+    vt->height = height;
+
+    int feedback_width = width / VIRTUAL_TEXTURE_FEEDBACK_SCALE > 0 ? width / VIRTUAL_TEXTURE_FEEDBACK_SCALE : 1;
+    int feedback_height = height / VIRTUAL_TEXTURE_FEEDBACK_SCALE > 0 ? height / VIRTUAL_TEXTURE_FEEDBACK_SCALE : 1;
+
+    vt->scene_color = virtual_texture_renderbuffer(GL_RGBA8, width, height);
+    vt->scene_feedback = virtual_texture_renderbuffer(GL_RGBA16UI, width, height);
+    vt->feedback_color = virtual_texture_renderbuffer(GL_RGBA16UI, feedback_width, feedback_height);
+
+    static const GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+
+    glGenFramebuffers(1, &vt->scene_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, vt->scene_fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, vt->scene_color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, vt->scene_feedback);
+    glDrawBuffers(2, draw_buffers);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+        fprintf(stderr, "Virtual texture framebuffer %dx%d is incomplete (0x%x)\n", width, height, status);
+
+    glGenFramebuffers(1, &vt->feedback_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, vt->feedback_fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, vt->feedback_color);
+
+    status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+        fprintf(stderr, "Virtual texture feedback framebuffer is incomplete (0x%x)\n", status);
+
+    for (size_t i = 0; i < VIRTUAL_TEXTURE_FEEDBACK_FRAMES; i++)
+    {
+        virtual_texture_feedback_T* feedback = &vt->feedback[i];
+        feedback->width = feedback_width;
+        feedback->height = feedback_height;
+
+        glGenBuffers(1, &feedback->buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, feedback->buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (size_t) feedback_width * feedback_height * 4 * sizeof(uint16_t),
+                     NULL, GL_STREAM_READ);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+/**
+ * Bind & clear the scene framebuffer, draw with the programs using
+ * virtual_texture_glsl until virtual_texture_end_frame.
+ *
+ * @param virtual_texture_T* vt
+ * @param render_state_T* state
+ * @param int width
+ * @param int height
+ */
+void virtual_texture_begin_frame(virtual_texture_T* vt, render_state_T* state, int width, int height)
+{
+    if (width != vt->width || height != vt->height)
+    {
+        virtual_texture_resize(vt, width, height);
+        render_state_invalidate_framebuffer(state);
+    }
+
+    render_state_bind_framebuffer(state, vt->scene_fbo);
+
+    static const GLfloat clear_color[4] = { 0, 0, 0, 0 };
+    static const GLuint clear_feedback[4] = { 0, 0, 0, 0 };
+    glClearBufferfv(GL_COLOR, 0, clear_color);
+    glClearBufferuiv(GL_COLOR, 1, clear_feedback);
+}
+
+/**
+ * Copy the scene to `target` & start reading back a downscaled copy
+ * of the feedback, it is processed a few frames later.
+ *
+ * @param virtual_texture_T* vt
+ * @param render_state_T* state
+ * @param GLuint target, framebuffer to present to, 0 for the window.
+ */
+void virtual_texture_end_frame(virtual_texture_T* vt, render_state_T* state, GLuint target)
+{
+    virtual_texture_feedback_T* feedback = &vt->feedback[vt->feedback_index];
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, vt->scene_fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+    glBlitFramebuffer(0, 0, vt->width, vt->height, 0, 0, vt->width, vt->height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, vt->feedback_fbo);
+    glBlitFramebuffer(0, 0, vt->width, vt->height, 0, 0, feedback->width, feedback->height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    /**
+     * A readback nobody got to in time is simply dropped.
+     */
+    if (feedback->fence)
+        glDeleteSync(feedback->fence);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, vt->feedback_fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, feedback->buffer);
+    glReadPixels(0, 0, feedback->width, feedback->height, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    feedback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    vt->feedback_index = (vt->feedback_index + 1) % VIRTUAL_TEXTURE_FEEDBACK_FRAMES;
+
+    render_state_invalidate_framebuffer(state);
+}
+
+/**
+ * The baked texture is padded to a power of two amount of pages,
+ * this is the part of UV space the actual image covers.
+ *
+ * @param virtual_texture_T* vt
+ * @param float* uv_rect, x, y, width & height.
+ */
+void virtual_texture_uv_rect(virtual_texture_T* vt, float* uv_rect)
+{
+    float size = (float) vt->header.pages * vt->header.page_size;
+
+    uv_rect[0] = 0;
+    uv_rect[1] = 0;
+    uv_rect[2] = vt->header.width / size;
+    uv_rect[3] = vt->header.height / size;
+}
+
+/**
+ * @param virtual_texture_T* vt
+ * @return size_t amount of pages in the cache.
+ */
+size_t virtual_texture_resident(virtual_texture_T* vt)
+{
+    size_t resident = 0;
+
+    for (size_t i = 0; i < vt->slot_count; i++)
+        resident += vt->slots[i].page >= 0;
+
+    return resident;
+}
+
+/**
+ * Stop streaming and free the virtual texture.
+ *
+ * @param virtual_texture_T* vt
+ */
+void virtual_texture_free(virtual_texture_T* vt)
+{
+    if (vt->thread_started)
+    {
+        pthread_mutex_lock(&vt->lock);
+        vt->running = 0;
+        pthread_cond_broadcast(&vt->cond);
+        pthread_mutex_unlock(&vt->lock);
+
+        pthread_join(vt->thread, NULL);
+    }
+
+    while (vt->loaded)
+    {
+        virtual_texture_load_T* next = vt->loaded->next;
+        free(vt->loaded->pixels);
+        free(vt->loaded);
+        vt->loaded = next;
+    }
+
+    virtual_texture_release_targets(vt);
+
+    if (vt->cache)
+        glDeleteTextures(1, &vt->cache);
+    if (vt->page_table)
+        glDeleteTextures(1, &vt->page_table);
+    if (vt->fd >= 0)
+        close(vt->fd);
+
+    pthread_mutex_destroy(&vt->lock);
+    pthread_cond_destroy(&vt->cond);
+    free(vt->offsets);
+    free(vt->page_slots);
+    free(vt->table);
+    free(vt->slots);
+    free(vt);
+}
+
+/**
+ * Cut a .png and its mip chain into pages for init_virtual_texture.
+ * The image is padded up to a power of two amount of pages, pages
+ * entirely in the padding are not stored.
+ *
+ * @param const char* src
+ * @param const char* dst
+ * @param mipmap_filter_T filter, MIPMAP_FILTER_NONE uses a box filter.
+ * @return int 0 on failure.
+ */
+int virtual_texture_bake(const char* src, const char* dst, mipmap_filter_T filter)
+{
+    image_T chain[VIRTUAL_TEXTURE_MAX_LEVELS] = {};
+
+    if (!image_load(&chain[0], src))
+        return 0;
+
+    virtual_texture_header_T header = {};
+    memcpy(header.magic, VIRTUAL_TEXTURE_MAGIC, sizeof(VIRTUAL_TEXTURE_MAGIC));
+    header.version = VIRTUAL_TEXTURE_VERSION;
+    header.width = chain[0].width;
+    header.height = chain[0].height;
+    header.page_size = VIRTUAL_TEXTURE_PAGE_SIZE;
+    header.page_border = VIRTUAL_TEXTURE_PAGE_BORDER;
+    header.pages = 1;
+    header.level_count = 1;
+
+    unsigned int size = header.width > header.height ? header.width : header.height;
+    while (header.pages * header.page_size < size)
+    {
+        header.pages *= 2;
+        header.level_count++;
+    }
+
+    /**
+     * Checked before generating, `chain` only holds the maximum
+     */
+    if (header.level_count > VIRTUAL_TEXTURE_MAX_LEVELS)
+    {
+        fprintf(stderr, "`%s` is too large for a virtual texture\n", src);
+        image_release(&chain[0]);
+        return 0;
+    }
+
+    uint32_t count = mipmap_generate(chain, header.level_count,
+                                     filter == MIPMAP_FILTER_NONE ? MIPMAP_FILTER_BOX : filter);
+
+    if (count < header.level_count)
+    {
+        fprintf(stderr, "`%s` is too large for a virtual texture\n", src);
+        mipmap_release(chain, count);
+        image_release(&chain[0]);
+        return 0;
+    }
+
+    size_t page_count = 0;
+    for (uint32_t l = 0; l < header.level_count; l++)
+        page_count += (size_t) (header.pages >> l) * (header.pages >> l);
+
+    FILE* fp = fopen(dst, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Could not open `%s` for writing\n", dst);
+        mipmap_release(chain, count);
+        image_release(&chain[0]);
+        return 0;
+    }
+
+    uint64_t* offsets = calloc(page_count, sizeof(uint64_t));
+    unsigned int p = header.page_border;
+    unsigned int stride = header.page_size + p * 2;
+    uint32_t* pixels = malloc(sizeof(uint32_t) * stride * stride);
+
+    /**
+     * The offsets are written once all pages are placed.
+     */
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(offsets, sizeof(uint64_t), page_count, fp) == page_count;
+
+    uint64_t offset = sizeof(header) + page_count * sizeof(uint64_t);
+    size_t index = 0;
+    size_t stored = 0;
+
+    for (uint32_t l = 0; ok && l < header.level_count; l++)
+    {
+        image_T* image = &chain[l];
+        unsigned int n = header.pages >> l;
+
+        for (unsigned int py = 0; ok && py < n; py++)
+        {
+            for (unsigned int px = 0; ok && px < n; px++, index++)
+            {
+                unsigned int x0 = px * header.page_size;
+                unsigned int y0 = py * header.page_size;
+
+                if (x0 >= image->width || y0 >= image->height)
+                    continue;
+
+                /**
+                 * The border repeats the neighbouring pages, or the
+                 * edge of the image where there are none.
+                 */
+                for (unsigned int dy = 0; dy < stride; dy++)
+                {
+                    int sy = (int) (y0 + dy) - (int) p;
+                    sy = sy < 0 ? 0 : (sy >= (int) image->height ? (int) image->height - 1 : sy);
+
+                    for (unsigned int dx = 0; dx < stride; dx++)
+                    {
+                        int sx = (int) (x0 + dx) - (int) p;
+                        sx = sx < 0 ? 0 : (sx >= (int) image->width ? (int) image->width - 1 : sx);
+                        pixels[dy * stride + dx] = image->pixels[(size_t) sy * image->width + sx];
+                    }
+                }
+
+                ok = fwrite(pixels, sizeof(uint32_t), stride * stride, fp) == stride * stride;
+                offsets[index] = offset;
+                offset += sizeof(uint32_t) * stride * stride;
+                stored++;
+            }
+        }
+    }
+
+    ok = ok && fseek(fp, sizeof(header), SEEK_SET) == 0 &&
+         fwrite(offsets, sizeof(uint64_t), page_count, fp) == page_count;
+
+    if (fclose(fp) != 0)
+        ok = 0;
+
+    if (ok)
+        printf("Baked `%s` into `%s` (%ux%u, %u levels, %zu of %zu pages stored)\n",
+               src, dst, header.width, header.height, header.level_count, stored, page_count);
+    else
+        fprintf(stderr, "Could not write `%s`\n", dst);
+
+    free(pixels);
+    free(offsets);
+    mipmap_release(chain, count);
+    image_release(&chain[0]);
+
+    return ok;
+}